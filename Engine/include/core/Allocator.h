@@ -0,0 +1,185 @@
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Copyright (c) 2013 Mikko Romppainen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in the
+// Software without restriction, including without limitation the rights to use, copy,
+// modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+#ifndef _ALLOCATOR_H_
+#define _ALLOCATOR_H_
+
+#include <stddef.h>
+#include <new>
+
+namespace core
+{
+
+/**
+ * Memory categories. Every allocation made through engineAllocMem is counted in one
+ * category, so memory use of each subsystem can be seen and given a budget.
+ */
+enum MemoryCategory
+{
+	MEMORY_CURRENT = -1,		///< Category set by MemoryCategoryScope for the calling thread
+	MEMORY_GENERAL = 0,
+	MEMORY_MESH,
+	MEMORY_TEXTURE,
+	MEMORY_SHADER,
+	MEMORY_SCENE,
+	MEMORY_STRING,
+	MEMORY_NUM_CATEGORIES
+};
+
+/**
+ * Interface for memory allocators. Allocators must be thread-safe.
+ */
+class Allocator
+{
+public:
+	/** Constructor. Name is shown in statistics. */
+	Allocator( const char* const name );
+
+	/** Destructor */
+	virtual ~Allocator();
+
+	/**
+	 * Allocates size bytes aligned to alignment (power of two).
+	 * @return Pointer to the memory or 0 if out of memory.
+	 */
+	virtual void* allocate( size_t size, size_t alignment ) = 0;
+
+	/** Frees memory returned by allocate. Size is the size given to allocate. */
+	virtual void deallocate( void* p, size_t size ) = 0;
+
+	/** Returns name of the allocator. */
+	const char* getName() const;
+
+private:
+	const char* m_name;
+
+	Allocator( const Allocator& );
+	Allocator& operator=( const Allocator& );
+};
+
+/**
+ * Allocator using aligned allocation of the C runtime.
+ */
+class SystemAllocator : public Allocator
+{
+public:
+	SystemAllocator();
+	virtual ~SystemAllocator();
+
+	virtual void* allocate( size_t size, size_t alignment );
+	virtual void deallocate( void* p, size_t size );
+};
+
+/**
+ * Memory statistics of one category.
+ */
+struct MemoryStats
+{
+	size_t	liveBytes;			///< Bytes currently allocated
+	size_t	peakBytes;			///< Largest value of liveBytes
+	size_t	liveAllocations;	///< Number of allocations currently alive
+	size_t	totalAllocations;	///< Number of allocations ever made
+	size_t	budget;				///< Budget in bytes, 0 if not set
+};
+
+/**
+ * Sets category of allocations made by the calling thread until the scope ends.
+ *
+ * Example:
+ *    core::MemoryCategoryScope scope(core::MEMORY_SCENE);
+ *    m_mesh = new graphics::Mesh(ib, vb); // Counted to MEMORY_MESH, classes can override the scope
+ *    m_node = new SceneNode();            // Counted to MEMORY_SCENE
+ */
+class MemoryCategoryScope
+{
+public:
+	MemoryCategoryScope( MemoryCategory category );
+	~MemoryCategoryScope();
+
+private:
+	MemoryCategory m_previous;
+
+	MemoryCategoryScope( const MemoryCategoryScope& );
+	MemoryCategoryScope& operator=( const MemoryCategoryScope& );
+};
+
+/** Returns allocator used, when none is given. System allocator by default. */
+Allocator* getDefaultAllocator();
+
+/** Sets default allocator. 0 restores the system allocator. Must be set before any allocations are made. */
+void setDefaultAllocator( Allocator* alloc );
+
+/** Returns category of the calling thread. */
+MemoryCategory getCurrentMemoryCategory();
+
+/** Returns statistics of the category. */
+MemoryStats getMemoryStats( MemoryCategory category );
+
+/** Returns name of the category ("mesh", "texture" etc.). */
+const char* getMemoryCategoryName( MemoryCategory category );
+
+/**
+ * Sets memory budget of the category (0 = no budget). Allocations are not refused, when the
+ * budget is exceeded, but a warning is printed once and isMemoryBudgetExceeded returns true,
+ * so subsystems can free memory (for example TextureStreamer).
+ */
+void setMemoryBudget( MemoryCategory category, size_t bytes );
+
+/** Returns true, if live bytes of the category exceed its budget. */
+bool isMemoryBudgetExceeded( MemoryCategory category );
+
+/** Prints statistics of all categories. */
+void printMemoryStats();
+
+}
+
+void* engineAllocMem(core::Allocator* alloc, size_t size, size_t alignment = 16, core::MemoryCategory category = core::MEMORY_CURRENT);
+void engineFreeMem(core::Allocator* alloc, void* p);
+
+void* engineAllocMem(size_t size);
+void engineFreeMem(void* p);
+
+/**
+ * engineAllocMem for class operator new. Throws std::bad_alloc instead of returning 0,
+ * so a constructor never runs on a null pointer.
+ */
+inline void* engineAllocObject( core::Allocator* alloc, size_t size, core::MemoryCategory category )
+{
+	void* p = engineAllocMem(alloc, size, 16, category);
+	if( p == 0 )
+	{
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+/**
+ * Routes new and delete of the class through engineAllocMem with given category.
+ * Object routes all its subclasses through the current category of the thread;
+ * use this in a class to count it (and its subclasses) to a fixed category.
+ */
+#define ENGINE_MEMORY_CATEGORY(category) \
+	static void* operator new( size_t size ) { return engineAllocObject(core::getDefaultAllocator(), size, category); } \
+	static void* operator new( size_t, void* place ) { return place; } \
+	static void operator delete( void* p ) { engineFreeMem(p); } \
+	static void operator delete( void*, void* ) {}
+
+#endif // _ALLOCATOR_H_
@@ -0,0 +1,211 @@
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Copyright (c) 2013 Mikko Romppainen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in the
+// Software without restriction, including without limitation the rights to use, copy,
+// modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+#ifndef _ASYNC_FILE_READER_H_
+#define _ASYNC_FILE_READER_H_
+
+#include <core/Object.h>
+#include <core/Ref.h>
+#include <stdint.h>
+#include <atomic>
+#include <deque>
+#include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace core
+{
+
+class AsyncReadRequest;
+class AsyncFileReader;
+struct IoUring;
+
+/**
+ * Called on an I/O thread, when a read has completed or failed. Not called for cancelled requests.
+ */
+typedef void (*AsyncReadCallback)( AsyncReadRequest* request, void* userData );
+
+/**
+ * Handle to a read submitted to AsyncFileReader. Works like a future: poll getStatus or
+ * block with wait.
+ */
+class AsyncReadRequest : public Object
+{
+public:
+	enum Status
+	{
+		STATUS_QUEUED = 0,
+		STATUS_READING,
+		STATUS_COMPLETED,
+		STATUS_FAILED,
+		STATUS_CANCELLED
+	};
+
+	virtual ~AsyncReadRequest();
+
+	Status getStatus() const;
+
+	/** Returns true, if the request has completed, failed or been cancelled. */
+	bool isFinished() const;
+
+	/** Blocks until the request is finished. */
+	void wait();
+
+	/** Returns read bytes. Valid when status is STATUS_COMPLETED. */
+	const uint8_t* getData() const;
+
+	/** Returns number of bytes read. Can be less than requested, if the file is shorter. */
+	int getSize() const;
+
+	const char* getFileName() const;
+
+private:
+	friend class AsyncFileReader;
+
+	AsyncReadRequest( const char* const fileName, int offset, int size, int priority,
+		AsyncReadCallback callback, void* userData );
+
+	void finish( Status status );
+
+	std::string				m_fileName;
+	int						m_offset;
+	int						m_requestedSize;	// -1 reads until the end of file
+	int						m_priority;
+	AsyncReadCallback		m_callback;
+	void*					m_userData;
+	std::vector<uint8_t>	m_buffer;
+	int						m_size;
+	std::atomic<int>		m_status;
+	std::mutex				m_mutex;
+	std::condition_variable	m_condition;
+
+	// io_uring backend state
+	int						m_fd;
+	int						m_bytesDone;
+
+	AsyncReadRequest();
+	AsyncReadRequest( const AsyncReadRequest& );
+	AsyncReadRequest& operator=( const AsyncReadRequest& );
+};
+
+/**
+ * Reads files in the background, so streaming can keep many reads in flight without a thread
+ * per request.
+ *
+ * Requests are served in priority order. Prefetch requests may use at most half of the
+ * in-flight slots (worker threads with the thread backend, at least one), so that reads for
+ * visible content do not wait behind them.
+ *
+ * Backends:
+ *  - BACKEND_THREADS: worker threads doing blocking reads through FileSystem. Supports pack files
+ *    and Android assets.
+ *  - BACKEND_IO_URING: one thread submitting reads to an io_uring. Compiled in on Linux, when
+ *    ENGINE_USE_IO_URING is defined. Used when the kernel allows it. Files, which are not loose
+ *    files on disk (pack entries), are read with a blocking read on the same thread.
+ *
+ * All functions are thread safe.
+ */
+class AsyncFileReader : public Object
+{
+public:
+	enum Priority
+	{
+		PRIORITY_VISIBLE = 0,	///< Needed for the current frame
+		PRIORITY_NORMAL,
+		PRIORITY_PREFETCH,		///< Might be needed later
+		NUM_PRIORITIES
+	};
+
+	enum Backend
+	{
+		BACKEND_THREADS = 0,
+		BACKEND_IO_URING
+	};
+
+	/**
+	 * Constructor.
+	 * @param numThreads Number of worker threads of the thread backend.
+	 * @param maxInFlight Maximum number of reads submitted at a time with the io_uring backend.
+	 */
+	AsyncFileReader( int numThreads = 2, int maxInFlight = 32 );
+
+	/** Destructor. Cancels queued requests and waits for reads in progress. */
+	virtual ~AsyncFileReader();
+
+	/**
+	 * Queues a read.
+	 * @param fileName File to read.
+	 * @param offset Offset of the first byte to read.
+	 * @param size Number of bytes to read, -1 reads until the end of file.
+	 * @param priority Priority of the request.
+	 * @param callback Called on I/O thread, when the read has finished. May be 0.
+	 * @param userData Passed to callback.
+	 * @return Request handle. Returned as Ref, because the read may finish before the caller
+	 *         gets to take a reference.
+	 */
+	Ref<AsyncReadRequest> read( const char* const fileName, int offset = 0, int size = -1,
+		Priority priority = PRIORITY_NORMAL, AsyncReadCallback callback = 0, void* userData = 0 );
+
+	/**
+	 * Cancels a request, which has not been started yet.
+	 * @return False, if the request is already being read or finished.
+	 */
+	bool cancel( AsyncReadRequest* request );
+
+	/** Changes priority of a queued request, for example when prefetched content becomes visible. */
+	void setPriority( AsyncReadRequest* request, Priority priority );
+
+	/** Returns number of queued and in progress requests. */
+	int getNumPending() const;
+
+	Backend getBackend() const;
+
+private:
+	Ref<AsyncReadRequest> popRequest( bool allowPrefetch );
+	bool removeQueued( AsyncReadRequest* request );
+	void complete( AsyncReadRequest* request, AsyncReadRequest::Status status );
+	void readBlocking( AsyncReadRequest* request );
+	void workerThread();
+	void uringThread();
+	bool startUring( AsyncReadRequest* request );
+	void wakeUp();
+
+	Backend											m_backend;
+	int												m_maxInFlight;
+	int												m_maxPrefetchReading;	// Thread backend
+	int												m_numPrefetchReading;	// Thread backend
+	std::deque< Ref<AsyncReadRequest> >				m_queues[NUM_PRIORITIES];
+	int												m_numPending;
+	bool											m_quit;
+	IoUring*										m_uring;		// io_uring backend, 0 if not used
+	std::vector<std::thread>						m_threads;
+	mutable std::mutex								m_mutex;
+	std::condition_variable							m_condition;
+
+	AsyncFileReader( const AsyncFileReader& );
+	AsyncFileReader& operator=( const AsyncFileReader& );
+};
+
+}
+
+#endif
@@ -24,6 +24,8 @@
 #include <core/Stream.h>
 
 #include <stdio.h>
+#include <stdint.h>
+#include <vector>
 
 #if defined(ANDROID)
 	struct AAsset;
@@ -34,6 +36,10 @@
 
 /**
  * Stream implementation for regular file system stream.
+ *
+ * File size is read once, when the file is opened. Reads are served from a read-ahead buffer,
+ * so parsers can do many small reads without a system call for each one. Reads larger than
+ * the buffer go straight to the file.
  */
 class FileStream : public Stream
 {
@@ -44,8 +50,18 @@ public:
 		READ_WRITE = 1
 	};
 
-	/** Constructor */
-	FileStream( const char* const fileName, FileOpenMode mode );
+	enum
+	{
+		DEFAULT_READ_AHEAD_SIZE = 4096
+	};
+
+	/**
+	 * Constructor.
+	 * @param fileName File to open.
+	 * @param mode READ_ONLY opens existing file. READ_WRITE creates new file.
+	 * @param readAheadSize Size of read-ahead buffer in bytes. 0 disables the buffer.
+	 */
+	FileStream( const char* const fileName, FileOpenMode mode, int readAheadSize = DEFAULT_READ_AHEAD_SIZE );
 	
 	/** Destructor */
 	virtual ~FileStream( );
@@ -71,21 +87,37 @@ public:
 	 */
 	virtual int	available() const;
 
+	virtual bool seek( int offset, SeekOrigin origin = ORIGIN_BEGIN );
+	virtual int tell() const;
+	virtual int size() const;
+
 	virtual int error() const;
+
+	/** Returns true, if the file exists. Does not open the file. */
+	static bool exists( const char* const fileName );
 	
 
 private:
+	// Platform specific unbuffered file access.
+	int readFile( void* p, int n );
+	void seekFile( int position );
+
 #if defined(_WIN32)
 	typedef FILE* FileHandleType;
 #elif defined(ANDROID)
 	typedef AAsset* FileHandleType;
-	long m_available;
 #else
 	Missing file handle type
 #endif
 
 	FileHandleType m_file;
 	FileOpenMode m_mode;
+	int m_size;
+	int m_position;				// Position seen by the user
+	int m_filePosition;			// Position of the underlying file
+	std::vector<uint8_t> m_buffer;
+	int m_bufferStart;			// File position of m_buffer[0]
+	int m_bufferLength;			// Number of valid bytes in m_buffer
 
 	FileStream();
 	FileStream( const FileStream& );
@@ -0,0 +1,80 @@
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Copyright (c) 2013 Mikko Romppainen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in the
+// Software without restriction, including without limitation the rights to use, copy,
+// modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+#ifndef _FILE_SYSTEM_H_
+#define _FILE_SYSTEM_H_
+
+#include <core/Stream.h>
+
+namespace core
+{
+
+/**
+ * Virtual file system for asset loading.
+ *
+ * Files are looked up from the mounted pack files first and from loose files on disk (or
+ * Android assets) after that. With loose file overrides enabled, a loose file replaces the
+ * packed one, so edited assets can be tested without rebuilding the pack.
+ *
+ * All functions are thread safe.
+ */
+class FileSystem
+{
+public:
+	/**
+	 * Mounts pack file. Packs mounted later are searched first.
+	 * @return False, if the pack could not be opened.
+	 */
+	static bool mountPack( const char* const fileName );
+
+	/** Unmounts all pack files. Streams already opened from packs stay valid. */
+	static void unmountAll();
+
+	/** Enables or disables loose files replacing packed files. Disabled by default. */
+	static void setLooseFileOverrides( bool enabled );
+
+	/**
+	 * Opens file for reading.
+	 * Packed files and loose files, which can be memory mapped, have Stream::data available.
+	 * @return New stream or 0, if the file does not exist.
+	 */
+	static Stream* openFile( const char* const fileName );
+
+	/**
+	 * Opens file for reading and makes sure, that Stream::data is available. Files, which
+	 * can not be mapped (for example Android assets), are read to memory.
+	 * @return New stream or 0, if the file does not exist or could not be read.
+	 */
+	static Stream* openFileInMemory( const char* const fileName );
+
+	/** Returns true, if the file exists in a pack or as a loose file. */
+	static bool exists( const char* const fileName );
+
+	/** Returns true, if openFile would open the file from a pack instead of a loose file. */
+	static bool isPacked( const char* const fileName );
+
+private:
+	FileSystem();
+};
+
+}
+
+#endif
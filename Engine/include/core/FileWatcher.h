@@ -0,0 +1,91 @@
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Copyright (c) 2013 Mikko Romppainen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in the
+// Software without restriction, including without limitation the rights to use, copy,
+// modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+#ifndef _FILE_WATCHER_H_
+#define _FILE_WATCHER_H_
+
+#include <core/Object.h>
+#include <vector>
+#include <string>
+#include <mutex>
+
+namespace core
+{
+
+/**
+ * Watches files for modifications.
+ *
+ * Directories of the watched files are watched instead of the files itself, because most
+ * editors save by writing a temporary file and renaming it over the original. Uses inotify
+ * on Linux (and Android) and directory change notifications on Windows.
+ *
+ * addFile can be called from any thread. poll is meant to be called from one (background)
+ * thread only.
+ */
+class FileWatcher : public Object
+{
+public:
+	FileWatcher();
+
+	virtual ~FileWatcher();
+
+	/**
+	 * Starts watching given file.
+	 * @return false, if directory of the file can not be watched.
+	 */
+	bool addFile(const char* const fileName);
+
+	/**
+	 * Waits for file modifications at most timeoutMs milliseconds.
+	 * @param changedFiles [out] Names of modified files (as given to addFile) are appended to this.
+	 */
+	void poll(std::vector<std::string>& changedFiles, int timeoutMs);
+
+private:
+	struct WatchedDirectory
+	{
+		std::string					path;
+		std::vector<std::string>	files;		// File names without directory part
+		std::vector<std::string>	fullNames;	// File names as given to addFile
+#if defined(_WIN32)
+		void*						handle;
+		std::vector<long long>		writeTimes;
+#else
+		int							wd;
+#endif
+	};
+
+	WatchedDirectory* findDirectory(const std::string& path);
+	void fileChanged(WatchedDirectory* dir, const char* const name, std::vector<std::string>& changedFiles);
+
+	std::mutex						m_mutex;
+	std::vector<WatchedDirectory*>	m_directories;
+#if !defined(_WIN32)
+	int								m_fd;
+#endif
+
+	FileWatcher( const FileWatcher& );
+	FileWatcher& operator=( const FileWatcher& );
+};
+
+}
+
+#endif
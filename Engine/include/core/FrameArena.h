@@ -0,0 +1,194 @@
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Copyright (c) 2013 Mikko Romppainen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in the
+// Software without restriction, including without limitation the rights to use, copy,
+// modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+#ifndef _FRAME_ARENA_H_
+#define _FRAME_ARENA_H_
+
+#include <core/Object.h>
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+namespace core
+{
+
+/**
+ * Linear allocator for data, which lives at most a few frames (culling lists, uniform
+ * staging, per-frame matrices).
+ *
+ * Memory is split to numFrames buffers. Allocation bumps an offset in the buffer of the
+ * current frame and nextFrame moves to the next buffer and resets it in one go, so memory
+ * allocated in a frame stays valid until nextFrame has been called numFrames times
+ * (for example while the GPU still reads uniform data of the previous frame).
+ * Nothing is freed individually. If a buffer runs out, allocations fall back to the
+ * backing allocator until the end of the frame and the overflow is reported by
+ * getOverflowBytes, so the arena size can be tuned.
+ *
+ * allocate is thread-safe. nextFrame must not be called concurrently with allocate.
+ */
+class FrameArena : public Object
+{
+public:
+	/**
+	 * Constructor.
+	 * @param bytesPerFrame Size of each frame buffer.
+	 * @param numFrames Number of frame buffers (2 = double buffered, 3 = triple buffered).
+	 * @param alloc Backing allocator. 0 uses the default allocator.
+	 */
+	FrameArena( size_t bytesPerFrame, int numFrames = 2, Allocator* alloc = 0 );
+
+	/** Destructor. Frees all frame buffers. */
+	virtual ~FrameArena();
+
+	/** Allocates size bytes aligned to alignment (power of two). Never returns 0. */
+	void* allocate( size_t size, size_t alignment = 16 );
+
+	/** Allocates uninitialized array of count elements of type T. */
+	template <class T>
+	T* allocateArray( size_t count );
+
+	/** Moves to the next frame buffer and resets it. Call once per frame. */
+	void nextFrame();
+
+	/** Bytes allocated in the current frame. */
+	size_t getUsedBytes() const;
+
+	/** Largest value of getUsedBytes at the end of a frame. */
+	size_t getPeakBytes() const;
+
+	/** Size of each frame buffer. */
+	size_t getCapacity() const;
+
+	/** Bytes, which did not fit to the frame buffer in the current frame. */
+	size_t getOverflowBytes() const;
+
+private:
+	struct Frame
+	{
+		uint8_t*			buffer;
+		std::vector<void*>	overflow;
+	};
+
+	Allocator*				m_alloc;
+	std::vector<Frame>		m_frames;
+	size_t					m_capacity;
+	int						m_current;
+	std::atomic<size_t>		m_offset;
+	std::atomic<size_t>		m_overflowBytes;
+	size_t					m_peak;
+	bool					m_overflowWarned;
+	std::mutex				m_overflowMutex;
+
+	FrameArena( const FrameArena& );
+	FrameArena& operator=( const FrameArena& );
+};
+
+template <class T>
+T* FrameArena::allocateArray( size_t count )
+{
+	return static_cast<T*>(allocate(count*sizeof(T), alignof(T) > 16 ? alignof(T) : 16));
+}
+
+/**
+ * STL allocator adapter for FrameArena. Deallocation does nothing, memory is reclaimed
+ * by FrameArena::nextFrame. Default constructed adapter (no arena) uses engineAllocMem,
+ * so containers work also without an arena.
+ *
+ * Example:
+ *    core::FrameVector<int> visible(core::FrameAllocator<int>(m_frameArena));
+ *    visible.reserve(casters.size());
+ */
+template <class T>
+class FrameAllocator
+{
+public:
+	typedef T			value_type;
+	typedef T*			pointer;
+	typedef const T*	const_pointer;
+	typedef T&			reference;
+	typedef const T&	const_reference;
+	typedef size_t		size_type;
+	typedef ptrdiff_t	difference_type;
+
+	template <class U>
+	struct rebind
+	{
+		typedef FrameAllocator<U> other;
+	};
+
+	FrameAllocator( FrameArena* arena = 0 )
+	: m_arena(arena)
+	{
+	}
+
+	template <class U>
+	FrameAllocator( const FrameAllocator<U>& o )
+	: m_arena(o.getArena())
+	{
+	}
+
+	T* allocate( size_t n )
+	{
+		if( m_arena )
+		{
+			return m_arena->allocateArray<T>(n);
+		}
+
+		return static_cast<T*>(engineAllocMem(getDefaultAllocator(), n*sizeof(T), alignof(T) > 16 ? alignof(T) : 16));
+	}
+
+	void deallocate( T* p, size_t )
+	{
+		if( !m_arena )
+		{
+			engineFreeMem(p);
+		}
+	}
+
+	FrameArena* getArena() const
+	{
+		return m_arena;
+	}
+
+	template <class U>
+	bool operator==( const FrameAllocator<U>& o ) const
+	{
+		return m_arena == o.getArena();
+	}
+
+	template <class U>
+	bool operator!=( const FrameAllocator<U>& o ) const
+	{
+		return m_arena != o.getArena();
+	}
+
+private:
+	FrameArena* m_arena;
+};
+
+/** Vector allocated from FrameArena. */
+template <class T>
+using FrameVector = std::vector< T, FrameAllocator<T> >;
+
+}
+
+#endif // _FRAME_ARENA_H_
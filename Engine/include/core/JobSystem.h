@@ -0,0 +1,225 @@
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Copyright (c) 2013 Mikko Romppainen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in the
+// Software without restriction, including without limitation the rights to use, copy,
+// modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+#ifndef _JOB_SYSTEM_H_
+#define _JOB_SYSTEM_H_
+
+#include <core/Object.h>
+#include <atomic>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace core
+{
+
+typedef void (*JobFunction)( void* data );
+
+/**
+ * Counts unfinished jobs. Wait for it with JobSystem::wait or use it as a dependency
+ * with JobSystem::runAfter. Must outlive the jobs it counts.
+ */
+class JobCounter
+{
+public:
+	JobCounter();
+	~JobCounter();
+
+	/** Returns true, if all counted jobs have finished. */
+	bool isDone() const;
+
+private:
+	friend class JobSystem;
+
+	struct Continuation
+	{
+		JobFunction	function;
+		void*		data;
+		JobCounter*	counter;
+	};
+
+	int							m_count;
+	mutable std::mutex			m_mutex;
+	std::vector<Continuation>	m_continuations;	// Jobs started, when count reaches zero
+
+	JobCounter( const JobCounter& );
+	JobCounter& operator=( const JobCounter& );
+};
+
+/**
+ * Runs small jobs on a pool of worker threads.
+ *
+ * Each worker has its own deque. Workers take their newest job first and steal the oldest jobs
+ * of other workers, when they run out. Jobs submitted from other threads go to a shared queue.
+ * Threads waiting for a counter run jobs meanwhile, so jobs can start and wait for other jobs.
+ *
+ * Jobs, which need the GL context, are run with runOnMainThread. They are executed by
+ * runMainThreadJobs, which the platform main loop calls once per frame, or while the main
+ * thread waits for a counter. The main thread is the thread, which created the job system.
+ */
+class JobSystem : public Object
+{
+public:
+	/**
+	 * Constructor.
+	 * @param numWorkers Number of worker threads. -1 = number of hardware threads minus one.
+	 */
+	JobSystem( int numWorkers = -1 );
+
+	/** Destructor. Finishes queued jobs and stops the workers. */
+	virtual ~JobSystem();
+
+	/**
+	 * Queues a job.
+	 * @param function Function to run.
+	 * @param data Passed to function.
+	 * @param counter Incremented now and decremented, when the job has finished. May be 0.
+	 */
+	void run( JobFunction function, void* data, JobCounter* counter = 0 );
+
+	/** Queues a job, when all jobs counted by dependency have finished. */
+	void runAfter( JobCounter* dependency, JobFunction function, void* data, JobCounter* counter = 0 );
+
+	/** Queues a job to be run on the main thread. */
+	void runOnMainThread( JobFunction function, void* data, JobCounter* counter = 0 );
+
+	/** Runs jobs queued with runOnMainThread. Call from the main thread only. */
+	void runMainThreadJobs();
+
+	/** Runs other jobs until all jobs counted by counter have finished. Sleeps while there is nothing to run. */
+	void wait( JobCounter* counter );
+
+	/**
+	 * Calls func(first, last) for batches of the index range [begin, end) in parallel and waits
+	 * for all of them. The calling thread runs the first batch.
+	 * @param minBatchSize Smallest number of indices in a batch.
+	 * @param maxBatches Maximum number of batches. 0 = a few batches per thread.
+	 */
+	template<class Func>
+	void parallelFor( int begin, int end, int minBatchSize, const Func& func, int maxBatches = 0 );
+
+	/** Returns number of worker threads. */
+	int getNumWorkers() const;
+
+	/** Returns true, if called on the thread, which created the job system. */
+	bool isMainThread() const;
+
+private:
+	struct Job
+	{
+		JobFunction	function;
+		void*		data;
+		JobCounter*	counter;
+	};
+
+	struct WorkerQueue
+	{
+		std::mutex			mutex;
+		std::deque<Job>		jobs;
+	};
+
+	template<class Func>
+	struct Batch
+	{
+		const Func*	func;
+		int			begin;
+		int			end;
+
+		static void run( void* data )
+		{
+			Batch* batch = (Batch*)data;
+			(*batch->func)(batch->begin, batch->end);
+		}
+	};
+
+	void push( const Job& job );
+	bool tryRunOne();
+	void execute( const Job& job );
+	bool hasMainThreadJobs();
+	void workerThread( int index );
+
+	std::vector<WorkerQueue*>	m_queues;			// One per worker and a shared one for other threads
+	std::vector<std::thread>	m_threads;
+	std::thread::id				m_mainThread;
+	std::mutex					m_mainThreadMutex;
+	std::deque<Job>				m_mainThreadJobs;
+	std::atomic<int>			m_numQueued;
+	std::mutex					m_sleepMutex;
+	std::condition_variable		m_sleepCondition;	// Idle workers
+	std::condition_variable		m_waitCondition;	// Threads in wait
+	int							m_numWaiting;		// Guarded by m_sleepMutex
+	bool						m_quit;
+
+	JobSystem( const JobSystem& );
+	JobSystem& operator=( const JobSystem& );
+};
+
+/** Returns the engine job system. Created on first call, call first from the main thread. */
+JobSystem* getJobSystem();
+
+template<class Func>
+void JobSystem::parallelFor( int begin, int end, int minBatchSize, const Func& func, int maxBatches )
+{
+	const int count = end - begin;
+	if( count <= 0 )
+	{
+		return;
+	}
+
+	int numBatches = maxBatches > 0 ? maxBatches : (getNumWorkers() + 1) * 4;
+	if( minBatchSize > 0 && numBatches > count / minBatchSize )
+	{
+		numBatches = count / minBatchSize;
+	}
+
+	if( numBatches > count )
+	{
+		numBatches = count;
+	}
+
+	if( numBatches <= 1 )
+	{
+		func(begin, end);
+		return;
+	}
+
+	std::vector< Batch<Func> > batches(numBatches);
+	JobCounter counter;
+	for( int i = 0; i < numBatches; ++i )
+	{
+		batches[i].func = &func;
+		batches[i].begin = begin + (int)((long long)count * i / numBatches);
+		batches[i].end = begin + (int)((long long)count * (i + 1) / numBatches);
+		if( i > 0 )
+		{
+			run(&Batch<Func>::run, &batches[i], &counter);
+		}
+	}
+
+	Batch<Func>::run(&batches[0]);
+	wait(&counter);
+}
+
+}
+
+#endif
@@ -0,0 +1,64 @@
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Copyright (c) 2013 Mikko Romppainen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in the
+// Software without restriction, including without limitation the rights to use, copy,
+// modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+#ifndef _LZ4_H_
+#define _LZ4_H_
+
+#include <stdint.h>
+
+namespace core
+{
+
+/**
+ * LZ4 block format compression.
+ *
+ * Output is compatible with the reference LZ4 block format, so data can also be packed with
+ * the standard lz4 tools. The compressor is a simple greedy one, which favours speed over ratio.
+ */
+namespace lz4
+{
+	/** Returns maximum compressed size of srcSize bytes. */
+	int compressBound( int srcSize );
+
+	/**
+	 * Compresses a block.
+	 * @param src Data to compress.
+	 * @param srcSize Size of data.
+	 * @param dst [out] Receives compressed data.
+	 * @param dstCapacity Size of dst buffer. compressBound(srcSize) is always enough.
+	 * @return Compressed size or 0, if the result does not fit to dst.
+	 */
+	int compress( const void* src, int srcSize, void* dst, int dstCapacity );
+
+	/**
+	 * Decompresses a block. Malformed input is detected, it never reads or writes out of bounds.
+	 * @param src Compressed data.
+	 * @param srcSize Size of compressed data.
+	 * @param dst [out] Receives decompressed data.
+	 * @param dstCapacity Size of dst buffer.
+	 * @return Decompressed size or -1, if the data is corrupted or does not fit to dst.
+	 */
+	int decompress( const void* src, int srcSize, void* dst, int dstCapacity );
+}
+
+}
+
+#endif
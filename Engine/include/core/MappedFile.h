@@ -0,0 +1,94 @@
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Copyright (c) 2013 Mikko Romppainen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in the
+// Software without restriction, including without limitation the rights to use, copy,
+// modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+#ifndef _MAPPED_FILE_H_
+#define _MAPPED_FILE_H_
+
+#include <core/Object.h>
+#include <stdint.h>
+
+#if defined(ANDROID)
+	struct AAsset;
+#endif
+
+namespace core
+{
+
+/**
+ * Read only view of whole file contents mapped to memory.
+ *
+ * The file is mapped with MapViewOfFile on Windows and mmap on other desktop platforms.
+ * On Android the file is an asset, which is opened with AASSET_MODE_BUFFER, so uncompressed
+ * assets are mapped straight from the apk.
+ */
+class MappedFile : public Object
+{
+public:
+	enum AccessHint
+	{
+		ACCESS_NORMAL = 0,
+		ACCESS_SEQUENTIAL,		///< Pages are read once in order. Read ahead aggressively.
+		ACCESS_RANDOM,			///< Pages are read in random order. Do not read ahead.
+		ACCESS_WILLNEED			///< Whole range is needed soon. Start reading it now.
+	};
+
+	/** Maps the file. Use isValid to check, if the file could be opened. */
+	MappedFile( const char* const fileName );
+
+	/** Destructor. Unmaps the file. */
+	virtual ~MappedFile();
+
+	/** Returns true, if the file is mapped. */
+	bool isValid() const;
+
+	/** Returns pointer to the file contents or 0 if the file could not be mapped. */
+	const uint8_t* getData() const;
+
+	/** Returns size of the file in bytes. */
+	int getSize() const;
+
+	/**
+	 * Tells the operating system how the mapped range is going to be accessed.
+	 * Uses madvise where mmap is available, otherwise does nothing.
+	 * @param hint Expected access pattern.
+	 * @param offset Start of the range in bytes.
+	 * @param size Size of the range in bytes. -1 means until the end of file.
+	 */
+	void advise( AccessHint hint, int offset = 0, int size = -1 ) const;
+
+private:
+	const uint8_t*	m_data;
+	int				m_size;
+#if defined(_WIN32)
+	void*			m_file;
+	void*			m_mapping;
+#elif defined(ANDROID)
+	AAsset*			m_asset;
+#endif
+
+	MappedFile();
+	MappedFile( const MappedFile& );
+	MappedFile& operator=( const MappedFile& );
+};
+
+}
+
+#endif
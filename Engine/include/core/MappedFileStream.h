@@ -0,0 +1,85 @@
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Copyright (c) 2013 Mikko Romppainen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in the
+// Software without restriction, including without limitation the rights to use, copy,
+// modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+#ifndef _MAPPED_FILE_STREAM_H_
+#define _MAPPED_FILE_STREAM_H_
+
+#include <core/Stream.h>
+#include <core/MappedFile.h>
+#include <core/FileStream.h>
+#include <core/Ref.h>
+#include <stdint.h>
+
+namespace core
+{
+
+/**
+ * Read only stream over a memory mapped file.
+ *
+ * Reads are plain copies from the mapping and data() gives direct access to the file
+ * contents, so parsers and GPU uploads can use the bytes without an intermediate copy.
+ * If the file can not be mapped, the stream falls back to a buffered FileStream and
+ * data() returns 0.
+ */
+class MappedFileStream : public Stream
+{
+public:
+	/**
+	 * Opens and maps the file.
+	 * @param fileName File to open.
+	 * @param hint Expected access pattern of the mapped file.
+	 */
+	MappedFileStream( const char* const fileName, MappedFile::AccessHint hint = MappedFile::ACCESS_SEQUENTIAL );
+
+	/** Destructor */
+	virtual ~MappedFileStream();
+
+	/** Not supported. Stream is read only. */
+	virtual void write( const void* p, int n );
+
+	virtual int read( void* p, int n );
+	virtual int	available() const;
+	virtual bool seek( int offset, SeekOrigin origin = ORIGIN_BEGIN );
+	virtual int tell() const;
+	virtual int size() const;
+
+	/**
+	 * Returns pointer to the whole file contents, or 0 if the file is not mapped.
+	 * Pointer stays valid for the lifetime of the stream.
+	 */
+	virtual const uint8_t* data() const;
+
+	/** Returns true, if the file is memory mapped. */
+	bool isMapped() const;
+
+private:
+	Ref<MappedFile>	m_file;
+	Ref<FileStream>	m_fallback;		// Used, if the file could not be mapped
+	int				m_position;
+
+	MappedFileStream();
+	MappedFileStream( const MappedFileStream& );
+	MappedFileStream& operator=( const MappedFileStream& );
+};
+
+}
+
+#endif
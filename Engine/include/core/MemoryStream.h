@@ -0,0 +1,85 @@
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Copyright (c) 2013 Mikko Romppainen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in the
+// Software without restriction, including without limitation the rights to use, copy,
+// modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+#ifndef _MEMORY_STREAM_H_
+#define _MEMORY_STREAM_H_
+
+#include <core/Stream.h>
+#include <core/Ref.h>
+#include <stdint.h>
+#include <vector>
+
+namespace core
+{
+
+/**
+ * Stream over a block of memory.
+ *
+ * The stream either owns a growable buffer, which can be written and read, or is a read only
+ * view to memory owned by someone else (for example a mapped pack file).
+ */
+class MemoryStream : public Stream
+{
+public:
+	/**
+	 * Creates writable stream with an owned buffer.
+	 * @param size Initial size of the buffer in bytes. Contents are zero.
+	 */
+	explicit MemoryStream( int size = 0 );
+
+	/**
+	 * Creates read only view to memory.
+	 * @param data Memory to read.
+	 * @param size Size of the memory in bytes.
+	 * @param owner Object owning the memory. Kept alive as long as the stream. May be 0.
+	 */
+	MemoryStream( const void* data, int size, Object* owner );
+
+	/** Destructor */
+	virtual ~MemoryStream();
+
+	/** Writes at current position and grows the buffer if needed. Owned buffers only. */
+	virtual void write( const void* p, int n );
+
+	virtual int read( void* p, int n );
+	virtual int	available() const;
+	virtual bool seek( int offset, SeekOrigin origin = ORIGIN_BEGIN );
+	virtual int tell() const;
+	virtual int size() const;
+	virtual const uint8_t* data() const;
+
+	/** Returns writable pointer to owned buffer, or 0 for read only views. */
+	uint8_t* getBuffer();
+
+private:
+	std::vector<uint8_t>	m_buffer;
+	const uint8_t*			m_data;
+	int						m_size;
+	int						m_position;
+	Ref<Object>				m_owner;
+
+	MemoryStream( const MemoryStream& );
+	MemoryStream& operator=( const MemoryStream& );
+};
+
+}
+
+#endif
@@ -22,40 +22,73 @@
 #ifndef _OBJECT_H_
 #define _OBJECT_H_
 #include <new>
+#include <atomic>
 #include <es_assert.h>
+#include <core/Allocator.h>
 
 namespace core
 {
-	class Allocator;
 
 class Object
 {
 public:
+	// How reference count is updated.
+	enum RefCountMode
+	{
+		// References can be added and released from any thread.
+		REFCOUNT_ATOMIC,
+		// Object never leaves the thread, which created it. Skips locked instructions.
+		REFCOUNT_SINGLE_THREAD
+	};
+
 	Object();
 
     virtual ~Object();
 
+	// Objects are allocated with engineAllocMem in the current category of the thread.
+	ENGINE_MEMORY_CATEGORY(core::MEMORY_CURRENT)
+
 	inline void addRef()
 	{
-		assert( m_numOfRefs >= 0 );
-		++m_numOfRefs;
+		assert( getRefCount() >= 0 );
+		if( m_singleThread )
+		{
+			m_numOfRefs.store(m_numOfRefs.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		}
+		else
+		{
+			// New reference is made from an existing one, so no ordering is needed.
+			m_numOfRefs.fetch_add(1, std::memory_order_relaxed);
+		}
 	}
 
     inline int releaseRef()
 	{
- 		assert( m_numOfRefs > 0 );
-		return --m_numOfRefs;
+ 		assert( getRefCount() > 0 );
+		if( m_singleThread )
+		{
+			const int refs = m_numOfRefs.load(std::memory_order_relaxed) - 1;
+			m_numOfRefs.store(refs, std::memory_order_relaxed);
+			return refs;
+		}
+
+		// Release orders this thread's writes to the object before the decrement, acquire
+		// makes writes of other threads visible to the thread, which deletes the object.
+		return m_numOfRefs.fetch_sub(1, std::memory_order_acq_rel) - 1;
 	}
 
 	inline int getRefCount() const
 	{
-		return m_numOfRefs;
+		return m_numOfRefs.load(std::memory_order_relaxed);
 	}
 
+protected:
+	explicit Object(RefCountMode mode);
 
 private:
 	// Member variables
-	int m_numOfRefs;
+	std::atomic<int>	m_numOfRefs;
+	bool				m_singleThread;
 
 	// Non-allowed methods (declared but not defined anywhere, result link error if used)
 	Object( const Object& );
@@ -66,12 +99,6 @@ private:
 }
 
 
-void* engineAllocMem(core::Allocator* alloc, size_t size, size_t alignment = 16);
-void engineFreeMem(core::Allocator* alloc, void* p);
-
-void* engineAllocMem(size_t size);
-void engineFreeMem(void* p);
-
 /**
  * About the realloc function:
  * void * engineReallocMem(void *ud, void *ptr, size_t osize, size_t nsize);
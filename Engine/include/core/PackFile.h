@@ -0,0 +1,167 @@
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Copyright (c) 2013 Mikko Romppainen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in the
+// Software without restriction, including without limitation the rights to use, copy,
+// modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+#ifndef _PACK_FILE_H_
+#define _PACK_FILE_H_
+
+#include <core/Object.h>
+#include <core/Ref.h>
+#include <core/MappedFile.h>
+#include <core/Stream.h>
+#include <stdint.h>
+#include <vector>
+#include <string>
+
+namespace core
+{
+
+/**
+ * Archive of many asset files in one file.
+ *
+ * Layout (little endian):
+ *  - PackHeader
+ *  - PackEntry table, sorted by name hash
+ *  - Null terminated entry names
+ *  - File data. Uncompressed files start at page boundary, so they can be used straight from
+ *    the mapping. Compressed files are split to independently compressed blocks, each prefixed
+ *    with its stored size. Blocks, which do not compress, are stored raw (STORED_RAW_BIT set).
+ *
+ * The whole pack is memory mapped, so opening it costs one file open and looking up an entry
+ * is a binary search of the hashed table of contents.
+ */
+class PackFile : public Object
+{
+public:
+	enum Compression
+	{
+		COMPRESSION_NONE = 0,
+		COMPRESSION_LZ4 = 1
+	};
+
+	enum
+	{
+		MAGIC = 0x4b504752,				///< "RGPK"
+		VERSION = 1,
+		DATA_ALIGNMENT = 4096,			///< Alignment of uncompressed file data
+		STORED_RAW_BIT = 0x80000000		///< Set in block size, if block is not compressed
+	};
+
+	struct PackHeader
+	{
+		uint32_t	magic;
+		uint32_t	version;
+		uint32_t	numEntries;
+		uint32_t	blockSize;			///< Uncompressed size of compression blocks
+	};
+
+	struct PackEntry
+	{
+		uint64_t	nameHash;
+		uint32_t	nameOffset;			///< Offset of the name from the start of the pack
+		uint32_t	dataOffset;			///< Offset of the data from the start of the pack
+		uint32_t	size;				///< Uncompressed size
+		uint32_t	storedSize;			///< Size in the pack
+		uint32_t	compression;
+		uint32_t	reserved;
+	};
+
+	/** Maps the pack file. Use isValid to check, if the file is a valid pack. */
+	PackFile( const char* const fileName );
+
+	/** Destructor */
+	virtual ~PackFile();
+
+	/** Returns true, if the pack was opened successfully. */
+	bool isValid() const;
+
+	/** Returns true, if the pack contains the file. */
+	bool contains( const char* const fileName ) const;
+
+	/**
+	 * Opens file in the pack.
+	 * Uncompressed files are read straight from the mapping, compressed ones are decompressed
+	 * to memory. Stream::data is valid for both.
+	 * @return New stream or 0, if the file is not in the pack or is corrupted.
+	 */
+	Stream* open( const char* const fileName ) const;
+
+	/** Returns number of files in the pack. */
+	int getNumEntries() const;
+
+	/**
+	 * Returns hash of the file name. Names are case insensitive and both slashes
+	 * are accepted as directory separator.
+	 */
+	static uint64_t hashName( const char* const fileName );
+
+private:
+	const PackEntry* findEntry( const char* const fileName ) const;
+
+	Ref<MappedFile>		m_file;
+	const PackHeader*	m_header;
+	const PackEntry*	m_entries;
+
+	PackFile();
+	PackFile( const PackFile& );
+	PackFile& operator=( const PackFile& );
+};
+
+/**
+ * Builds pack files. Files are collected to memory and written with write.
+ */
+class PackWriter
+{
+public:
+	/**
+	 * Constructor.
+	 * @param blockSize Uncompressed size of independently compressed blocks.
+	 */
+	PackWriter( int blockSize = 64*1024 );
+
+	/**
+	 * Adds file to the pack. Data is copied.
+	 * Compressed files are stored uncompressed, if compression saves less than 1/8 of the size.
+	 */
+	void addFile( const char* const fileName, const void* data, int size,
+		PackFile::Compression compression = PackFile::COMPRESSION_LZ4 );
+
+	/** Writes the pack to stream. Returns false, if file names collide. */
+	bool write( Stream* stream ) const;
+
+private:
+	struct File
+	{
+		std::string				name;
+		uint64_t				nameHash;
+		int						size;
+		PackFile::Compression	compression;
+		std::vector<uint8_t>	data;		// Stored data
+	};
+
+	static bool compareHash( const File* a, const File* b );
+
+	int					m_blockSize;
+	std::vector<File>	m_files;
+};
+
+}
+
+#endif
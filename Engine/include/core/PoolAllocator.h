@@ -0,0 +1,127 @@
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Copyright (c) 2013 Mikko Romppainen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in the
+// Software without restriction, including without limitation the rights to use, copy,
+// modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+#ifndef _POOL_ALLOCATOR_H_
+#define _POOL_ALLOCATOR_H_
+
+#include <core/Allocator.h>
+#include <stdint.h>
+#include <mutex>
+#include <vector>
+
+// Freed blocks are filled with 0xDD and checked on reuse, new blocks are filled with 0xCD.
+#if !defined(ENGINE_POOL_POISON)
+#if defined(_DEBUG)
+#define ENGINE_POOL_POISON 1
+#else
+#define ENGINE_POOL_POISON 0
+#endif
+#endif
+
+namespace core
+{
+
+/**
+ * Allocator for small blocks (at most MAX_BLOCK_SIZE bytes).
+ *
+ * Blocks are rounded up to size classes and carved from large slabs, so objects of similar
+ * size are packed together and allocation is a free list pop. Each thread keeps a small cache
+ * of free blocks per size class and exchanges them with the shared lists in batches, so
+ * threads rarely take the lock. Larger blocks are passed to the backing allocator.
+ *
+ * Memory of slabs is returned to the backing allocator only when the pool is destroyed.
+ * Pools must outlive all threads, which allocate from them.
+ */
+class PoolAllocator : public Allocator
+{
+public:
+	enum
+	{
+		MAX_BLOCK_SIZE	= 256,
+		NUM_CLASSES		= 12,
+		MAX_POOLS		= 8		///< Pools with thread caches. Further pools lock on every call.
+	};
+
+	/**
+	 * Constructor.
+	 * @param alloc Backing allocator for slabs and large blocks. 0 uses the system allocator.
+	 * @param slabSize Bytes allocated from the backing allocator at a time.
+	 */
+	PoolAllocator( Allocator* alloc = 0, size_t slabSize = 64*1024 );
+
+	/** Destructor. Frees all slabs. */
+	virtual ~PoolAllocator();
+
+	virtual void* allocate( size_t size, size_t alignment );
+	virtual void deallocate( void* p, size_t size );
+
+	/** Returns bytes reserved by slabs. */
+	size_t getReservedBytes() const;
+
+	/** Returns size class block size for size, or 0 if size is too large for the pool. */
+	static size_t getBlockSize( size_t size );
+
+private:
+	friend struct PoolThreadCache;
+
+	struct FreeBlock
+	{
+		FreeBlock* next;
+	};
+
+	struct SizeClass
+	{
+		FreeBlock*	freeList;
+		size_t		numFree;
+		uint8_t*	slabCursor;		// Uncarved part of the newest slab
+		uint8_t*	slabEnd;
+	};
+
+	void refill( int sizeClass, FreeBlock*& list, int& count );
+	void release( int sizeClass, FreeBlock* first, FreeBlock* last, int count );
+
+	Allocator*				m_alloc;
+	size_t					m_slabSize;
+	int						m_id;
+	SizeClass				m_classes[NUM_CLASSES];
+	std::vector<uint8_t*>	m_slabs;
+	mutable std::mutex		m_mutex;
+
+	PoolAllocator( const PoolAllocator& );
+	PoolAllocator& operator=( const PoolAllocator& );
+};
+
+/** Returns pool shared by small engine objects. Backed by the default allocator. */
+PoolAllocator* getObjectPool();
+
+}
+
+/**
+ * Like ENGINE_MEMORY_CATEGORY, but allocates the objects from the shared object pool
+ * (core::getObjectPool). Use for small classes, which are created in large numbers.
+ */
+#define ENGINE_POOLED_MEMORY_CATEGORY(category) \
+	static void* operator new( size_t size ) { return engineAllocObject(core::getObjectPool(), size, category); } \
+	static void* operator new( size_t, void* place ) { return place; } \
+	static void operator delete( void* p ) { engineFreeMem(p); } \
+	static void operator delete( void*, void* ) {}
+
+#endif // _POOL_ALLOCATOR_H_
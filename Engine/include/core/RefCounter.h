@@ -24,6 +24,11 @@
 
 #define SHOW_LEAKS
 
+#include <atomic>
+#if defined(MEMORY_LEAK_DEBUGGING)
+#include <mutex>
+#endif
+
 namespace core
 {
 	class Object;
@@ -42,7 +47,7 @@ namespace core
 #if defined(SHOW_LEAKS)
             if( refs != 0 )
             {
-				printf("[%s] %d Memory leaks detected!", __FUNCTION__, refs);
+				printf("[%s] %d Memory leaks detected!", __FUNCTION__, refs.load());
 #if defined(MEMORY_LEAK_DEBUGGING)
                 for( size_t i=0; i<m_objects.size(); ++i )
                 {
@@ -61,21 +66,25 @@ namespace core
         }
 
 	
+		// Objects can be created and deleted on any thread. Only the count is kept, so
+		// relaxed ordering is enough.
 		void add(Object* o, const char* const name)
         {
 #if defined(MEMORY_LEAK_DEBUGGING)
+			std::lock_guard<std::mutex> lock(m_mutex);
             m_objects.push_back(o);
             m_objectNames.push_back(name);
 #else
 			(void)name;
 			(void)o;
 #endif
-            ++refs;
+            refs.fetch_add(1, std::memory_order_relaxed);
         }
 
 		void release(core::Object* o)
         {
 #if defined(MEMORY_LEAK_DEBUGGING)
+			std::lock_guard<std::mutex> lock(m_mutex);
             size_t index = 0;
 			
 			for( ; index<m_objects.size(); ++index )
@@ -91,15 +100,16 @@ namespace core
 #else
 			(void)o;
 #endif
-            --refs;
+            refs.fetch_sub(1, std::memory_order_relaxed);
         }
 
     private:
 #if defined(MEMORY_LEAK_DEBUGGING)
         std::vector<Object*> m_objects;
         std::vector<eastl::string> m_objectNames;
+		std::mutex m_mutex;
 #endif
-        int refs;
+        std::atomic<int> refs;
 	public:
 	
 		
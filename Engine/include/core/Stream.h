@@ -23,6 +23,7 @@
 #define _STREAM_H_
 
 #include <core/Object.h>
+#include <stdint.h>
 
 namespace core
 {
@@ -33,7 +34,13 @@ namespace core
 class Stream : public Object
 {
 public:
-	
+	enum SeekOrigin
+	{
+		ORIGIN_BEGIN = 0,
+		ORIGIN_CURRENT = 1,
+		ORIGIN_END = 2
+	};
+
 	/** Destructor */
 	virtual ~Stream() {};
 
@@ -59,6 +66,30 @@ public:
 	 */
 	virtual int	available() const = 0;
 
+	/**
+	 * Moves read/write position of the stream.
+	 * @param offset Offset in bytes relative to origin.
+	 * @param origin Position, where the offset is counted from.
+	 * @return False, if the new position would be outside of the stream.
+	 */
+	virtual bool seek( int offset, SeekOrigin origin = ORIGIN_BEGIN ) = 0;
+
+	/**
+	 * Returns current read/write position from the beginning of the stream.
+	 */
+	virtual int tell() const = 0;
+
+	/**
+	 * Returns total size of the stream in bytes.
+	 */
+	virtual int size() const = 0;
+
+	/**
+	 * Returns pointer to the whole stream contents, if they are in memory, otherwise 0.
+	 * Lets parsers use the bytes without copying them.
+	 */
+	virtual const uint8_t* data() const { return 0; }
+
 protected:
 	Stream() {};
 
@@ -0,0 +1,103 @@
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Copyright (c) 2013 Mikko Romppainen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in the
+// Software without restriction, including without limitation the rights to use, copy,
+// modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+#ifndef _ASSET_RELOADER_H_
+#define _ASSET_RELOADER_H_
+#include <core/Object.h>
+#include <core/Ref.h>
+#include <core/FileWatcher.h>
+#include <graphics/Shader.h>
+#include <graphics/Texture.h>
+#include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <atomic>
+
+namespace graphics
+{
+	//
+	// Reloads shaders and textures, when their source files change on disk.
+	// Background thread watches the files and reads changed shader sources. Programs are
+	// compiled and textures uploaded on the render thread in update, so GL state is only
+	// touched from the thread owning the context. If new shader sources do not compile,
+	// the old program stays in use and compile log is printed.
+	//
+	// Usage:
+	//    m_reloader = new graphics::AssetReloader();
+	//    m_reloader->addShader(shader);
+	//    m_reloader->addTexture(tex, "assets/TreeBark.tga");
+	//    ...
+	//    m_reloader->update(); // Once per frame on render thread
+	// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+	class AssetReloader : public core::Object
+	{
+	public:
+		AssetReloader();
+		virtual ~AssetReloader();
+
+		// Starts watching source files of given shader. Shader must be compiled from files.
+		// Assets must be added from the render thread.
+		void addShader(Shader* shader);
+
+		// Starts watching given TGA file and reloads it to the texture, when file changes.
+		void addTexture(Texture2D* texture, const char* const fileName,
+			Texture::FilteringMode filtering = Texture::TRILINEAR_FILTERING,
+			Texture::WrappingMode wrapping = Texture::REPEAT);
+
+		// Applies reloaded assets. Must be called from render thread.
+		void update();
+
+	private:
+		struct WatchedTexture
+		{
+			core::Ref<Texture2D>	texture;
+			std::string				fileName;
+			Texture::FilteringMode	filtering;
+			Texture::WrappingMode	wrapping;
+		};
+
+		// Shaders are kept alive by m_shaders, so raw pointer is enough here and
+		// background thread never touches reference counts.
+		struct PendingShader
+		{
+			Shader*				shader;
+			std::string			vertexSource;
+			std::string			fragmentSource;
+		};
+
+		void run();
+
+		core::Ref<core::FileWatcher>		m_watcher;
+		std::mutex							m_mutex;
+		std::vector< core::Ref<Shader> >	m_shaders;
+		std::vector<WatchedTexture>			m_textures;
+		std::vector<PendingShader>			m_pendingShaders;
+		std::vector<std::string>			m_pendingTextures;
+		std::atomic<bool>					m_quit;
+		std::thread							m_thread;
+
+		AssetReloader(const AssetReloader&);
+		AssetReloader& operator=(const AssetReloader&);
+	};
+}
+
+#endif
@@ -0,0 +1,289 @@
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Copyright (c) 2013 Mikko Romppainen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in the
+// Software without restriction, including without limitation the rights to use, copy,
+// modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+#ifndef _COMMAND_BUFFER_H_
+#define _COMMAND_BUFFER_H_
+#include <core/Object.h>
+#include <core/Ref.h>
+#include <core/JobSystem.h>
+#include <graphics/Shader.h>
+#include <graphics/Mesh.h>
+#include <slmath/mat4.h>
+#include <stdint.h>
+#include <vector>
+#include <map>
+
+namespace graphics
+{
+	// Called on the GL thread, when a callback command is replayed.
+	typedef void (*CommandCallback)(void* data);
+
+	//
+	// Compact list of render commands, which is recorded without OpenGL and replayed later on the
+	// GL thread (see RenderQueue). Commands are grouped to draw packets. Each packet starts with
+	// beginDraw and has a sort key, which orders packets at replay.
+	//
+	// Recorded objects are stored as raw pointers and uniform names as pointers to the name, so
+	// objects must stay alive and names must be string literals until the buffer has been executed.
+	// Uniforms set with setUniform should be set by every packet using them, because redundant
+	// material binds between packets are skipped at replay.
+	//
+	// One buffer must be recorded by one thread at a time.
+	// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+	class CommandBuffer : public core::Object
+	{
+	public:
+		CommandBuffer(int initialBytes = 16*1024);
+		virtual ~CommandBuffer();
+
+		// Starts new draw packet. Packets with smaller keys are replayed first.
+		void beginDraw(uint64_t sortKey);
+
+		void bindShader(Shader* shader);
+
+		// Binds material (ShaderUniforms::bind). Binds also the shader of the material.
+		void bindMaterial(ShaderUniforms* material);
+
+		void bindTexture(int unit, GLenum target, GLuint texture);
+
+		// Sets uniform of the bound shader. Supported types are GL_FLOAT, GL_FLOAT_VEC2..4,
+		// GL_INT, GL_FLOAT_MAT3 and GL_FLOAT_MAT4. Data is copied to the buffer.
+		void setUniform(const char* const name, GLenum type, const void* data, int count = 1);
+		void setUniform(const char* const name, float value);
+		void setUniform(const char* const name, int value);
+		void setUniform(const char* const name, const slmath::vec3& value);
+		void setUniform(const char* const name, const slmath::vec4& value);
+		void setUniform(const char* const name, const slmath::mat4& value);
+
+		void drawMesh(Mesh* mesh);
+
+		// Calls function on the GL thread, for state, which has no command of its own.
+		void callback(CommandCallback function, void* data);
+
+		// Removes all commands. Keeps the memory.
+		void reset();
+
+		int getNumPackets() const;
+
+		// Bytes used by the recorded commands.
+		int getSize() const;
+
+		// Builds sort key from render layer (0..255), state id (e.g. shader and material index)
+		// and view depth in range [0, 1]. Draws are grouped by layer, then by state and sorted
+		// front to back inside a state group.
+		static uint64_t makeSortKey(int layer, uint32_t stateId, float depth);
+
+	private:
+		friend class RenderQueue;
+
+		enum CommandType
+		{
+			CMD_BIND_SHADER,
+			CMD_BIND_MATERIAL,
+			CMD_BIND_TEXTURE,
+			CMD_SET_UNIFORM,
+			CMD_DRAW_MESH,
+			CMD_CALLBACK
+		};
+
+		// Header and command data are 8 byte aligned, so commands can hold pointers.
+		// size includes the header.
+		struct CommandHeader
+		{
+			uint32_t	type;
+			uint32_t	size;
+		};
+
+		struct Packet
+		{
+			uint64_t	key;
+			uint32_t	begin;
+			uint32_t	end;
+		};
+
+		void* addCommand(CommandType type, int size);
+
+		std::vector<uint64_t>	m_data;		// uint64_t keeps commands with pointers aligned
+		int						m_size;
+		std::vector<Packet>		m_packets;
+
+		CommandBuffer(const CommandBuffer&);
+		CommandBuffer& operator=(const CommandBuffer&);
+	};
+
+
+	//
+	// Set of command buffers, which are recorded in parallel and replayed on the GL thread.
+	//
+	// record splits a range of items (e.g. visible objects) to batches, which are recorded by job
+	// system jobs, each to its own buffer. execute sorts draw packets of all buffers by their keys
+	// (ties keep the recording order), replays them and skips redundant shader, material, texture
+	// and mesh binds. Consecutive draws of the same mesh bind its buffers only once.
+	//
+	// Typical usage:
+	//    m_queue->reset();
+	//    m_queue->record(0, numObjects, 64, [&](graphics::CommandBuffer* cb, int first, int last)
+	//    {
+	//        for (int i = first; i < last; ++i)
+	//        {
+	//            cb->beginDraw(graphics::CommandBuffer::makeSortKey(0, objects[i].materialId, depth[i]));
+	//            cb->bindMaterial(objects[i].material);
+	//            cb->setUniform("g_matModelViewProj", mvp[i]);
+	//            cb->drawMesh(objects[i].mesh);
+	//        }
+	//    });
+	//    m_queue->execute();
+	// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+	class RenderQueue : public core::Object
+	{
+	public:
+		// @param numBuffers Maximum number of batches per record. 0 = job system workers + 1.
+		RenderQueue(int numBuffers = 0);
+		virtual ~RenderQueue();
+
+		// Calls func(buffer, first, last) for batches of [begin, end) in parallel and waits for
+		// them. Batches have at least minBatchSize items and each batch has its own buffer.
+		// Can be called several times between reset and execute.
+		template<class Func>
+		void record(int begin, int end, int minBatchSize, const Func& func);
+
+		// Returns buffer for recording on the calling thread outside of record.
+		CommandBuffer* getBuffer(int index);
+		int getNumBuffers() const;
+
+		// Sorts and replays all recorded packets. Call from the GL thread.
+		void execute();
+
+		// Resets all buffers. Call after execute, before recording the next frame.
+		void reset();
+
+		// Statistics of the last execute.
+		int getNumDrawCalls() const;
+		int getNumSkippedBinds() const;
+
+	private:
+		struct SortEntry
+		{
+			uint64_t	key;
+			uint32_t	buffer;
+			uint32_t	packet;
+
+			bool operator<(const SortEntry& o) const
+			{
+				if (key != o.key) return key < o.key;
+				if (buffer != o.buffer) return buffer < o.buffer;
+				return packet < o.packet;
+			}
+		};
+
+		struct UniformKey
+		{
+			const Shader*	shader;
+			const char*		name;
+
+			bool operator<(const UniformKey& o) const
+			{
+				return shader != o.shader ? shader < o.shader : name < o.name;
+			}
+		};
+
+		// Location is queried again when the shader has been reloaded since.
+		struct UniformLocation
+		{
+			int		revision;
+			GLint	location;
+		};
+
+		template<class Func>
+		struct RecordBatch
+		{
+			const Func*		func;
+			RenderQueue*	queue;
+			int				begin;
+			int				count;
+			int				numBatches;
+			int				firstBuffer;
+
+			void operator()(int first, int last) const
+			{
+				for (int i = first; i < last; ++i)
+				{
+					int b0 = begin + (int)((long long)count * i / numBatches);
+					int b1 = begin + (int)((long long)count * (i + 1) / numBatches);
+					(*func)(queue->m_buffers[firstBuffer + i].ptr(), b0, b1);
+				}
+			}
+		};
+
+		void replay(const CommandBuffer::Packet& packet, const CommandBuffer& buffer);
+		GLint getUniformLocation(const char* name);
+		CommandBuffer* addBuffers(int count);
+
+		std::vector< core::Ref<CommandBuffer> >	m_buffers;
+		int										m_numUsed;		// Buffers used since reset
+		int										m_maxBatches;
+		std::vector<SortEntry>					m_sorted;
+		std::map<UniformKey, UniformLocation>	m_uniformLocations;
+
+		// Replay state
+		Shader*									m_shader;
+		GLuint									m_program;
+		ShaderUniforms*							m_material;
+		Mesh*									m_mesh;
+		GLenum									m_textureTargets[8];
+		GLuint									m_textures[8];
+		int										m_numDrawCalls;
+		int										m_numSkippedBinds;
+
+		RenderQueue(const RenderQueue&);
+		RenderQueue& operator=(const RenderQueue&);
+	};
+
+	template<class Func>
+	void RenderQueue::record(int begin, int end, int minBatchSize, const Func& func)
+	{
+		const int count = end - begin;
+		if (count <= 0)
+		{
+			return;
+		}
+
+		int numBatches = m_maxBatches;
+		if (minBatchSize > 0 && numBatches > count / minBatchSize)
+		{
+			numBatches = count / minBatchSize;
+		}
+		numBatches = numBatches > 1 ? numBatches : 1;
+
+		// Buffers are taken in order, so the replay order of equal keys does not depend on timing.
+		RecordBatch<Func> batch;
+		batch.func = &func;
+		batch.queue = this;
+		batch.begin = begin;
+		batch.count = count;
+		batch.numBatches = numBatches;
+		batch.firstBuffer = m_numUsed;
+		addBuffers(numBatches);
+		core::getJobSystem()->parallelFor(0, numBatches, 1, batch, numBatches);
+	}
+}
+
+#endif
@@ -0,0 +1,56 @@
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Copyright (c) 2013 Mikko Romppainen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in the
+// Software without restriction, including without limitation the rights to use, copy,
+// modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+#ifndef _ETC1_H_
+#define _ETC1_H_
+#include <stdint.h>
+
+namespace graphics
+{
+	//
+	// ETC1 texture compression (GL_ETC1_RGB8_OES). Every 4x4 RGB block is stored in 8 bytes.
+	// ETC1 data is also valid ETC2 RGB8 data, so it can be uploaded as GL_COMPRESSED_RGB8_ETC2
+	// on OpenGL ES 3.0.
+	// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+	enum { ETC1_BLOCK_SIZE = 8 };
+
+	// Size in bytes of ETC1 data of width x height image.
+	int etc1GetEncodedSize(int width, int height);
+
+	// Encodes one block.
+	// @param rgb 4x4 pixels, 3 bytes per pixel, rows one after another.
+	// @param block [out] 8 bytes.
+	void etc1EncodeBlock(const uint8_t* rgb, uint8_t* block);
+
+	// Decodes one block to 4x4 pixels, 3 bytes per pixel, rows one after another.
+	void etc1DecodeBlock(const uint8_t* block, uint8_t* rgb);
+
+	// Encodes image with 3 or 4 bytes per pixel (alpha is dropped). Partial blocks at the right
+	// and top edges are padded by repeating edge pixels. Rows of blocks are encoded in parallel.
+	// @param dst [out] etc1GetEncodedSize(width, height) bytes.
+	// @param numThreads Maximum number of job system batches. 0 = default, 1 = calling thread only.
+	void etc1EncodeImage(const uint8_t* pixels, int width, int height, int bytesPerPixel, uint8_t* dst, int numThreads = 0);
+
+	// Decodes ETC1 data to RGB image with 3 bytes per pixel.
+	void etc1DecodeImage(const uint8_t* src, int width, int height, uint8_t* rgb);
+}
+
+#endif
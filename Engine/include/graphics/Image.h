@@ -25,13 +25,19 @@
 #include <vector>
 #include <core/FileStream.h>
 #include <core/Ref.h>
+#include <core/PoolAllocator.h>
 #include <stdint.h>
 namespace graphics
 {
 
+	//
+	// Image in system memory. Rows are stored bottom-to-top, as OpenGL expects.
+	// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 	class Image : public core::Object
 	{
 	public:
+		ENGINE_POOLED_MEMORY_CATEGORY(core::MEMORY_TEXTURE)
+
 		Image(int width, int height, int bytesPerPixel);
 
 		uint8_t* getData();
@@ -46,6 +52,13 @@ namespace graphics
 
 		static Image* loadFromTGA(const std::string& strFileName);
 		static Image* loadFromTGA(const char* strFileName);
+
+		// Loads TGA image from stream. Supports uncompressed and RLE color mapped, true color
+		// and grayscale images with any origin. Returns 0, if the image is not supported.
+		static Image* loadFromTGA(core::Stream* stream);
+
+		// Loads TGA image from TGA file contents in memory.
+		static Image* loadFromTGA(const void* data, int size);
 	private:
 		int m_width;
 		int m_height;
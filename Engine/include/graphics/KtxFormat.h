@@ -0,0 +1,82 @@
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Copyright (c) 2013 Mikko Romppainen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in the
+// Software without restriction, including without limitation the rights to use, copy,
+// modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+#ifndef _KTX_FORMAT_H_
+#define _KTX_FORMAT_H_
+#include <core/Ref.h>
+#include <core/Stream.h>
+#include <graphics/Image.h>
+#include <stdint.h>
+#include <vector>
+
+namespace graphics
+{
+	//
+	// KTX 1.1 texture container header (after the 12 byte file identifier).
+	// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+	struct KtxHeader
+	{
+		// Size of the file header, including the identifier and endianness fields.
+		enum { SIZE = 64 };
+
+		uint32_t	glType;					// 0 for compressed textures
+		uint32_t	glTypeSize;
+		uint32_t	glFormat;				// 0 for compressed textures
+		uint32_t	glInternalFormat;
+		uint32_t	glBaseInternalFormat;
+		uint32_t	pixelWidth;
+		uint32_t	pixelHeight;
+		uint32_t	pixelDepth;
+		uint32_t	numberOfArrayElements;
+		uint32_t	numberOfFaces;
+		uint32_t	numberOfMipmapLevels;
+		uint32_t	bytesOfKeyValueData;
+
+		bool isCompressed() const { return glType == 0; }
+	};
+
+	// One mip level of a 2D texture. Data points to the parsed or written file contents.
+	struct KtxLevel
+	{
+		const uint8_t*	data;
+		int				size;
+		int				width;
+		int				height;
+	};
+
+	//
+	// Parses KTX file in memory. Only 2D textures are supported (no arrays, cube maps or
+	// 3D textures). Levels point into data, nothing is copied.
+	// @return false, if the data is not a supported KTX file or a level is smaller than its size needs.
+	bool parseKtx(const void* data, int size, KtxHeader& header, std::vector<KtxLevel>& levels);
+
+	//
+	// Writes KTX file. numberOfMipmapLevels, pixelWidth and pixelHeight of the header
+	// are taken from levels.
+	void writeKtx(core::Stream* stream, const KtxHeader& header, const std::vector<KtxLevel>& levels);
+
+	//
+	// Encodes all levels (for example from generateMipmaps) to ETC1 and writes them to KTX file.
+	// @param numThreads Maximum number of encoder batches. 0 = default, 1 = calling thread only.
+	void writeEtc1Ktx(core::Stream* stream, const std::vector< core::Ref<Image> >& levels, int numThreads = 0);
+}
+
+#endif
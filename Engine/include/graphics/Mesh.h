@@ -22,6 +22,7 @@
 #ifndef _ENGINE_MESH_H_
 #define _ENGINE_MESH_H_
 #include <core/Ref.h>
+#include <core/PoolAllocator.h>
 #include <slmath/mat4.h>
 #include <graphics/OpenGLES/es_util.h>
 #include <core/FileStream.h>
@@ -41,6 +42,8 @@ namespace graphics
 	class IndexBuffer : public core::Object
 	{
 	public:
+		ENGINE_POOLED_MEMORY_CATEGORY(core::MEMORY_MESH)
+
 		IndexBuffer(const std::vector<uint16_t>& data);
 		IndexBuffer(uint16_t* data, int dataLen);
 		virtual ~IndexBuffer();
@@ -56,6 +59,8 @@ namespace graphics
 	class VertexArray : public core::Object
 	{
 	public:
+		ENGINE_POOLED_MEMORY_CATEGORY(core::MEMORY_MESH)
+
 		VertexArray();
 		virtual ~VertexArray();
 		virtual SHADER_ATTRIBUTES getSemantic() const = 0;
@@ -152,6 +157,8 @@ namespace graphics
 	class VertexBuffer : public core::Object
 	{
 	public:
+		ENGINE_POOLED_MEMORY_CATEGORY(core::MEMORY_MESH)
+
 		VertexBuffer(VertexArray** vertexArrays, int count);
 		virtual ~VertexBuffer();
 		void bind();
@@ -194,9 +201,16 @@ namespace graphics
 	class Mesh : public core::Object
 	{
 	public:
+		ENGINE_POOLED_MEMORY_CATEGORY(core::MEMORY_MESH)
+
 		Mesh(IndexBuffer* ib, VertexBuffer* vb);
 		virtual ~Mesh();
 		void render();
+
+		// Split render for drawing the same mesh several times with one bind.
+		void bind();
+		void draw();
+		void unbind();
 	private:
 		core::Ref<IndexBuffer> m_ib;
 		core::Ref<VertexBuffer> m_vb;
@@ -0,0 +1,66 @@
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Copyright (c) 2013 Mikko Romppainen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in the
+// Software without restriction, including without limitation the rights to use, copy,
+// modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+#ifndef _MIPMAP_GENERATOR_H_
+#define _MIPMAP_GENERATOR_H_
+#include <core/Ref.h>
+#include <graphics/Image.h>
+#include <vector>
+
+namespace graphics
+{
+	enum MipmapFilter
+	{
+		// Area average. Handles odd sizes with 3-tap polyphase weights.
+		MIPMAP_BOX_FILTER,
+		// Kaiser windowed sinc. Sharper than box, with little ringing.
+		MIPMAP_KAISER_FILTER
+	};
+
+	struct MipmapSettings
+	{
+		MipmapSettings()
+			: filter(MIPMAP_BOX_FILTER)
+			, srgb(true)
+			, numThreads(0)
+		{
+		}
+
+		MipmapFilter	filter;
+		// If true, color channels are converted from sRGB to linear before filtering and back
+		// after it. Alpha is always filtered as linear.
+		bool			srgb;
+		// Maximum number of job system batches per level. 0 = default, 1 = calling thread only.
+		int				numThreads;
+	};
+
+	//
+	// Generates full mip chain (down to 1x1) for the image on the CPU.
+	//
+	// Each level is filtered from a linear float copy of the previous level, so rounding errors
+	// do not accumulate. Rows of each level are split to batches, which are filtered by the job system.
+	// Does not use OpenGL, so it can be called from a loader thread. Works with NPOT images.
+	// @param levels [out] Receives the levels. levels[0] is the image itself.
+	void generateMipmaps(Image* image, std::vector< core::Ref<Image> >& levels,
+		const MipmapSettings& settings = MipmapSettings());
+}
+
+#endif
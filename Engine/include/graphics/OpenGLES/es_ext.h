@@ -0,0 +1,174 @@
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Copyright (c) 2013 Mikko Romppainen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in the
+// Software without restriction, including without limitation the rights to use, copy,
+// modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+#ifndef ESEXT_H_
+#define ESEXT_H_
+
+#include <graphics/OpenGLES/es_util.h>
+
+#if defined(_WIN32)
+#include <graphics/Win32/GLES2/gl2ext.h>
+#else
+#include <GLES2/gl2ext.h>
+#endif
+
+//
+// OpenGL ES 3.0 tokens and entry points, which are not declared by GLES2 headers.
+// Entry points are loaded at run time with eglGetProcAddress, so the engine still
+// links and runs against OpenGL ES 2.0 drivers. Check esIsVersion3() before use.
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+#ifndef GL_ES_VERSION_3_0
+typedef khronos_uint64_t GLuint64;
+typedef struct __GLsync* GLsync;
+
+#define GL_UNIFORM_BUFFER                        0x8A11
+#define GL_UNIFORM_BUFFER_BINDING                0x8A28
+#define GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT       0x8A34
+#define GL_MAX_UNIFORM_BLOCK_SIZE                0x8A30
+#define GL_MAX_UNIFORM_BUFFER_BINDINGS           0x8A2F
+#define GL_INVALID_INDEX                         0xFFFFFFFFu
+
+#define GL_MAP_READ_BIT                          0x0001
+#define GL_MAP_WRITE_BIT                         0x0002
+#define GL_MAP_INVALIDATE_RANGE_BIT              0x0004
+#define GL_MAP_INVALIDATE_BUFFER_BIT             0x0008
+#define GL_MAP_FLUSH_EXPLICIT_BIT                0x0010
+#define GL_MAP_UNSYNCHRONIZED_BIT                0x0020
+
+#define GL_SYNC_GPU_COMMANDS_COMPLETE             0x9117
+#define GL_SYNC_FLUSH_COMMANDS_BIT               0x00000001
+#define GL_ALREADY_SIGNALED                      0x911A
+#define GL_TIMEOUT_EXPIRED                       0x911B
+#define GL_CONDITION_SATISFIED                   0x911C
+#define GL_WAIT_FAILED                           0x911D
+#define GL_TIMEOUT_IGNORED                       0xFFFFFFFFFFFFFFFFull
+
+#define GL_PIXEL_PACK_BUFFER                     0x88EB
+#define GL_PIXEL_UNPACK_BUFFER                   0x88EC
+#define GL_STREAM_READ                           0x88E1
+
+#define GL_READ_FRAMEBUFFER                      0x8CA8
+#define GL_DRAW_FRAMEBUFFER                      0x8CA9
+#define GL_MAX_SAMPLES                           0x8D57
+#define GL_RGB8                                  0x8051
+#define GL_RGBA8                                 0x8058
+#define GL_RGBA16F                               0x881A
+#define GL_RGB16F                                0x881B
+
+#define GL_COMPRESSED_RGB8_ETC2                  0x9274
+#define GL_COMPRESSED_SRGB8_ETC2                 0x9275
+#define GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2 0x9276
+#define GL_COMPRESSED_RGBA8_ETC2_EAC             0x9278
+#define GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC      0x9279
+#define GL_COMPRESSED_SRGB8_PUNCHTHROUGH_ALPHA1_ETC2 0x9277
+#define GL_COMPRESSED_R11_EAC                    0x9270
+#define GL_COMPRESSED_SIGNED_R11_EAC             0x9271
+#define GL_COMPRESSED_RG11_EAC                   0x9272
+#define GL_COMPRESSED_SIGNED_RG11_EAC            0x9273
+
+#define GL_RED                                   0x1903
+#define GL_RG                                    0x8227
+#define GL_RED_INTEGER                           0x8D94
+#define GL_RG_INTEGER                            0x8228
+#define GL_RGB_INTEGER                           0x8D98
+#define GL_RGBA_INTEGER                          0x8D99
+#define GL_HALF_FLOAT                            0x140B
+#define GL_UNSIGNED_INT_2_10_10_10_REV           0x8368
+#define GL_UNSIGNED_INT_10F_11F_11F_REV          0x8C3B
+#define GL_UNSIGNED_INT_5_9_9_9_REV              0x8C3E
+#endif
+
+// S3TC tokens are declared by different extensions, depending on the GLES2 headers.
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT          0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT1_EXT         0x83F1
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT3_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT3_EXT         0x83F2
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT         0x83F3
+#endif
+
+namespace graphics
+{
+	typedef void		(GL_APIENTRYP PFNESBINDBUFFERRANGEPROC) (GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+	typedef void		(GL_APIENTRYP PFNESBINDBUFFERBASEPROC) (GLenum target, GLuint index, GLuint buffer);
+	typedef GLuint		(GL_APIENTRYP PFNESGETUNIFORMBLOCKINDEXPROC) (GLuint program, const GLchar* uniformBlockName);
+	typedef void		(GL_APIENTRYP PFNESUNIFORMBLOCKBINDINGPROC) (GLuint program, GLuint uniformBlockIndex, GLuint uniformBlockBinding);
+	typedef GLvoid*		(GL_APIENTRYP PFNESMAPBUFFERRANGEPROC) (GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access);
+	typedef GLboolean	(GL_APIENTRYP PFNESUNMAPBUFFERPROC) (GLenum target);
+	typedef GLsync		(GL_APIENTRYP PFNESFENCESYNCPROC) (GLenum condition, GLbitfield flags);
+	typedef GLenum		(GL_APIENTRYP PFNESCLIENTWAITSYNCPROC) (GLsync sync, GLbitfield flags, GLuint64 timeout);
+	typedef void		(GL_APIENTRYP PFNESDELETESYNCPROC) (GLsync sync);
+	typedef void		(GL_APIENTRYP PFNESINVALIDATEFRAMEBUFFERPROC) (GLenum target, GLsizei numAttachments, const GLenum* attachments);
+	typedef void		(GL_APIENTRYP PFNESBLITFRAMEBUFFERPROC) (GLint srcX0, GLint srcY0, GLint srcX1, GLint srcY1, GLint dstX0, GLint dstY0, GLint dstX1, GLint dstY1, GLbitfield mask, GLenum filter);
+	typedef void		(GL_APIENTRYP PFNESRENDERBUFFERSTORAGEMULTISAMPLEPROC) (GLenum target, GLsizei samples, GLenum internalformat, GLsizei width, GLsizei height);
+	typedef void		(GL_APIENTRYP PFNESFRAMEBUFFERTEXTURE2DMULTISAMPLEPROC) (GLenum target, GLenum attachment, GLenum textarget, GLuint texture, GLint level, GLsizei samples);
+
+	//
+	// OpenGL ES 3.0 entry points. Zero, if context is not ES 3.0 (see esIsVersion3).
+	extern PFNESBINDBUFFERRANGEPROC			esBindBufferRange;
+	extern PFNESBINDBUFFERBASEPROC			esBindBufferBase;
+	extern PFNESGETUNIFORMBLOCKINDEXPROC	esGetUniformBlockIndex;
+	extern PFNESUNIFORMBLOCKBINDINGPROC		esUniformBlockBinding;
+	extern PFNESMAPBUFFERRANGEPROC			esMapBufferRange;
+	extern PFNESUNMAPBUFFERPROC				esUnmapBuffer;
+	extern PFNESFENCESYNCPROC				esFenceSync;
+	extern PFNESCLIENTWAITSYNCPROC			esClientWaitSync;
+	extern PFNESDELETESYNCPROC				esDeleteSync;
+	extern PFNESINVALIDATEFRAMEBUFFERPROC	esInvalidateFramebuffer;
+	extern PFNESBLITFRAMEBUFFERPROC			esBlitFramebuffer;
+	extern PFNESRENDERBUFFERSTORAGEMULTISAMPLEPROC	esRenderbufferStorageMultisample;
+
+	//
+	// Extension entry points. Zero, if the extension is not supported.
+	extern PFNESINVALIDATEFRAMEBUFFERPROC	esDiscardFramebufferEXT;	// GL_EXT_discard_framebuffer
+	extern PFNESRENDERBUFFERSTORAGEMULTISAMPLEPROC	esRenderbufferStorageMultisampleEXT;	// GL_EXT_multisampled_render_to_texture
+	extern PFNESFRAMEBUFFERTEXTURE2DMULTISAMPLEPROC	esFramebufferTexture2DMultisampleEXT;	// GL_EXT_multisampled_render_to_texture
+
+	/**
+	 * Queries context version and extension string of the current context and loads
+	 * OpenGL ES 3.0 entry points. Called lazily by esIsVersion3 and esHasExtension,
+	 * but can be called explicitly right after the context has been made current.
+	 */
+	void esLoadExtensions();
+
+	/**
+	 * Returns true, if current context is OpenGL ES 3.0 or newer and all ES 3.0
+	 * entry points used by the engine were found.
+	 */
+	bool esIsVersion3();
+
+	/**
+	 * Returns true, if given extension (for example "GL_EXT_texture_format_BGRA8888")
+	 * is supported by the current context.
+	 */
+	bool esHasExtension(const char* const name);
+
+	/**
+	 * Tells the driver, that contents of given attachments of the bound framebuffer are
+	 * not needed anymore, so tiled GPUs can skip writing them to memory. Uses
+	 * glInvalidateFramebuffer (ES 3.0) or glDiscardFramebufferEXT. Does nothing, if
+	 * neither is supported.
+	 */
+	void esDiscardFramebuffer(GLsizei numAttachments, const GLenum* attachments);
+}
+
+#endif // ESEXT_H_
@@ -66,7 +66,9 @@ namespace graphics
 enum Version
 {
 	ES_VERSION_1 = 0,
-	ES_VERSION_2 = 1
+	ES_VERSION_2 = 1,
+	/// OpenGL ES 3.0. Falls back to ES_VERSION_2, if the driver can not create 3.0 context.
+	ES_VERSION_3 = 2
 };
 
 /**
@@ -0,0 +1,112 @@
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Copyright (c) 2013 Mikko Romppainen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in the
+// Software without restriction, including without limitation the rights to use, copy,
+// modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+#ifndef _PIXEL_BUFFER_H_
+#define _PIXEL_BUFFER_H_
+#include <core/Object.h>
+#include <core/Ref.h>
+#include <graphics/Image.h>
+#include <graphics/Texture.h>
+#include <graphics/OpenGLES/es_ext.h>
+#include <stdint.h>
+#include <vector>
+
+namespace graphics
+{
+	//
+	// Streams texture updates (for example video frames) through a ring of pixel unpack
+	// buffers (OpenGL ES 3.0). Pixels are written to a mapped buffer and glTexSubImage2D
+	// copies them from the buffer, so the call returns without waiting for the copy.
+	// A buffer is reused only after its fence has signaled. If all buffers are still in use,
+	// the update is skipped instead of stalling, which is what a video texture wants.
+	//
+	// On OpenGL ES 2.0 updates are uploaded directly with glTexSubImage2D.
+	// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+	class PixelUnpackRing : public core::Object
+	{
+	public:
+		// @param bytesPerBuffer Size of the largest update.
+		PixelUnpackRing(int bytesPerBuffer, int numBuffers = 3);
+		virtual ~PixelUnpackRing();
+
+		// Uploads image to texture at (x, y). Returns false, if all buffers were busy and
+		// the update was skipped.
+		bool update(Texture2D* texture, Image* image, int x = 0, int y = 0);
+		bool update(Texture2D* texture, const uint8_t* pixels, int x, int y, int width, int height, int bytesPerPixel);
+
+	private:
+		std::vector<GLuint>	m_buffers;
+		std::vector<GLsync>	m_fences;
+		int					m_bytesPerBuffer;
+		int					m_next;
+
+		PixelUnpackRing();
+		PixelUnpackRing(const PixelUnpackRing&);
+		PixelUnpackRing& operator=(const PixelUnpackRing&);
+	};
+
+	//
+	// Asynchronous readback of the bound framebuffer (OpenGL ES 3.0), for example for
+	// screenshots. request starts glReadPixels to a pixel pack buffer. poll returns the
+	// oldest finished read a few frames later, without stalling the pipeline.
+	//
+	// On OpenGL ES 2.0 request reads synchronously and poll returns the result immediately.
+	// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+	class PixelReadback : public core::Object
+	{
+	public:
+		// @param maxWidth, maxHeight Largest area, that can be read.
+		PixelReadback(int maxWidth, int maxHeight, int numBuffers = 3);
+		virtual ~PixelReadback();
+
+		// Starts reading RGBA pixels of the bound framebuffer. Returns false, if all
+		// buffers are waiting to be polled.
+		bool request(int x, int y, int width, int height);
+
+		// Returns image (4 bytes per pixel, rows bottom-to-top) of the oldest finished request,
+		// or 0 if it is not finished yet.
+		Image* poll();
+
+		// Number of requests waiting to be polled.
+		int getNumPending() const;
+
+	private:
+		struct Slot
+		{
+			GLuint					buffer;
+			GLsync					fence;
+			int						width;
+			int						height;
+			std::vector<uint8_t>	pixels;		// Result of synchronous ES 2.0 read
+		};
+
+		std::vector<Slot>	m_slots;
+		int					m_maxBytes;
+		int					m_first;		// Oldest pending request
+		int					m_numPending;
+
+		PixelReadback();
+		PixelReadback(const PixelReadback&);
+		PixelReadback& operator=(const PixelReadback&);
+	};
+}
+
+#endif
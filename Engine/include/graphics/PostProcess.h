@@ -0,0 +1,131 @@
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Copyright (c) 2013 Mikko Romppainen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in the
+// Software without restriction, including without limitation the rights to use, copy,
+// modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+#ifndef _POST_PROCESS_H_
+#define _POST_PROCESS_H_
+#include <core/Object.h>
+#include <core/Ref.h>
+#include <graphics/Texture.h>
+#include <graphics/Shader.h>
+#include <graphics/RenderTargetPool.h>
+#include <vector>
+#include <string>
+
+namespace graphics
+{
+	//
+	// Settings for PostProcessChain. Effects can be toggled between frames.
+	struct PostProcessSettings
+	{
+		PostProcessSettings();
+
+		bool	bloom;
+		float	bloomThreshold;		// Brightness, where bloom starts
+		float	bloomIntensity;
+		int		bloomDownsample;	// 2 (half resolution) or 4 (quarter resolution)
+		int		bloomKernelSize;	// Width of the Gaussian kernel in texels (odd, at most 25)
+		float	bloomSigma;			// 0 = default of slmath::getGaussianBlurKernel1D
+
+		bool	tonemap;
+		float	exposure;
+
+		bool	fxaa;
+	};
+
+	//
+	// Full-screen post-processing: bloom, tonemapping and FXAA.
+	//
+	// Intermediate targets are acquired from a RenderTargetPool and released as soon as
+	// the next pass has consumed them, so passes of the chain share memory.
+	//
+	// Bloom is extracted and downsampled with bilinear taps (one tap averages 2x2 texels)
+	// and blurred at reduced resolution with a separable Gaussian, which uses linear
+	// sampling: two neighbouring kernel weights are fetched with one bilinear tap, so a
+	// kernel of N texels takes about N/2 texture reads per direction. Bloom composite,
+	// tonemapping and the luma needed by FXAA are merged into one pass.
+	//
+	// Changes frame buffer binding, viewport and depth test, blending and culling state.
+	// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+	class PostProcessChain : public core::Object
+	{
+	public:
+		PostProcessChain(RenderTargetPool* pool, const PostProcessSettings& settings = PostProcessSettings());
+		virtual ~PostProcessChain();
+
+		// Applies enabled effects to scene (width x height) and writes the result to output,
+		// or to the frame buffer bound at the time of the call, if output is 0.
+		void render(Texture* scene, int width, int height, RenderTarget* output = 0);
+
+		// Separable Gaussian blur of src to dst. Both are dst sized.
+		void blur(Texture* src, RenderTarget* dst, int kernelSize, float sigma = 0.0f);
+
+		PostProcessSettings& getSettings();
+
+		// Number of full-screen passes drawn by the last render call.
+		int getNumPasses() const;
+
+		// Combines pairs of weights of 1D Gaussian kernel into bilinear taps. Tap 0 is the center,
+		// other taps are used at +offset and -offset texels. Returns number of taps.
+		static int computeLinearBlurTaps(int kernelSize, float sigma, std::vector<float>& offsets, std::vector<float>& weights);
+
+	private:
+		struct Program
+		{
+			core::Ref<Shader>	shader;
+			GLint				texture;
+			GLint				texture2;
+			GLint				texelSize;
+			GLint				param0;
+			GLint				param1;
+		};
+
+		struct BlurProgram
+		{
+			int			kernelSize;
+			float		sigma;
+			Program		program;
+		};
+
+		Program createProgram(const std::string& vertexShader, const std::string& fragmentShader);
+		Program& getBlurProgram(int kernelSize, float sigma);
+		void begin(RenderTarget* target);
+		void drawPass(Program& program, Texture* texture, float texelX, float texelY, Texture* texture2,
+			float param0, float param1, RenderTarget* target, int width, int height);
+		void blurPass(Texture* src, int width, int height, RenderTarget* dst, int kernelSize, float sigma, bool horizontal);
+
+		core::Ref<RenderTargetPool>	m_pool;
+		PostProcessSettings			m_settings;
+		GLuint						m_vbo;
+		GLint						m_outputFBO;
+		int							m_numPasses;
+
+		Program						m_brightPass;
+		Program						m_downsample;
+		Program						m_composite[4];		// [bloom + 2*tonemap]
+		Program						m_fxaa;
+		std::vector<BlurProgram>	m_blurPrograms;
+
+		PostProcessChain(const PostProcessChain&);
+		PostProcessChain& operator=(const PostProcessChain&);
+	};
+}
+
+#endif
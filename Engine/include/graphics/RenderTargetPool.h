@@ -0,0 +1,91 @@
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Copyright (c) 2013 Mikko Romppainen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in the
+// Software without restriction, including without limitation the rights to use, copy,
+// modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+#ifndef _RENDER_TARGET_POOL_H_
+#define _RENDER_TARGET_POOL_H_
+#include <core/Object.h>
+#include <core/Ref.h>
+#include <graphics/Texture.h>
+#include <vector>
+
+namespace graphics
+{
+	//
+	// Recycles render targets of transient passes (post-processing, blur, downsampling).
+	// Targets are matched by size, format, type, depth buffer and sample count.
+	//
+	// A target released during a frame can be acquired again by a later pass of the same
+	// frame, so passes whose targets do not overlap in time share the same memory.
+	// Targets not used for maxIdleFrames frames are deleted at nextFrame.
+	// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+	class RenderTargetPool : public core::Object
+	{
+	public:
+		RenderTargetPool(int maxIdleFrames = 3);
+		virtual ~RenderTargetPool();
+
+		// Returns free render target with given properties, or creates new one.
+		// The target stays reserved until released.
+		RenderTarget* acquire(int width, int height, bool depthBuffer, GLenum format = GL_RGBA, GLenum type = GL_UNSIGNED_BYTE, int samples = 0);
+
+		// Returns target to the pool. Contents are not preserved.
+		void release(RenderTarget* target);
+
+		// Call once per frame. Deletes targets, which have been idle too long.
+		void nextFrame();
+
+		// Deletes all targets, which are not currently acquired.
+		void clear();
+
+		// Number of targets owned by the pool and number of them currently acquired.
+		int getNumTargets() const;
+		int getNumAcquired() const;
+
+		// Bytes of texture memory used by all pooled targets (estimated).
+		int getMemoryUsage() const;
+
+		static int getBytesPerPixel(GLenum format, GLenum type);
+
+	private:
+		struct Entry
+		{
+			core::Ref<RenderTarget>	target;
+			int						width;
+			int						height;
+			bool					depthBuffer;
+			GLenum					format;
+			GLenum					type;
+			int						samples;
+			int						bytes;
+			bool					acquired;
+			int						lastUsedFrame;
+		};
+
+		std::vector<Entry>	m_entries;
+		int					m_maxIdleFrames;
+		int					m_frame;
+
+		RenderTargetPool(const RenderTargetPool&);
+		RenderTargetPool& operator=(const RenderTargetPool&);
+	};
+}
+
+#endif
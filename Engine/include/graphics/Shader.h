@@ -23,7 +23,10 @@
 #define _SHADER_H_
 #include <core/Object.h>
 #include <core/Ref.h>
+#include <core/PoolAllocator.h>
 #include <GLES2/gl2.h>
+#include <vector>
+#include <string>
 
 namespace graphics
 {
@@ -47,6 +50,8 @@ namespace graphics
 	class Shader : public core::Object
 	{
 	public:
+		ENGINE_MEMORY_CATEGORY(core::MEMORY_SHADER)
+
 		// Creates and compiles shader either from source strings or from file .vs and .fs files.
 		Shader(const char* const strVertexShaderFileName,
 			const char* const strFragmentShaderFileName,
@@ -60,14 +65,32 @@ namespace graphics
 		// Binds shader
 		void bind();
 
+		// Compiles new program from given sources. On success replaces current program and
+		// increments revision, on failure keeps the current program and returns false.
+		bool reload(const char* const strVertexShader, const char* const strFragmentShader);
+
+		// Incremented each time program is replaced by reload. Uniform locations queried
+		// from older revision are not valid anymore.
+		int getRevision() const;
+
+		// Source file names. Empty, if shader was compiled from strings.
+		const std::string& getVertexShaderFileName() const;
+		const std::string& getFragmentShaderFileName() const;
+
 		// Helper function for shader compiling from sources.
 		static bool compileShaderProgram(const char* strVertexShader,
 			const char* strFragmentShader,
 			GLuint* pShaderProgramHandle,
 			const SHADER_ATTRIBUTE* pAttributes = 0,
-			size_t nNumAttributes = 0);
+			size_t nNumAttributes = 0,
+			bool assertOnError = true);
 	private:
-		GLuint m_program;
+		GLuint						m_program;
+		int							m_revision;
+		std::string					m_vertexShaderFileName;
+		std::string					m_fragmentShaderFileName;
+		std::vector<std::string>	m_attributeNames;
+		std::vector<GLuint>			m_attributeLocations;
 	};
 
 
@@ -77,6 +100,8 @@ namespace graphics
 	class ShaderUniforms : public core::Object
 	{
 	public:
+		ENGINE_POOLED_MEMORY_CATEGORY(core::MEMORY_SHADER)
+
 		ShaderUniforms(Shader* shader);
 
 		virtual ~ShaderUniforms();
@@ -94,6 +119,7 @@ namespace graphics
 	private:
 		core::Ref<Shader>	m_shader;
 		bool				m_initDone;
+		int					m_shaderRevision;
 
 	};
 
@@ -0,0 +1,155 @@
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Copyright (c) 2013 Mikko Romppainen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in the
+// Software without restriction, including without limitation the rights to use, copy,
+// modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+#ifndef _SHADOW_MAP_H_
+#define _SHADOW_MAP_H_
+#include <core/Object.h>
+#include <core/Ref.h>
+#include <graphics/Texture.h>
+#include <graphics/Mesh.h>
+#include <graphics/Shader.h>
+#include <slmath/mat4.h>
+#include <core/FrameArena.h>
+#include <vector>
+
+namespace graphics
+{
+	//
+	// Mesh, which casts shadows. Bounds are the world space bounding box of the mesh
+	// and are used for culling casters per cascade.
+	struct ShadowCaster
+	{
+		Mesh*			mesh;
+		slmath::mat4	matWorld;
+		slmath::vec3	boundsMin;
+		slmath::vec3	boundsMax;
+	};
+
+	//
+	// Settings for CascadedShadowMap.
+	struct ShadowSettings
+	{
+		ShadowSettings();
+
+		int		resolution;				// Width and height of each cascade
+		int		numCascades;			// 1..MAX_CASCADES
+		float	shadowDistance;			// Shadows end at this view space distance
+		float	splitLambda;			// 0 = uniform splits, 1 = logarithmic splits
+		int		updateInterval[4];		// Cascade is rendered every Nth frame (1 = every frame)
+		float	depthBiasFactor;		// glPolygonOffset used, when rendering casters
+		float	depthBiasUnits;
+	};
+
+	//
+	// Shadow maps for one directional or spot light.
+	//
+	// Directional light uses cascaded shadow maps: the view frustum is split along the view
+	// direction and each split gets its own depth texture, fitted tightly around the split
+	// in light space. Casters outside the cascade, or behind everything it receives shadows on,
+	// are culled. Distant cascades can be rendered less often with updateInterval. The shadow
+	// matrix of a cascade is updated only when it is rendered, so skipped cascades stay consistent.
+	//
+	// Spot light uses one perspective shadow map (cascade 0).
+	//
+	// Shaders sample the maps with the helpers returned by getShaderFunctions.
+	// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+	class CascadedShadowMap : public core::Object
+	{
+	public:
+		enum
+		{
+			MAX_CASCADES = 4
+		};
+
+		CascadedShadowMap(const ShadowSettings& settings = ShadowSettings());
+		virtual ~CascadedShadowMap();
+
+		// Sets direction light travels to. Forces all cascades to be rendered next update.
+		void setDirectionalLight(const slmath::vec3& direction);
+
+		// Sets spot light with full cone angle fovy (radians) and range.
+		void setSpotLight(const slmath::vec3& position, const slmath::vec3& direction, float fovy, float range);
+
+		// Fits cascades to the camera and renders casters to the cascades, which are due this frame.
+		// View and projection are the camera matrices (projection from perspectiveFovRH).
+		// Changes frame buffer binding, viewport, color mask, culling and polygon offset state.
+		// Culling lists are allocated from arena, if given.
+		void update(const slmath::mat4& matView, const slmath::mat4& matProjection, float cameraNear, float cameraFar,
+			const std::vector<ShadowCaster>& casters, core::FrameArena* arena = 0);
+
+		// Number of cascades in use (1 for spot light).
+		int getNumCascades() const;
+
+		// Depth texture of cascade.
+		Texture* getShadowMap(int cascade) const;
+
+		// Transforms world space position to shadow map texture space (xy = uv, z = depth in 0..1).
+		const slmath::mat4& getShadowMatrix(int cascade) const;
+
+		// View space distance, where cascade ends. Unused cascades are set far away, so
+		// the vector can be given directly to g_shadowSplits.
+		slmath::vec4 getSplitDistances() const;
+
+		// Number of casters rendered to the cascade, when it was last updated.
+		int getNumCastersRendered(int cascade) const;
+
+		// Frame, when the cascade was last rendered (frames are counted by update).
+		int getLastUpdateFrame(int cascade) const;
+
+		// Resolution and numCascades can not be changed after construction.
+		ShadowSettings& getSettings();
+
+		// GLSL ES 1.00 helper functions for sampling the shadow maps (see source for usage).
+		static const char* getShaderFunctions();
+
+	private:
+		struct Cascade
+		{
+			core::Ref<RenderTarget>	target;
+			slmath::mat4			matViewProj;
+			slmath::mat4			matShadow;
+			float					splitFar;
+			int						lastUpdateFrame;
+			int						numCastersRendered;
+		};
+
+		void fitDirectional(int cascade, const slmath::mat4& matCameraToWorld, float tanX, float tanY,
+			float splitNear, float splitFar, const std::vector<ShadowCaster>& casters, core::FrameVector<int>& visible);
+		void fitSpot(const std::vector<ShadowCaster>& casters, core::FrameVector<int>& visible);
+		void render(int cascade, const std::vector<ShadowCaster>& casters, const core::FrameVector<int>& visible);
+
+		ShadowSettings			m_settings;
+		Cascade					m_cascades[MAX_CASCADES];
+		core::Ref<Shader>		m_shader;
+		GLint					m_mvpLoc;
+		bool					m_spot;
+		slmath::vec3			m_lightPosition;
+		slmath::vec3			m_lightDirection;
+		float					m_spotFovy;
+		float					m_spotRange;
+		int						m_frame;
+
+		CascadedShadowMap(const CascadedShadowMap&);
+		CascadedShadowMap& operator=(const CascadedShadowMap&);
+	};
+}
+
+#endif
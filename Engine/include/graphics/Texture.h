@@ -25,15 +25,21 @@
 #include <core/Object.h>
 #include <core/Ref.h>
 #include <string>
+#include <vector>
+#include <stdint.h>
 #include <graphics/OpenGLES/es_util.h>
 
 namespace graphics
 {
 	class Image;
+	struct KtxHeader;
+	struct KtxLevel;
 
 	class Texture : public core::Object
 	{
 	public:
+		ENGINE_MEMORY_CATEGORY(core::MEMORY_TEXTURE)
+
 		Texture();
 		Texture(GLuint id);
 
@@ -71,6 +77,43 @@ namespace graphics
 		Texture2D();
 		virtual ~Texture2D();
 		void setData(Image*, Texture::FilteringMode filtering = TRILINEAR_FILTERING, Texture::WrappingMode wrapping = REPEAT);
+
+		// Uploads pixels with 1 to 4 bytes per pixel, rows bottom-to-top. If pixels is 0, only
+		// allocates the texture. Fill it with setSubData and call setParameters when done.
+		void setData(const uint8_t* pixels, int width, int height, int bytesPerPixel, Texture::FilteringMode filtering = TRILINEAR_FILTERING, Texture::WrappingMode wrapping = REPEAT);
+
+		// Allocates numLevels mip levels without pixels. Fill them with setSubData and call
+		// setParameters when done.
+		void allocate(int width, int height, int bytesPerPixel, int numLevels);
+
+		// Uploads a rectangle of given mip level.
+		void setSubData(const uint8_t* pixels, int x, int y, int width, int height, int bytesPerPixel, int level = 0);
+
+		// Sets filtering and wrapping. If generateMipmaps is true, generates mipmaps, if
+		// filtering needs them.
+		void setParameters(Texture::FilteringMode filtering = TRILINEAR_FILTERING, Texture::WrappingMode wrapping = REPEAT, bool generateMipmaps = true);
+
+		// Uploads all mip levels (for example from generateMipmaps). glGenerateMipmap is not
+		// called, if the chain goes down to 1x1.
+		void setData(const std::vector< core::Ref<Image> >& levels, Texture::FilteringMode filtering = TRILINEAR_FILTERING, Texture::WrappingMode wrapping = REPEAT);
+
+		// Loads TGA file through a memory mapped file. Uncompressed true color and grayscale
+		// images are uploaded straight from the mapping (or via a small staging buffer, if
+		// channels must be swizzled or rows flipped), without copying the whole image to heap.
+		// Other TGA images fall back to Image::loadFromTGA. Returns false, if the file can not be loaded.
+		bool setDataFromTGA(const char* const fileName, Texture::FilteringMode filtering = TRILINEAR_FILTERING, Texture::WrappingMode wrapping = REPEAT);
+		bool setDataFromTGA(const void* tgaData, int size, Texture::FilteringMode filtering = TRILINEAR_FILTERING, Texture::WrappingMode wrapping = REPEAT);
+
+		// Loads KTX file through a memory mapped file and uploads all its levels. Compressed
+		// formats are uploaded with glCompressedTexImage2D. ETC1 is uploaded as ETC2 on OpenGL ES 3.0
+		// drivers without the ETC1 extension, and decoded to RGB on the CPU, if neither is supported.
+		// Returns false, if the file can not be loaded or its format is not supported.
+		bool setDataFromKTX(const char* const fileName, Texture::FilteringMode filtering = TRILINEAR_FILTERING, Texture::WrappingMode wrapping = REPEAT);
+		bool setDataFromKTX(const void* ktxData, int size, Texture::FilteringMode filtering = TRILINEAR_FILTERING, Texture::WrappingMode wrapping = REPEAT);
+
+		// Uploads parsed KTX levels. levels[0] becomes level 0 of the texture, so a tail of the
+		// mip chain can be uploaded as a smaller texture (see TextureStreamer).
+		bool setData(const KtxHeader& header, const std::vector<KtxLevel>& levels, Texture::FilteringMode filtering = TRILINEAR_FILTERING, Texture::WrappingMode wrapping = REPEAT);
 		//void setData(Image*, Texture::FilteringMode filtering = TRILINEAR_FILTERING, Texture::WrappingMode wrapping = REPEAT);
 
 		//	void setData(Image*);
@@ -100,22 +143,67 @@ namespace graphics
 		TextureDepth& operator=(const TextureDepth&);
 	};
 
+	//
+	// Frame buffer object with color texture and optional depth texture. Attachments are
+	// validated once when they change, so bind is only glBindFramebuffer and glViewport.
+	//
+	// With samples > 1 the target is multisampled and the color texture holds the resolved
+	// image after unbind. GL_EXT_multisampled_render_to_texture resolves implicitly in tile
+	// memory. On ES 3.0 without the extension, rendering goes to multisampled renderbuffers,
+	// which unbind resolves with glBlitFramebuffer. Multisampled depth is a renderbuffer,
+	// so getDepthBuffer returns 0. If neither is supported, the target is single-sampled.
+	// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 	class RenderTarget : public core::Object
 	{
 	public:
-		RenderTarget(int width, int height, bool createDepthBuffer, const GLenum format = GL_RGBA, const GLenum type = GL_UNSIGNED_BYTE);
+		// Attachments, whose contents can be discarded (see discard and unbind).
+		enum DiscardFlags
+		{
+			DISCARD_NONE	= 0,
+			DISCARD_COLOR	= 1,
+			DISCARD_DEPTH	= 2,
+			DISCARD_ALL		= DISCARD_COLOR | DISCARD_DEPTH
+		};
+
+		RenderTarget(int width, int height, bool createDepthBuffer, const GLenum format = GL_RGBA, const GLenum type = GL_UNSIGNED_BYTE, int samples = 0);
 		~RenderTarget();
 		void shareDepthBuffer(TextureDepth* depthBuffer);
 
 		void bind();
-		void unbind();
+
+		// Binds the frame buffer, which was bound when bind was called. Attachments
+		// given in discardFlags are discarded first, so tiled GPUs do not write them to memory.
+		// Multisampled color is resolved to the color texture, unless DISCARD_COLOR is given.
+		// Typically depth is not needed after the pass: unbind(DISCARD_DEPTH).
+		void unbind(int discardFlags = DISCARD_NONE);
+
+		// Discards attachments of the bound target. Calling this right after bind tells
+		// tiled GPUs, that previous contents do not need to be loaded.
+		void discard(int discardFlags);
 
 		Texture* getColorBuffer() const { return 	m_colorBuffer.ptr(); }
 		Texture* getDepthBuffer() const { return 	m_depthBuffer.ptr(); }
 
+		int getWidth() const { return m_width; }
+		int getHeight() const { return m_height; }
+
+		// Number of samples actually used (1 if not multisampled).
+		int getSamples() const { return m_samples; }
+
 	private:
+		// Leaves m_FBO or m_msaaFBO bound.
+		void createMultisampled(bool createDepthBuffer, GLenum format, GLenum type, int samples);
+
 		// frame buffer object
 		GLuint  m_FBO;
+		GLint	m_previousFBO;	// Bound when bind was called, restored by unbind
+
+		// multisampled frame buffer and renderbuffers (ES 3.0 path), or
+		// multisampled depth renderbuffer (GL_EXT_multisampled_render_to_texture)
+		GLuint	m_msaaFBO;
+		GLuint	m_colorRenderbuffer;
+		GLuint	m_depthRenderbuffer;
+		int		m_samples;
 
 		// re-using buffers as samplers
 		core::Ref<Texture>		m_colorBuffer;
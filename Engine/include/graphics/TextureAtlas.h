@@ -0,0 +1,126 @@
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Copyright (c) 2013 Mikko Romppainen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in the
+// Software without restriction, including without limitation the rights to use, copy,
+// modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+#ifndef _TEXTURE_ATLAS_H_
+#define _TEXTURE_ATLAS_H_
+#include <core/Object.h>
+#include <core/Ref.h>
+#include <graphics/Image.h>
+#include <graphics/Texture.h>
+#include <vector>
+
+namespace graphics
+{
+	//
+	// Skyline bottom-left rectangle packer. Keeps the top edge of the packed area as
+	// a list of horizontal segments and places each rectangle as low as possible.
+	// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+	class SkylinePacker
+	{
+	public:
+		SkylinePacker(int width, int height);
+
+		// Finds place for width x height rectangle. Returns false, if it does not fit.
+		bool pack(int width, int height, int* x, int* y);
+
+		// Removes all packed rectangles.
+		void reset();
+
+	private:
+		struct Segment
+		{
+			int x;
+			int y;
+			int width;
+		};
+
+		// Returns y, where rectangle would be placed starting from segment index, or -1.
+		int fit(size_t index, int width, int height) const;
+
+		std::vector<Segment>	m_skyline;
+		int						m_width;
+		int						m_height;
+	};
+
+	//
+	// Packs many small images to one texture, so they can be drawn without texture binds
+	// between draw calls.
+	//
+	// Each image is surrounded by a gutter of repeated edge pixels and aligned to 2^maxMipLevel
+	// pixels, so mip levels up to maxMipLevel do not bleed neighbouring images to each other.
+	//
+	// Usage:
+	//    int logo = atlas->add(logoImage);
+	//    int icon = atlas->add(iconImage);
+	//    atlas->build();
+	//    glUniform4fv(uvRectLoc, 1, atlas->getRegion(logo).uvRect);
+	//    // vertex shader: uv = uvRect.xy + inUv*(uvRect.zw - uvRect.xy);
+	// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+	class TextureAtlas : public core::Object
+	{
+	public:
+		struct Region
+		{
+			int		x;			// Position and size in atlas pixels, without gutter.
+			int		y;
+			int		width;
+			int		height;
+			float	uvRect[4];	// u0, v0, u1, v1
+		};
+
+		// @param bytesPerPixel Bytes per pixel of the atlas. All added images must have the same.
+		// @param padding Gutter width in pixels around each image.
+		// @param maxMipLevel Highest mip level, which must not bleed between images.
+		TextureAtlas(int width, int height, int bytesPerPixel, int padding = 2, int maxMipLevel = 2);
+		virtual ~TextureAtlas();
+
+		// Adds image to be packed on next build. Returns index of the region of the image.
+		int add(Image* image);
+
+		// Packs the images (largest first), copies them to the atlas image and creates the texture.
+		// Returns false, if all images did not fit. Regions of those images have zero size.
+		bool build(Texture::FilteringMode filtering = Texture::TRILINEAR_FILTERING, Texture::WrappingMode wrapping = Texture::CLAMP);
+
+		const Region& getRegion(int index) const;
+		int getNumRegions() const;
+
+		Image* getImage() const;
+		Texture2D* getTexture() const;
+
+	private:
+		// Copies image to the cell at (cellX, cellY) with padding and repeats its edge pixels
+		// to the rest of the cell.
+		void copyWithGutter(Image* image, int cellX, int cellY, int cellWidth, int cellHeight);
+
+		int										m_padding;
+		int										m_alignment;
+		core::Ref<Image>						m_image;
+		core::Ref<Texture2D>					m_texture;
+		std::vector< core::Ref<Image> >			m_images;
+		std::vector<Region>						m_regions;
+
+		TextureAtlas();
+		TextureAtlas(const TextureAtlas&);
+		TextureAtlas& operator=(const TextureAtlas&);
+	};
+}
+
+#endif
@@ -0,0 +1,178 @@
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Copyright (c) 2013 Mikko Romppainen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in the
+// Software without restriction, including without limitation the rights to use, copy,
+// modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+#ifndef _TEXTURE_STREAMER_H_
+#define _TEXTURE_STREAMER_H_
+#include <core/Object.h>
+#include <core/Ref.h>
+#include <graphics/Texture.h>
+#include <graphics/KtxFormat.h>
+#include <core/FileSystem.h>
+#include <core/JobSystem.h>
+#include <vector>
+#include <deque>
+#include <string>
+#include <mutex>
+
+namespace graphics
+{
+	class TextureStreamer;
+
+	//
+	// Texture, whose mip levels are streamed in and out by TextureStreamer.
+	// Level numbers refer to the mip chain of the file (0 = full resolution).
+	// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+	class StreamedTexture : public core::Object
+	{
+	public:
+		virtual ~StreamedTexture();
+
+		// Texture object stays the same when levels are streamed.
+		Texture2D* getTexture() const;
+
+		int getWidth() const;
+		int getHeight() const;
+		int getNumLevels() const;
+
+		// Most detailed level currently on the GPU.
+		int getResidentLevel() const;
+
+		// Bytes of texture memory used by the resident levels.
+		int getResidentBytes() const;
+
+	private:
+		friend class TextureStreamer;
+
+		StreamedTexture();
+		int getBytesFromLevel(int level) const;
+
+		std::string					m_fileName;
+		core::Ref<core::Stream>		m_file;				// Kept in memory for the lifetime of the texture
+		core::Ref<Texture2D>		m_texture;
+		Texture::FilteringMode		m_filtering;
+		Texture::WrappingMode		m_wrapping;
+		KtxHeader					m_header;
+		std::vector<int>			m_levelSizes;
+
+		// Low resolution levels, which are always kept in memory, so evicting is instant.
+		int							m_tailLevel;
+		std::vector<uint8_t>		m_tailData;
+		std::vector<KtxLevel>		m_tailLevels;
+
+		int							m_residentLevel;
+		int							m_requiredLevel;
+		int							m_pendingLevel;		// -1, if no load is in flight
+		int							m_lastUsedFrame;
+
+		StreamedTexture(const StreamedTexture&);
+		StreamedTexture& operator=(const StreamedTexture&);
+	};
+
+	//
+	// Streams mip levels of KTX textures (see writeEtc1Ktx) under a texture memory budget.
+	//
+	// Files stay memory mapped. Load jobs copy levels out of the mapping, so the disk
+	// reads happen as page faults on job system workers, not on the render thread.
+	//
+	// Textures are created with only their low resolution tail levels resident. Renderer reports
+	// each frame, how large each texture is on screen (use). update streams more detailed levels
+	// with job system jobs and uploads finished ones. When the budget is exceeded, textures,
+	// which have been unused for the longest time, are dropped back to their tail levels.
+	//
+	// All functions must be called from the render thread.
+	// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+	class TextureStreamer : public core::Object
+	{
+	public:
+		// @param budgetBytes Texture memory budget for all streamed textures.
+		TextureStreamer(int budgetBytes);
+		virtual ~TextureStreamer();
+
+		// Creates texture from KTX file. Uploads levels up to TAIL_SIZE pixels immediately.
+		// Returns 0, if the file can not be loaded.
+		StreamedTexture* add(const char* const fileName,
+			Texture::FilteringMode filtering = Texture::TRILINEAR_FILTERING,
+			Texture::WrappingMode wrapping = Texture::REPEAT);
+
+		// Reports, that texture is drawn this frame, covering about screenSize pixels
+		// (larger side of its screen space bounds).
+		void use(StreamedTexture* texture, float screenSize);
+
+		// Uploads finished levels, starts new loads and evicts textures over the budget.
+		// Call once per frame.
+		void update();
+
+		void setBudget(int budgetBytes);
+		int getBudget() const;
+
+		// Bytes used by resident levels of all textures.
+		int getUsedBytes() const;
+
+		// Returns mip level, which has about one texel per pixel when drawn to screenSize pixels.
+		static int computeRequiredLevel(int width, int height, float screenSize, int numLevels);
+
+		// Max size of the levels loaded by add.
+		enum { TAIL_SIZE = 32 };
+
+		// Textures unused for this many frames are not streamed in.
+		enum { USE_TIMEOUT_FRAMES = 30 };
+
+	private:
+		struct LoadRequest
+		{
+			TextureStreamer*	streamer;
+			StreamedTexture*	texture;
+			const uint8_t*		fileData;
+			int					fileSize;
+			int					level;
+		};
+
+		struct LoadResult
+		{
+			StreamedTexture*		texture;
+			int						level;
+			bool					ok;
+			KtxHeader				header;
+			std::vector<uint8_t>	data;
+			std::vector<KtxLevel>	levels;
+		};
+
+		static void loadJob(void* data);
+		void load(const LoadRequest& request, LoadResult& result);
+		void upload(StreamedTexture* texture, int level, const KtxHeader& header, const std::vector<KtxLevel>& levels);
+		bool makeRoom(int bytes, StreamedTexture* except);
+
+		std::vector< core::Ref<StreamedTexture> >	m_textures;
+		int											m_budget;
+		int											m_usedBytes;
+		int											m_frame;
+
+		core::JobCounter							m_loadJobs;
+		std::mutex									m_mutex;
+		std::deque<LoadResult*>						m_results;
+
+		TextureStreamer();
+		TextureStreamer(const TextureStreamer&);
+		TextureStreamer& operator=(const TextureStreamer&);
+	};
+}
+
+#endif
@@ -0,0 +1,143 @@
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Copyright (c) 2013 Mikko Romppainen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in the
+// Software without restriction, including without limitation the rights to use, copy,
+// modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+#ifndef _TEXTURE_UPLOAD_QUEUE_H_
+#define _TEXTURE_UPLOAD_QUEUE_H_
+#include <core/Object.h>
+#include <core/Ref.h>
+#include <core/FileSystem.h>
+#include <core/JobSystem.h>
+#include <graphics/Texture.h>
+#include <graphics/Image.h>
+#include <graphics/KtxFormat.h>
+#include <graphics/OpenGLES/es_util.h>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace graphics
+{
+	enum UploadMode
+	{
+		// Render thread uploads decoded textures in row strips, at most bytesPerFrame per update.
+		UPLOAD_TIME_SLICED,
+		// Loader thread with a shared EGL context uploads textures. Completion is published
+		// to the render thread with EGL fences. Falls back to UPLOAD_TIME_SLICED, if the
+		// shared context can not be created.
+		UPLOAD_SHARED_CONTEXT
+	};
+
+	//
+	// Loads TGA and KTX files to textures in the background, so loading does not drop frames.
+	//
+	// Files are decoded by job system jobs. Decoded textures are uploaded either in slices on the
+	// render thread (update) or on a loader thread with its own shared EGL context. Texture objects
+	// are created by the caller on the render thread. Until isPending returns false for a texture,
+	// its contents are undefined.
+	//
+	// All functions must be called from the render thread.
+	// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+	class TextureUploadQueue : public core::Object
+	{
+	public:
+		// @param bytesPerFrame Upload budget per update in UPLOAD_TIME_SLICED mode.
+		TextureUploadQueue(ESContext* esContext, UploadMode mode, int bytesPerFrame = 2*1024*1024);
+		virtual ~TextureUploadQueue();
+
+		// Queues file to be loaded to texture. Files ending with .ktx are loaded as KTX,
+		// others as TGA. Returns false, if the file can not be opened.
+		bool load(Texture2D* texture, const char* const fileName,
+			Texture::FilteringMode filtering = Texture::TRILINEAR_FILTERING,
+			Texture::WrappingMode wrapping = Texture::REPEAT);
+
+		// Uploads next slices (UPLOAD_TIME_SLICED) or publishes textures uploaded by the
+		// loader thread (UPLOAD_SHARED_CONTEXT). Call once per frame.
+		void update();
+
+		// Returns true, if texture is still loading.
+		bool isPending(Texture2D* texture) const;
+
+		// Number of textures still loading.
+		int getNumPending() const;
+
+		UploadMode getMode() const;
+
+	private:
+		struct Job
+		{
+			TextureUploadQueue*		queue;
+			Texture2D*				texture;
+			const uint8_t*			fileData;
+			int						fileSize;
+			bool					isKtx;
+			Texture::FilteringMode	filtering;
+			Texture::WrappingMode	wrapping;
+
+			bool					ok;
+			bool					done;
+			std::vector< core::Ref<Image> >	levels;	// Decoded TGA and its mip levels
+			KtxHeader				ktxHeader;
+			std::vector<KtxLevel>	ktxLevels;	// Point to the file data
+			int						nextLevel;	// Next level and row to upload in time sliced mode
+			int						nextRow;
+			void*					fence;		// EGLSyncKHR
+		};
+
+		struct PendingTexture
+		{
+			core::Ref<Texture2D>		texture;
+			core::Ref<core::Stream>		file;
+			Job*						job;
+		};
+
+		bool createSharedContext(ESContext* esContext);
+		static void decodeJob(void* data);
+		void uploadThread();
+		void decode(Job* job);
+		void uploadAll(Job* job);
+		int uploadSlice(Job* job, int maxBytes);
+
+		UploadMode						m_mode;
+		int								m_bytesPerFrame;
+		std::vector<PendingTexture>		m_pending;
+		Job*							m_current;
+
+		EGLDisplay						m_display;
+		EGLContext						m_sharedContext;
+		EGLSurface						m_sharedSurface;
+
+		core::JobCounter				m_decodeJobs;
+		std::thread						m_uploadThread;
+		mutable std::mutex				m_mutex;
+		std::condition_variable			m_uploadCondition;
+		std::deque<Job*>				m_decoded;
+		std::deque<Job*>				m_uploaded;
+		bool							m_quit;
+
+		TextureUploadQueue();
+		TextureUploadQueue(const TextureUploadQueue&);
+		TextureUploadQueue& operator=(const TextureUploadQueue&);
+	};
+}
+
+#endif
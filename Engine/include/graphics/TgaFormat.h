@@ -0,0 +1,99 @@
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Copyright (c) 2013 Mikko Romppainen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in the
+// Software without restriction, including without limitation the rights to use, copy,
+// modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+#ifndef _TGA_FORMAT_H_
+#define _TGA_FORMAT_H_
+#include <stdint.h>
+
+namespace graphics
+{
+	enum TgaImageType
+	{
+		TGA_COLOR_MAPPED		= 1,
+		TGA_TRUE_COLOR			= 2,
+		TGA_GRAYSCALE			= 3,
+		TGA_RLE_COLOR_MAPPED	= 9,
+		TGA_RLE_TRUE_COLOR		= 10,
+		TGA_RLE_GRAYSCALE		= 11
+	};
+
+	//
+	// Parsed TGA file header. Fields are read byte by byte, so there are no struct packing
+	// or endianness issues.
+	// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+	struct TgaHeader
+	{
+		enum { SIZE = 18 };
+
+		uint8_t		idLength;
+		uint8_t		colorMapType;
+		uint8_t		imageType;
+		uint16_t	colorMapFirst;
+		uint16_t	colorMapLength;
+		uint8_t		colorMapDepth;
+		uint16_t	width;
+		uint16_t	height;
+		uint8_t		pixelDepth;
+		uint8_t		descriptor;
+
+		// Parses and validates header from first SIZE bytes of file. Returns false, if
+		// the file is not supported TGA file.
+		bool parse(const uint8_t* p);
+
+		bool isRle() const { return imageType >= TGA_RLE_COLOR_MAPPED; }
+		bool isTopOrigin() const { return (descriptor & 0x20) != 0; }
+		bool isRightOrigin() const { return (descriptor & 0x10) != 0; }
+
+		// Bytes per pixel in TGA pixel data (or color map indices).
+		int getSourceBPP() const { return (pixelDepth + 7) / 8; }
+
+		// Size of the color map in bytes.
+		int getColorMapSize() const;
+
+		// Offset of the pixel data from the beginning of file.
+		int getPixelDataOffset() const { return SIZE + idLength + getColorMapSize(); }
+
+		// Bytes per pixel of the decoded image: 1 (luminance), 2 (luminance alpha), 3 (RGB) or 4 (RGBA).
+		int getDecodedBPP() const;
+
+		// True, if pixel data can be used as is after red/blue swap (uncompressed 24/32-bit
+		// true color or 8-bit grayscale, without color map).
+		bool isDirectlyDecodable() const;
+	};
+
+	//
+	// Decodes pixel data of TGA file to RGB(A) or luminance(-alpha) pixels.
+	// Output rows are stored bottom-to-top, left-to-right, as OpenGL expects.
+	// @param colorMap Color map data (getColorMapSize bytes) or 0.
+	// @param src Pixel data, starting at getPixelDataOffset.
+	// @param srcLen Number of bytes available in src.
+	// @param dst [out] width*height*getDecodedBPP bytes.
+	// @return false, if pixel data is truncated or corrupted.
+	bool decodeTgaPixels(const TgaHeader& header, const uint8_t* colorMap,
+		const uint8_t* src, int srcLen, uint8_t* dst);
+
+	//
+	// Converts in place decoded, but not yet swizzled uncompressed pixels (see
+	// TgaHeader::isDirectlyDecodable): swaps BGR(A) to RGB(A) and fixes image origin.
+	void finishTgaPixels(const TgaHeader& header, uint8_t* pixels);
+}
+
+#endif
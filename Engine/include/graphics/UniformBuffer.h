@@ -0,0 +1,171 @@
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Copyright (c) 2013 Mikko Romppainen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in the
+// Software without restriction, including without limitation the rights to use, copy,
+// modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+#ifndef _UNIFORM_BUFFER_H_
+#define _UNIFORM_BUFFER_H_
+#include <core/Object.h>
+#include <core/Ref.h>
+#include <graphics/OpenGLES/es_ext.h>
+#include <stdint.h>
+#include <vector>
+#include <string>
+
+namespace graphics
+{
+	class Shader;
+
+	//
+	// Ring buffer for per-draw uniform data (OpenGL ES 3.0).
+	// Single GL_UNIFORM_BUFFER is divided to numFrames segments. Each frame sub-allocates
+	// constants from its own segment and binds them with glBindBufferRange, so there is no
+	// buffer orphaning or per-draw glBufferData. A fence is inserted at endFrame and waited
+	// at beginFrame before the segment is reused, so the CPU never overwrites data that the
+	// GPU is still reading.
+	//
+	// Typical usage:
+	//    ring->beginFrame();
+	//    for each object:
+	//        int offs = ring->push(&objectConstants, sizeof(objectConstants));
+	//        ring->bindRange(OBJECT_BLOCK_BINDING, offs, sizeof(objectConstants));
+	//        mesh->render();
+	//    ring->endFrame();
+	// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+	class UniformRingBuffer : public core::Object
+	{
+	public:
+		UniformRingBuffer(int bytesPerFrame, int numFrames = 3);
+		virtual ~UniformRingBuffer();
+
+		// Starts new frame. Waits, if GPU is still using the segment which is taken into use.
+		void beginFrame();
+
+		// Ends frame. Must be called after last draw call, which uses data of this frame.
+		void endFrame();
+
+		// Copies size bytes to the ring buffer. Returns offset of data in buffer or -1, if
+		// segment of the current frame is full.
+		int push(const void* data, int size);
+
+		// Binds given range of the buffer to uniform buffer binding point.
+		void bindRange(GLuint bindingPoint, int offset, int size);
+
+		GLuint getBuffer() const { return m_ubo; }
+		int getAlignment() const { return m_alignment; }
+
+		// Number of bytes pushed during current frame.
+		int getBytesUsed() const { return m_head - m_frameIndex*m_bytesPerFrame; }
+
+	private:
+		GLuint					m_ubo;
+		int						m_bytesPerFrame;
+		int						m_numFrames;
+		int						m_frameIndex;
+		int						m_head;
+		int						m_alignment;
+		std::vector<GLsync>		m_fences;
+
+		UniformRingBuffer(const UniformRingBuffer&);
+		UniformRingBuffer& operator=(const UniformRingBuffer&);
+	};
+
+
+	//
+	// Uniform block, which is backed by uniform buffer object on OpenGL ES 3.0.
+	// Block data is kept in CPU memory using std140 layout. On ES 3.0 the whole block is
+	// uploaded with one buffer update and bound with one glBindBufferRange call. On ES 2.0
+	// contexts and for programs, which do not declare the block, it falls back to plain
+	// uniforms: each member declared with addMember is set with glUniform* using the uniform
+	// name given for the member.
+	//
+	// Example (GLSL ES 3.00 shader declares "uniform PerObject { mat4 g_matModelViewProj; vec4 g_color; };"):
+	//    m_block = new graphics::UniformBlock("PerObject", 80, 1);
+	//    m_block->addMember("g_matModelViewProj", GL_FLOAT_MAT4, 0);
+	//    m_block->addMember("g_color", GL_FLOAT_VEC4, 64);
+	//    ...
+	//    m_block->setData(&mvp, sizeof(mvp), 0);
+	//    m_block->bind(shader, ring);
+	// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+	class UniformBlock : public core::Object
+	{
+	public:
+		UniformBlock(const char* const blockName, int sizeInBytes, GLuint bindingPoint);
+		virtual ~UniformBlock();
+
+		// Declares block member for ES 2.0 fallback. Offset is std140 offset in block data
+		// and count is array size. Supported types are GL_FLOAT, GL_FLOAT_VEC2..4, GL_INT,
+		// GL_FLOAT_MAT3 and GL_FLOAT_MAT4.
+		void addMember(const char* const uniformName, GLenum type, int offset, int count = 1);
+
+		// Copies data to the block.
+		void setData(const void* data, int size, int offset = 0);
+
+		// Returns block data for direct modification. Marks block dirty.
+		void* getData();
+
+		int getSize() const { return (int)m_data.size(); }
+		GLuint getBindingPoint() const { return m_bindingPoint; }
+
+		// Binds block values to given shader. Shader must be bound.
+		// If ring is given (ES 3.0 only), data is pushed to the ring buffer, which is the
+		// preferred way for per-draw data. Otherwise block's own buffer is updated if dirty.
+		void bind(Shader* shader, UniformRingBuffer* ring = 0);
+
+		// Returns true, if uniform blocks are backed by buffer objects in current context.
+		static bool isBufferBacked();
+
+	private:
+		struct Member
+		{
+			std::string	name;
+			GLenum		type;
+			int			offset;
+			int			count;
+		};
+
+		// Program ids can be reused after a shader reload, so bindings are keyed by the shader
+		// and its revision.
+		struct ProgramBinding
+		{
+			const Shader*		shader;
+			int					revision;
+			GLuint				program;
+			GLuint				blockIndex;
+			std::vector<GLint>	locations;
+		};
+
+		ProgramBinding& getProgramBinding(Shader* shader);
+		void setUniforms(const ProgramBinding& binding);
+
+		std::string					m_blockName;
+		GLuint						m_bindingPoint;
+		GLuint						m_ubo;
+		bool						m_dirty;
+		std::vector<uint8_t>		m_data;
+		std::vector<Member>			m_members;
+		std::vector<ProgramBinding>	m_programs;
+		std::vector<float>			m_scratch;
+
+		UniformBlock(const UniformBlock&);
+		UniformBlock& operator=(const UniformBlock&);
+	};
+}
+
+#endif
@@ -30,6 +30,7 @@
 #include <es_util.h>
 #include <es_assert.h>
 #include <core/ElapsedTimer.h>
+#include <core/JobSystem.h>
 
 #include <core/log.h>
 
@@ -178,7 +179,23 @@ static bool engine_init_display(ESContext* engine)
 	eglCheckError("eglCreateWindowSurface");
 
 	EGLint contextAttribs[] = { EGL_CONTEXT_CLIENT_VERSION, 2, EGL_NONE, EGL_NONE };
-    context = eglCreateContext(display, config, NULL, contextAttribs);
+	context = EGL_NO_CONTEXT;
+	if( engine->version == ES_VERSION_3 )
+	{
+		// Try ES 3.0 first, fall back to ES 2.0 if driver does not support it.
+		EGLint contextAttribs3[] = { EGL_CONTEXT_CLIENT_VERSION, 3, EGL_NONE, EGL_NONE };
+		context = eglCreateContext(display, config, NULL, contextAttribs3);
+		if( context == EGL_NO_CONTEXT )
+		{
+			eglGetError();
+			engine->version = ES_VERSION_2;
+		}
+	}
+
+	if( context == EGL_NO_CONTEXT )
+	{
+		context = eglCreateContext(display, config, NULL, contextAttribs);
+	}
 	eglCheckError("eglCreateContext");
 
     if (eglMakeCurrent(display, surface, surface, context) == EGL_FALSE) 
@@ -423,6 +440,8 @@ void esMainLoop( ESContext *esContext )
 {
 	
 	Engine::printLog( tag, "esMainLoop enter" );
+	// Job system is created here, so this thread (which owns the GL context) is its main thread.
+	core::JobSystem* jobSystem = core::getJobSystem();
 	ElapsedTimer timer;
 	timer.reset();
 	initDone = false;
@@ -480,6 +499,8 @@ void esMainLoop( ESContext *esContext )
 				
 		if( initDone && shallQuit == false )
 		{
+			jobSystem->runMainThreadJobs();
+
 			if( deltaTime > 0.0f )
 			{
 				esContext->updateFunc ( esContext, deltaTime );
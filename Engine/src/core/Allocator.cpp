@@ -0,0 +1,334 @@
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Copyright (c) 2013 Mikko Romppainen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in the
+// Software without restriction, including without limitation the rights to use, copy,
+// modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+#include <core/Allocator.h>
+#include <es_assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <atomic>
+#if defined(_WIN32)
+#include <malloc.h>
+#elif defined(ANDROID)
+#include <malloc.h>
+#endif
+
+namespace core
+{
+
+// anonymous namespace for internal functions
+namespace
+{
+	// Stored right before every block returned by engineAllocMem.
+	struct BlockHeader
+	{
+		Allocator*	allocator;
+		uint32_t	size;
+		uint16_t	category;
+		uint16_t	offset;		// From start of the allocation to the returned pointer
+	};
+
+	struct CategoryCounters
+	{
+		std::atomic<size_t>	liveBytes;
+		std::atomic<size_t>	peakBytes;
+		std::atomic<size_t>	liveAllocations;
+		std::atomic<size_t>	totalAllocations;
+		std::atomic<size_t>	budget;
+		std::atomic<bool>	budgetWarned;
+	};
+
+	const char* const categoryNames[MEMORY_NUM_CATEGORIES] =
+	{
+		"general",
+		"mesh",
+		"texture",
+		"shader",
+		"scene",
+		"string"
+	};
+
+	// Zero initialized before any dynamic initialization, so allocations made by
+	// constructors of global objects are counted correctly.
+	CategoryCounters counters[MEMORY_NUM_CATEGORIES];
+
+	Allocator* defaultAllocator = 0;
+
+	thread_local MemoryCategory currentCategory = MEMORY_GENERAL;
+
+	SystemAllocator& getSystemAllocator()
+	{
+		static SystemAllocator systemAllocator;
+		return systemAllocator;
+	}
+
+	void countAlloc(int category, size_t size)
+	{
+		CategoryCounters& c = counters[category];
+		const size_t live = c.liveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+		c.liveAllocations.fetch_add(1, std::memory_order_relaxed);
+		c.totalAllocations.fetch_add(1, std::memory_order_relaxed);
+
+		size_t peak = c.peakBytes.load(std::memory_order_relaxed);
+		while( live > peak && !c.peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed) )
+		{
+		}
+
+		const size_t budget = c.budget.load(std::memory_order_relaxed);
+		if( budget != 0 && live > budget && !c.budgetWarned.exchange(true, std::memory_order_relaxed) )
+		{
+			printf("[%s] Memory budget of category \"%s\" exceeded: %u / %u bytes\n", __FUNCTION__,
+				categoryNames[category], (unsigned)live, (unsigned)budget);
+		}
+	}
+
+	void countFree(int category, size_t size)
+	{
+		CategoryCounters& c = counters[category];
+		c.liveBytes.fetch_sub(size, std::memory_order_relaxed);
+		c.liveAllocations.fetch_sub(1, std::memory_order_relaxed);
+	}
+
+	BlockHeader* getHeader(void* p)
+	{
+		return reinterpret_cast<BlockHeader*>(p) - 1;
+	}
+}
+
+Allocator::Allocator( const char* const name )
+: m_name(name)
+{
+}
+
+Allocator::~Allocator()
+{
+}
+
+const char* Allocator::getName() const
+{
+	return m_name;
+}
+
+SystemAllocator::SystemAllocator()
+: Allocator("system")
+{
+}
+
+SystemAllocator::~SystemAllocator()
+{
+}
+
+void* SystemAllocator::allocate( size_t size, size_t alignment )
+{
+#if defined(_WIN32)
+	return _aligned_malloc(size, alignment);
+#elif defined(ANDROID)
+	return memalign(alignment, size);
+#else
+	void* p = 0;
+	if( alignment < sizeof(void*) )
+	{
+		alignment = sizeof(void*);
+	}
+	return posix_memalign(&p, alignment, size) == 0 ? p : 0;
+#endif
+}
+
+void SystemAllocator::deallocate( void* p, size_t size )
+{
+	(void)size;
+#if defined(_WIN32)
+	_aligned_free(p);
+#else
+	free(p);
+#endif
+}
+
+MemoryCategoryScope::MemoryCategoryScope( MemoryCategory category )
+: m_previous(currentCategory)
+{
+	assert( category >= 0 && category < MEMORY_NUM_CATEGORIES );
+	currentCategory = category;
+}
+
+MemoryCategoryScope::~MemoryCategoryScope()
+{
+	currentCategory = m_previous;
+}
+
+Allocator* getDefaultAllocator()
+{
+	return defaultAllocator ? defaultAllocator : &getSystemAllocator();
+}
+
+void setDefaultAllocator( Allocator* alloc )
+{
+	defaultAllocator = alloc;
+}
+
+MemoryCategory getCurrentMemoryCategory()
+{
+	return currentCategory;
+}
+
+MemoryStats getMemoryStats( MemoryCategory category )
+{
+	assert( category >= 0 && category < MEMORY_NUM_CATEGORIES );
+	const CategoryCounters& c = counters[category];
+	MemoryStats stats;
+	stats.liveBytes = c.liveBytes.load(std::memory_order_relaxed);
+	stats.peakBytes = c.peakBytes.load(std::memory_order_relaxed);
+	stats.liveAllocations = c.liveAllocations.load(std::memory_order_relaxed);
+	stats.totalAllocations = c.totalAllocations.load(std::memory_order_relaxed);
+	stats.budget = c.budget.load(std::memory_order_relaxed);
+	return stats;
+}
+
+const char* getMemoryCategoryName( MemoryCategory category )
+{
+	assert( category >= 0 && category < MEMORY_NUM_CATEGORIES );
+	return categoryNames[category];
+}
+
+void setMemoryBudget( MemoryCategory category, size_t bytes )
+{
+	assert( category >= 0 && category < MEMORY_NUM_CATEGORIES );
+	counters[category].budget.store(bytes, std::memory_order_relaxed);
+	counters[category].budgetWarned.store(false, std::memory_order_relaxed);
+}
+
+bool isMemoryBudgetExceeded( MemoryCategory category )
+{
+	const MemoryStats stats = getMemoryStats(category);
+	return stats.budget != 0 && stats.liveBytes > stats.budget;
+}
+
+void printMemoryStats()
+{
+	printf("%-10s %12s %12s %10s %12s\n", "category", "live", "peak", "blocks", "budget");
+	for( int i = 0; i < MEMORY_NUM_CATEGORIES; ++i )
+	{
+		const MemoryStats stats = getMemoryStats(MemoryCategory(i));
+		printf("%-10s %12u %12u %10u %12u\n", categoryNames[i], (unsigned)stats.liveBytes,
+			(unsigned)stats.peakBytes, (unsigned)stats.liveAllocations, (unsigned)stats.budget);
+	}
+}
+
+}
+
+void* engineAllocMem(core::Allocator* alloc, size_t size, size_t alignment, core::MemoryCategory category)
+{
+	assert( (alignment & (alignment - 1)) == 0 );
+	if( alignment < sizeof(core::BlockHeader) )
+	{
+		alignment = sizeof(core::BlockHeader) <= 8 ? 8 : 16;
+	}
+
+	if( category == core::MEMORY_CURRENT )
+	{
+		category = core::currentCategory;
+	}
+
+	// Header goes right before the returned pointer, which keeps the requested alignment.
+	const size_t offset = (sizeof(core::BlockHeader) + alignment - 1) & ~(alignment - 1);
+	uint8_t* block = (uint8_t*)alloc->allocate(offset + size, alignment);
+	if( block == 0 )
+	{
+		return 0;
+	}
+
+	void* p = block + offset;
+	core::BlockHeader* header = core::getHeader(p);
+	header->allocator = alloc;
+	header->size = (uint32_t)size;
+	header->category = (uint16_t)category;
+	header->offset = (uint16_t)offset;
+	core::countAlloc(category, size);
+	return p;
+}
+
+void engineFreeMem(core::Allocator* alloc, void* p)
+{
+	if( p == 0 )
+	{
+		return;
+	}
+
+	core::BlockHeader* header = core::getHeader(p);
+	assert( alloc == 0 || alloc == header->allocator );
+	(void)alloc;
+
+	core::countFree(header->category, header->size);
+	header->allocator->deallocate((uint8_t*)p - header->offset, header->offset + header->size);
+}
+
+void* engineAllocMem(size_t size)
+{
+	return engineAllocMem(core::getDefaultAllocator(), size);
+}
+
+void engineFreeMem(void* p)
+{
+	engineFreeMem(0, p);
+}
+
+void* engineReallocMem(void* ud, void* ptr, size_t x, size_t s)
+{
+	(void)x;
+	if( s == 0 )
+	{
+		engineFreeMem(ptr);
+		return 0;
+	}
+
+	if( ptr == 0 )
+	{
+		core::Allocator* alloc = ud ? (core::Allocator*)ud : core::getDefaultAllocator();
+		return engineAllocMem(alloc, s);
+	}
+
+	// Shrinking keeps the block, so it can not fail.
+	core::BlockHeader* header = core::getHeader(ptr);
+	if( s <= header->size )
+	{
+		return ptr;
+	}
+
+	void* p = engineAllocMem(header->allocator, s, 16, (core::MemoryCategory)header->category);
+	if( p != 0 )
+	{
+		memcpy(p, ptr, header->size);
+		engineFreeMem(ptr);
+	}
+
+	return p;
+}
+
+void* engineAllocMemString(size_t size)
+{
+	return engineAllocMem(core::getDefaultAllocator(), size, sizeof(void*), core::MEMORY_STRING);
+}
+
+void engineFreeMemString(void* p)
+{
+	engineFreeMem(p);
+}
@@ -0,0 +1,706 @@
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Copyright (c) 2013 Mikko Romppainen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in the
+// Software without restriction, including without limitation the rights to use, copy,
+// modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+#include <core/AsyncFileReader.h>
+#include <core/FileSystem.h>
+#include <es_assert.h>
+#include <string.h>
+#include <algorithm>
+
+#if defined(__linux__) && defined(ENGINE_USE_IO_URING)
+#define ENGINE_IO_URING 1
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/eventfd.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <errno.h>
+#else
+#define ENGINE_IO_URING 0
+#endif
+
+namespace core
+{
+
+AsyncReadRequest::AsyncReadRequest( const char* const fileName, int offset, int size, int priority,
+	AsyncReadCallback callback, void* userData )
+: Object()
+, m_fileName(fileName)
+, m_offset(offset)
+, m_requestedSize(size)
+, m_priority(priority)
+, m_callback(callback)
+, m_userData(userData)
+, m_buffer()
+, m_size(0)
+, m_status(STATUS_QUEUED)
+, m_fd(-1)
+, m_bytesDone(0)
+{
+}
+
+AsyncReadRequest::~AsyncReadRequest()
+{
+}
+
+AsyncReadRequest::Status AsyncReadRequest::getStatus() const
+{
+	return (Status)m_status.load();
+}
+
+bool AsyncReadRequest::isFinished() const
+{
+	return m_status.load() >= STATUS_COMPLETED;
+}
+
+void AsyncReadRequest::wait()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while( !isFinished() )
+	{
+		m_condition.wait(lock);
+	}
+}
+
+const uint8_t* AsyncReadRequest::getData() const
+{
+	return m_buffer.empty() ? 0 : &m_buffer[0];
+}
+
+int AsyncReadRequest::getSize() const
+{
+	return m_size;
+}
+
+const char* AsyncReadRequest::getFileName() const
+{
+	return m_fileName.c_str();
+}
+
+void AsyncReadRequest::finish( Status status )
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_status = status;
+	}
+
+	m_condition.notify_all();
+}
+
+#if ENGINE_IO_URING
+//
+// io_uring used through raw system calls, so that liburing is not needed.
+struct IoUring
+{
+	int							ringFd;
+	int							eventFd;		// Written to wake the I/O thread
+	unsigned*					sqHead;
+	unsigned*					sqTail;
+	unsigned*					sqMask;
+	unsigned*					sqArray;
+	io_uring_sqe*				sqes;
+	unsigned*					cqHead;
+	unsigned*					cqTail;
+	unsigned*					cqMask;
+	io_uring_cqe*				cqes;
+	void*						sqRing;
+	size_t						sqRingSize;
+	void*						cqRing;
+	size_t						cqRingSize;
+	size_t						sqesSize;
+	unsigned					numToSubmit;
+	int							numPrefetchInFlight;
+	std::vector< Ref<AsyncReadRequest> >	inFlight;
+};
+
+// anonymous namespace for internal functions
+namespace
+{
+	const uint64_t EVENT_USER_DATA = 0;
+
+	bool uringCreate( IoUring*& ring, unsigned entries );
+	void uringDestroy( IoUring* ring );
+}
+#endif
+
+AsyncFileReader::AsyncFileReader( int numThreads, int maxInFlight )
+: Object()
+, m_backend(BACKEND_THREADS)
+, m_maxInFlight(maxInFlight)
+, m_maxPrefetchReading(numThreads > 1 ? numThreads / 2 : 1)
+, m_numPrefetchReading(0)
+, m_numPending(0)
+, m_quit(false)
+, m_uring(0)
+{
+	assert( numThreads > 0 && maxInFlight > 0 );
+
+#if ENGINE_IO_URING
+	// io_uring can be disabled in the kernel or blocked by seccomp, fall back to threads then.
+	if( uringCreate(m_uring, maxInFlight + 1) )
+	{
+		m_backend = BACKEND_IO_URING;
+		m_threads.push_back(std::thread(&AsyncFileReader::uringThread, this));
+		return;
+	}
+#endif
+
+	for( int i = 0; i < numThreads; ++i )
+	{
+		m_threads.push_back(std::thread(&AsyncFileReader::workerThread, this));
+	}
+}
+
+AsyncFileReader::~AsyncFileReader()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_quit = true;
+		for( int p = 0; p < NUM_PRIORITIES; ++p )
+		{
+			for( size_t i = 0; i < m_queues[p].size(); ++i )
+			{
+				m_queues[p][i]->finish(AsyncReadRequest::STATUS_CANCELLED);
+				--m_numPending;
+			}
+			m_queues[p].clear();
+		}
+	}
+
+	m_condition.notify_all();
+	wakeUp();
+	for( size_t i = 0; i < m_threads.size(); ++i )
+	{
+		m_threads[i].join();
+	}
+
+#if ENGINE_IO_URING
+	if( m_uring != 0 )
+	{
+		uringDestroy(m_uring);
+	}
+#endif
+}
+
+Ref<AsyncReadRequest> AsyncFileReader::read( const char* const fileName, int offset, int size,
+	Priority priority, AsyncReadCallback callback, void* userData )
+{
+	assert( offset >= 0 );
+	Ref<AsyncReadRequest> request = new AsyncReadRequest(fileName, offset, size, priority, callback, userData);
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_queues[priority].push_back(request);
+		++m_numPending;
+	}
+
+	wakeUp();
+	return request;
+}
+
+bool AsyncFileReader::cancel( AsyncReadRequest* request )
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if( !removeQueued(request) )
+	{
+		return false;
+	}
+
+	--m_numPending;
+	request->finish(AsyncReadRequest::STATUS_CANCELLED);
+	return true;
+}
+
+void AsyncFileReader::setPriority( AsyncReadRequest* request, Priority priority )
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if( request->m_priority != priority && removeQueued(request) )
+	{
+		request->m_priority = priority;
+		m_queues[priority].push_back(request);
+	}
+}
+
+int AsyncFileReader::getNumPending() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_numPending;
+}
+
+AsyncFileReader::Backend AsyncFileReader::getBackend() const
+{
+	return m_backend;
+}
+
+Ref<AsyncReadRequest> AsyncFileReader::popRequest( bool allowPrefetch )
+{
+	// Called with m_mutex locked.
+	const int numPriorities = allowPrefetch ? NUM_PRIORITIES : PRIORITY_PREFETCH;
+	for( int p = 0; p < numPriorities; ++p )
+	{
+		if( !m_queues[p].empty() )
+		{
+			Ref<AsyncReadRequest> request = m_queues[p].front();
+			m_queues[p].pop_front();
+			request->m_status = AsyncReadRequest::STATUS_READING;
+			return request;
+		}
+	}
+
+	return 0;
+}
+
+bool AsyncFileReader::removeQueued( AsyncReadRequest* request )
+{
+	// Called with m_mutex locked.
+	if( request->getStatus() != AsyncReadRequest::STATUS_QUEUED )
+	{
+		return false;
+	}
+
+	std::deque< Ref<AsyncReadRequest> >& queue = m_queues[request->m_priority];
+	for( size_t i = 0; i < queue.size(); ++i )
+	{
+		if( queue[i].ptr() == request )
+		{
+			queue.erase(queue.begin() + i);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void AsyncFileReader::complete( AsyncReadRequest* request, AsyncReadRequest::Status status )
+{
+	if( status != AsyncReadRequest::STATUS_COMPLETED )
+	{
+		request->m_buffer.clear();
+		request->m_size = 0;
+	}
+
+	if( request->m_callback != 0 )
+	{
+		request->m_callback(request, request->m_userData);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		--m_numPending;
+	}
+
+	request->finish(status);
+}
+
+void AsyncFileReader::readBlocking( AsyncReadRequest* request )
+{
+	Ref<Stream> stream = FileSystem::openFile(request->m_fileName.c_str());
+	if( stream == 0 || request->m_offset > stream->size() )
+	{
+		complete(request, AsyncReadRequest::STATUS_FAILED);
+		return;
+	}
+
+	int size = stream->size() - request->m_offset;
+	if( request->m_requestedSize >= 0 && request->m_requestedSize < size )
+	{
+		size = request->m_requestedSize;
+	}
+
+	request->m_buffer.resize(size);
+	request->m_size = size;
+	if( size > 0 )
+	{
+		if( stream->data() != 0 )
+		{
+			memcpy(&request->m_buffer[0], stream->data() + request->m_offset, size);
+		}
+		else if( !stream->seek(request->m_offset) || stream->read(&request->m_buffer[0], size) != size )
+		{
+			complete(request, AsyncReadRequest::STATUS_FAILED);
+			return;
+		}
+	}
+
+	complete(request, AsyncReadRequest::STATUS_COMPLETED);
+}
+
+void AsyncFileReader::workerThread()
+{
+	bool prefetch = false;
+	for( ;; )
+	{
+		Ref<AsyncReadRequest> request;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			if( prefetch )
+			{
+				// Another worker may be waiting for a prefetch slot.
+				--m_numPrefetchReading;
+				if( !m_queues[PRIORITY_PREFETCH].empty() )
+				{
+					m_condition.notify_one();
+				}
+			}
+
+			while( !m_quit && (request = popRequest(m_numPrefetchReading < m_maxPrefetchReading)) == 0 )
+			{
+				m_condition.wait(lock);
+			}
+
+			if( m_quit )
+			{
+				return;
+			}
+
+			prefetch = request->m_priority == PRIORITY_PREFETCH;
+			if( prefetch )
+			{
+				++m_numPrefetchReading;
+			}
+		}
+
+		readBlocking(request.ptr());
+	}
+}
+
+#if ENGINE_IO_URING
+namespace
+{
+	bool uringCreate( IoUring*& ring, unsigned entries )
+	{
+		io_uring_params params;
+		memset(&params, 0, sizeof(params));
+		int fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+		if( fd < 0 )
+		{
+			return false;
+		}
+
+		// IORING_OP_READ (5.6) is older than IORING_FEAT_FAST_POLL (5.7).
+		if( (params.features & IORING_FEAT_FAST_POLL) == 0 )
+		{
+			close(fd);
+			return false;
+		}
+
+		IoUring* r = new IoUring();
+		r->ringFd = fd;
+		r->sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+		r->cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+		if( params.features & IORING_FEAT_SINGLE_MMAP )
+		{
+			r->sqRingSize = r->cqRingSize = std::max(r->sqRingSize, r->cqRingSize);
+		}
+
+		r->sqRing = mmap(0, r->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+		r->cqRing = (params.features & IORING_FEAT_SINGLE_MMAP) ? r->sqRing :
+			mmap(0, r->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+		r->sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+		void* sqes = mmap(0, r->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+		r->eventFd = eventfd(0, EFD_CLOEXEC);
+		if( r->sqRing == MAP_FAILED || r->cqRing == MAP_FAILED || sqes == MAP_FAILED || r->eventFd < 0 )
+		{
+			if( sqes != MAP_FAILED )
+			{
+				munmap(sqes, r->sqesSize);
+			}
+			r->sqes = 0;
+			uringDestroy(r);
+			return false;
+		}
+
+		uint8_t* sq = (uint8_t*)r->sqRing;
+		uint8_t* cq = (uint8_t*)r->cqRing;
+		r->sqHead = (unsigned*)(sq + params.sq_off.head);
+		r->sqTail = (unsigned*)(sq + params.sq_off.tail);
+		r->sqMask = (unsigned*)(sq + params.sq_off.ring_mask);
+		r->sqArray = (unsigned*)(sq + params.sq_off.array);
+		r->sqes = (io_uring_sqe*)sqes;
+		r->cqHead = (unsigned*)(cq + params.cq_off.head);
+		r->cqTail = (unsigned*)(cq + params.cq_off.tail);
+		r->cqMask = (unsigned*)(cq + params.cq_off.ring_mask);
+		r->cqes = (io_uring_cqe*)(cq + params.cq_off.cqes);
+		r->numToSubmit = 0;
+		r->numPrefetchInFlight = 0;
+		ring = r;
+		return true;
+	}
+
+	void uringDestroy( IoUring* ring )
+	{
+		if( ring->sqes != 0 )
+		{
+			munmap(ring->sqes, ring->sqesSize);
+		}
+
+		if( ring->cqRing != MAP_FAILED && ring->cqRing != ring->sqRing )
+		{
+			munmap(ring->cqRing, ring->cqRingSize);
+		}
+
+		if( ring->sqRing != MAP_FAILED )
+		{
+			munmap(ring->sqRing, ring->sqRingSize);
+		}
+
+		if( ring->eventFd >= 0 )
+		{
+			close(ring->eventFd);
+		}
+
+		close(ring->ringFd);
+		delete ring;
+	}
+
+	// Returns next free submission entry. Ring has room for every request in flight.
+	io_uring_sqe* uringGetSqe( IoUring* ring )
+	{
+		unsigned tail = *ring->sqTail;
+		unsigned index = tail & *ring->sqMask;
+		assert( tail - __atomic_load_n(ring->sqHead, __ATOMIC_ACQUIRE) <= *ring->sqMask );
+
+		io_uring_sqe* sqe = &ring->sqes[index];
+		memset(sqe, 0, sizeof(*sqe));
+		ring->sqArray[index] = index;
+		__atomic_store_n(ring->sqTail, tail + 1, __ATOMIC_RELEASE);
+		++ring->numToSubmit;
+		return sqe;
+	}
+
+	// Waits for the wake up event. Poll requests are one shot, so this is rearmed after each wake up.
+	void uringArmEvent( IoUring* ring )
+	{
+		io_uring_sqe* sqe = uringGetSqe(ring);
+		sqe->opcode = IORING_OP_POLL_ADD;
+		sqe->fd = ring->eventFd;
+		sqe->poll_events = POLLIN;
+		sqe->user_data = EVENT_USER_DATA;
+	}
+
+	void uringSubmitRead( IoUring* ring, AsyncReadRequest* request, int fd,
+		uint8_t* dst, int size, int offset )
+	{
+		io_uring_sqe* sqe = uringGetSqe(ring);
+		sqe->opcode = IORING_OP_READ;
+		sqe->fd = fd;
+		sqe->addr = (uint64_t)(uintptr_t)dst;
+		sqe->len = size;
+		sqe->off = offset;
+		sqe->user_data = (uint64_t)(uintptr_t)request;
+	}
+}
+#endif
+
+void AsyncFileReader::wakeUp()
+{
+#if ENGINE_IO_URING
+	if( m_uring != 0 )
+	{
+		uint64_t one = 1;
+		ssize_t n = write(m_uring->eventFd, &one, sizeof(one));
+		(void)n;
+		return;
+	}
+#endif
+
+	m_condition.notify_one();
+}
+
+bool AsyncFileReader::startUring( AsyncReadRequest* request )
+{
+#if ENGINE_IO_URING
+	// Pack entries and Android assets are not files on disk.
+	if( FileSystem::isPacked(request->m_fileName.c_str()) )
+	{
+		return false;
+	}
+
+	int fd = open(request->m_fileName.c_str(), O_RDONLY | O_CLOEXEC);
+	if( fd < 0 )
+	{
+		return false;
+	}
+
+	struct stat st;
+	if( fstat(fd, &st) != 0 || st.st_size > 0x7fffffff || request->m_offset > st.st_size )
+	{
+		close(fd);
+		complete(request, AsyncReadRequest::STATUS_FAILED);
+		return true;
+	}
+
+	int size = (int)st.st_size - request->m_offset;
+	if( request->m_requestedSize >= 0 && request->m_requestedSize < size )
+	{
+		size = request->m_requestedSize;
+	}
+
+	if( size == 0 )
+	{
+		close(fd);
+		complete(request, AsyncReadRequest::STATUS_COMPLETED);
+		return true;
+	}
+
+	request->m_buffer.resize(size);
+	request->m_size = size;
+	request->m_fd = fd;
+	request->m_bytesDone = 0;
+	m_uring->inFlight.push_back(request);
+	if( request->m_priority == PRIORITY_PREFETCH )
+	{
+		++m_uring->numPrefetchInFlight;
+	}
+
+	uringSubmitRead(m_uring, request, fd, &request->m_buffer[0], size, request->m_offset);
+	return true;
+#else
+	(void)request;
+	return false;
+#endif
+}
+
+void AsyncFileReader::uringThread()
+{
+#if ENGINE_IO_URING
+	IoUring* ring = m_uring;
+	uringArmEvent(ring);
+
+	for( ;; )
+	{
+		// Start queued requests until the ring is full.
+		bool quit;
+		for( ;; )
+		{
+			Ref<AsyncReadRequest> request;
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				quit = m_quit;
+				if( !quit && (int)ring->inFlight.size() < m_maxInFlight )
+				{
+					request = popRequest(ring->numPrefetchInFlight < m_maxInFlight / 2);
+				}
+			}
+
+			if( request == 0 )
+			{
+				break;
+			}
+
+			if( !startUring(request.ptr()) )
+			{
+				readBlocking(request.ptr());
+			}
+		}
+
+		if( quit && ring->inFlight.empty() )
+		{
+			return;
+		}
+
+		int res = (int)syscall(__NR_io_uring_enter, ring->ringFd, ring->numToSubmit, 1, IORING_ENTER_GETEVENTS, 0, 0);
+		if( res < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY )
+		{
+			assert( 0 ); // io_uring_enter failed
+			return;
+		}
+
+		if( res > 0 )
+		{
+			ring->numToSubmit -= res;
+		}
+
+		// Reap completions.
+		unsigned head = *ring->cqHead;
+		const unsigned tail = __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE);
+		for( ; head != tail; ++head )
+		{
+			const io_uring_cqe cqe = ring->cqes[head & *ring->cqMask];
+			if( cqe.user_data == EVENT_USER_DATA )
+			{
+				uint64_t value;
+				ssize_t n = ::read(ring->eventFd, &value, sizeof(value));
+				(void)n;
+				uringArmEvent(ring);
+				continue;
+			}
+
+			AsyncReadRequest* request = (AsyncReadRequest*)(uintptr_t)cqe.user_data;
+			const int remaining = request->m_size - request->m_bytesDone;
+			if( cqe.res == -EINTR || cqe.res == -EAGAIN )
+			{
+				uringSubmitRead(ring, request, request->m_fd, &request->m_buffer[request->m_bytesDone],
+					remaining, request->m_offset + request->m_bytesDone);
+				continue;
+			}
+
+			if( cqe.res > 0 && cqe.res < remaining )
+			{
+				// Short read, continue from where it ended.
+				request->m_bytesDone += cqe.res;
+				uringSubmitRead(ring, request, request->m_fd, &request->m_buffer[request->m_bytesDone],
+					remaining - cqe.res, request->m_offset + request->m_bytesDone);
+				continue;
+			}
+
+			AsyncReadRequest::Status status = AsyncReadRequest::STATUS_COMPLETED;
+			if( cqe.res < 0 )
+			{
+				status = AsyncReadRequest::STATUS_FAILED;
+			}
+			else if( cqe.res == 0 )
+			{
+				// File was truncated after it was opened.
+				request->m_size = request->m_bytesDone;
+				request->m_buffer.resize(request->m_size);
+			}
+
+			close(request->m_fd);
+			request->m_fd = -1;
+			if( request->m_priority == PRIORITY_PREFETCH )
+			{
+				--ring->numPrefetchInFlight;
+			}
+
+			// Keep the request alive until it is completed.
+			Ref<AsyncReadRequest> ref = request;
+			for( size_t i = 0; i < ring->inFlight.size(); ++i )
+			{
+				if( ring->inFlight[i].ptr() == request )
+				{
+					ring->inFlight[i] = ring->inFlight.back();
+					ring->inFlight.pop_back();
+					break;
+				}
+			}
+
+			complete(request, status);
+		}
+
+		__atomic_store_n(ring->cqHead, head, __ATOMIC_RELEASE);
+	}
+#endif
+}
+
+}
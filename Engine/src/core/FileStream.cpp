@@ -23,6 +23,10 @@
 #include <es_assert.h>
 #include <string.h>
 
+#if defined(_WIN32)
+#include <Windows.h>
+#endif
+
 #if defined(ANDROID)
 #include <android/sensor.h>
 #include <android/log.h>
@@ -40,9 +44,16 @@ namespace core
 	}
 
 #if defined(_WIN32)
-FileStream::FileStream( const char* const fileName, FileOpenMode mode )
+FileStream::FileStream( const char* const fileName, FileOpenMode mode, int readAheadSize )
 : Stream()
+, m_file(0)
 , m_mode(mode)
+, m_size(0)
+, m_position(0)
+, m_filePosition(0)
+, m_buffer(mode == READ_ONLY ? readAheadSize : 0)
+, m_bufferStart(0)
+, m_bufferLength(0)
 {
 	if( m_mode == READ_ONLY )
 	{
@@ -61,6 +72,21 @@ FileStream::FileStream( const char* const fileName, FileOpenMode mode )
 	{
 		printf("[%s] File %s could not be opened", __FUNCTION__, fileName);
 		assert( m_file != 0 );
+		return;
+	}
+
+	if( m_mode == READ_ONLY )
+	{
+		fseek(m_file, 0, SEEK_END);
+		m_size = (int)ftell(m_file);
+		assert( m_size >= 0 );
+		fseek(m_file, 0, SEEK_SET);
+
+		// Reads are buffered by the stream itself.
+		if( !m_buffer.empty() )
+		{
+			setvbuf(m_file, 0, _IONBF, 0);
+		}
 	}
 }
 	
@@ -75,47 +101,58 @@ FileStream::~FileStream( )
 void FileStream::write( const void* p, int n )
 {
 	assert( m_mode == READ_WRITE );
+	if( m_filePosition != m_position )
+	{
+		seekFile(m_position);
+	}
+
 	size_t s = fwrite(p, 1, n, m_file);
 	assert( s == size_t(n) );
+	m_position += (int)s;
+	m_filePosition = m_position;
+	if( m_position > m_size )
+	{
+		m_size = m_position;
+	}
 }
 
-int FileStream::read( void* p, int n )
+int FileStream::readFile( void* p, int n )
 {
-	assert( m_mode == READ_ONLY || m_mode == READ_WRITE );
-	assert(available() >= n );
-	size_t s = fread(p, 1, n, m_file);
-	assert( s == size_t(n) );
-	return n;
+	return (int)fread(p, 1, n, m_file);
 }
 
-int	FileStream::available() const
+void FileStream::seekFile( int position )
 {
-	long current = ftell(m_file);
-	assert(current >= 0);
-	fseek(m_file, 0, SEEK_END);
-	long end = ftell(m_file);
-	assert(end >= 0);
-	fseek(m_file, current, SEEK_SET);
-	int res = end-current;
-	assert(res >= 0);
-	return res;
+	fseek(m_file, position, SEEK_SET);
+	m_filePosition = position;
 }
 
 int	FileStream::error() const
 {
 	return ::ferror(m_file);
 }
+
+bool FileStream::exists( const char* const fileName )
+{
+	DWORD attributes = GetFileAttributesA(fileName);
+	return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY) == 0;
+}
 #endif
 
 #if defined(ANDROID)
-FileStream::FileStream( const char* const fileName, FileOpenMode mode )
+FileStream::FileStream( const char* const fileName, FileOpenMode mode, int readAheadSize )
 : Stream()
+, m_file(0)
 , m_mode(mode)
+, m_size(0)
+, m_position(0)
+, m_filePosition(0)
+, m_buffer(readAheadSize)
+, m_bufferStart(0)
+, m_bufferLength(0)
 {
 	if( m_mode == READ_ONLY )
 	{
-		const int BUFFER_SIZE=255;
-		char buffer[BUFFER_SIZE];
 		AAssetManager* assetManager = g_androidState->activity->assetManager;
 		m_file = AAssetManager_open(assetManager, fileName, AASSET_MODE_BUFFER);
 	}
@@ -128,9 +165,10 @@ FileStream::FileStream( const char* const fileName, FileOpenMode mode )
 	{
 		LOG_ERROR("[%s] File %s could not be opened", __FUNCTION__, fileName);
 		assert( m_file != 0 );
+		return;
 	}
 
-	m_available = AAsset_getLength(m_file);
+	m_size = (int)AAsset_getLength(m_file);
 }
 	
 FileStream::~FileStream( )
@@ -148,20 +186,16 @@ void FileStream::write( const void* p, int n )
 	(void)n;
 }
 
-int FileStream::read( void* p, int n )
+int FileStream::readFile( void* p, int n )
 {
-	assert( m_mode == READ_ONLY );
-	assert(available() >= n );
-
-	long s = AAsset_read (m_file,p,n);
-	assert( s == n );
-	m_available -= n;
-	return n;
+	int s = AAsset_read(m_file, p, n);
+	return s > 0 ? s : 0;
 }
 
-int	FileStream::available() const
+void FileStream::seekFile( int position )
 {
-	return m_available;
+	AAsset_seek(m_file, position, SEEK_SET);
+	m_filePosition = position;
 }
 
 int	FileStream::error() const
@@ -169,7 +203,111 @@ int	FileStream::error() const
 	return 0;
 }
 
+bool FileStream::exists( const char* const fileName )
+{
+	AAssetManager* assetManager = g_androidState->activity->assetManager;
+	AAsset* asset = AAssetManager_open(assetManager, fileName, AASSET_MODE_UNKNOWN);
+	if( asset == 0 )
+	{
+		return false;
+	}
+
+	AAsset_close(asset);
+	return true;
+}
+
 #endif
+
+int FileStream::read( void* p, int n )
+{
+	assert( m_mode == READ_ONLY || m_mode == READ_WRITE );
+	assert( available() >= n );
+
+	uint8_t* dst = (uint8_t*)p;
+	int total = 0;
+	while( total < n )
+	{
+		// Serve from read-ahead buffer, if current position is in it.
+		int offset = m_position - m_bufferStart;
+		if( offset >= 0 && offset < m_bufferLength )
+		{
+			int count = m_bufferLength - offset;
+			if( count > n - total )
+			{
+				count = n - total;
+			}
+
+			memcpy(dst + total, &m_buffer[offset], count);
+			total += count;
+			m_position += count;
+			continue;
+		}
+
+		if( m_filePosition != m_position )
+		{
+			seekFile(m_position);
+		}
+
+		// Large reads go straight to destination.
+		if( n - total >= (int)m_buffer.size() )
+		{
+			int s = readFile(dst + total, n - total);
+			total += s;
+			m_position += s;
+			m_filePosition = m_position;
+			break;
+		}
+
+		m_bufferStart = m_position;
+		m_bufferLength = readFile(&m_buffer[0], (int)m_buffer.size());
+		m_filePosition = m_position + m_bufferLength;
+		if( m_bufferLength == 0 )
+		{
+			break;
+		}
+	}
+
+	assert( total == n );
+	return total;
+}
+
+int	FileStream::available() const
+{
+	return m_size - m_position;
+}
+
+bool FileStream::seek( int offset, SeekOrigin origin )
+{
+	int position = offset;
+	if( origin == ORIGIN_CURRENT )
+	{
+		position += m_position;
+	}
+	else if( origin == ORIGIN_END )
+	{
+		position += m_size;
+	}
+
+	if( position < 0 || position > m_size )
+	{
+		return false;
+	}
+
+	// File itself is moved lazily on next read or write, buffer stays valid.
+	m_position = position;
+	return true;
+}
+
+int FileStream::tell() const
+{
+	return m_position;
+}
+
+int FileStream::size() const
+{
+	return m_size;
+}
+
 }
 
 
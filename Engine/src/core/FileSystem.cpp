@@ -0,0 +1,184 @@
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Copyright (c) 2013 Mikko Romppainen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in the
+// Software without restriction, including without limitation the rights to use, copy,
+// modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+#include <core/FileSystem.h>
+#include <core/PackFile.h>
+#include <core/FileStream.h>
+#include <core/MappedFileStream.h>
+#include <core/MemoryStream.h>
+#include <core/Ref.h>
+#include <mutex>
+#include <vector>
+
+namespace core
+{
+
+// anonymous namespace for internal functions
+namespace
+{
+	std::mutex mountMutex;
+	std::vector< Ref<PackFile> > mountedPacks;
+	bool looseFileOverrides = false;
+
+	// Copy of mounted packs, so that packs are searched without holding the lock.
+	std::vector< Ref<PackFile> > getPacks()
+	{
+		std::lock_guard<std::mutex> lock(mountMutex);
+		return mountedPacks;
+	}
+
+	Stream* openLooseFile( const char* const fileName )
+	{
+		if( !FileStream::exists(fileName) )
+		{
+			return 0;
+		}
+
+		return new MappedFileStream(fileName);
+	}
+}
+
+bool FileSystem::mountPack( const char* const fileName )
+{
+	Ref<PackFile> pack = new PackFile(fileName);
+	if( !pack->isValid() )
+	{
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(mountMutex);
+	mountedPacks.insert(mountedPacks.begin(), pack);
+	return true;
+}
+
+void FileSystem::unmountAll()
+{
+	std::lock_guard<std::mutex> lock(mountMutex);
+	mountedPacks.clear();
+}
+
+void FileSystem::setLooseFileOverrides( bool enabled )
+{
+	std::lock_guard<std::mutex> lock(mountMutex);
+	looseFileOverrides = enabled;
+}
+
+Stream* FileSystem::openFile( const char* const fileName )
+{
+	bool overrides;
+	{
+		std::lock_guard<std::mutex> lock(mountMutex);
+		overrides = looseFileOverrides;
+	}
+
+	if( overrides )
+	{
+		Stream* stream = openLooseFile(fileName);
+		if( stream != 0 )
+		{
+			return stream;
+		}
+	}
+
+	std::vector< Ref<PackFile> > packs = getPacks();
+	for( size_t i = 0; i < packs.size(); ++i )
+	{
+		Stream* stream = packs[i]->open(fileName);
+		if( stream != 0 )
+		{
+			return stream;
+		}
+	}
+
+	return overrides ? 0 : openLooseFile(fileName);
+}
+
+Stream* FileSystem::openFileInMemory( const char* const fileName )
+{
+	Stream* stream = openFile(fileName);
+	if( stream == 0 || stream->data() != 0 )
+	{
+		return stream;
+	}
+
+	Ref<Stream> file = stream;
+	const int size = file->size();
+	MemoryStream* memory = new MemoryStream(size);
+	int numRead = 0;
+	while( numRead < size )
+	{
+		int n = file->read(memory->getBuffer() + numRead, size - numRead);
+		if( n <= 0 )
+		{
+			break;
+		}
+		numRead += n;
+	}
+
+	if( numRead != size )
+	{
+		delete memory;
+		return 0;
+	}
+
+	return memory;
+}
+
+bool FileSystem::exists( const char* const fileName )
+{
+	std::vector< Ref<PackFile> > packs = getPacks();
+	for( size_t i = 0; i < packs.size(); ++i )
+	{
+		if( packs[i]->contains(fileName) )
+		{
+			return true;
+		}
+	}
+
+	return FileStream::exists(fileName);
+}
+
+bool FileSystem::isPacked( const char* const fileName )
+{
+	bool overrides;
+	{
+		std::lock_guard<std::mutex> lock(mountMutex);
+		overrides = looseFileOverrides;
+	}
+
+	std::vector< Ref<PackFile> > packs = getPacks();
+	if( packs.empty() || (overrides && FileStream::exists(fileName)) )
+	{
+		return false;
+	}
+
+	for( size_t i = 0; i < packs.size(); ++i )
+	{
+		if( packs[i]->contains(fileName) )
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+}
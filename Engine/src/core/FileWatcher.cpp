@@ -0,0 +1,303 @@
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Copyright (c) 2013 Mikko Romppainen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in the
+// Software without restriction, including without limitation the rights to use, copy,
+// modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+#include <core/FileWatcher.h>
+#include <es_assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+#if defined(_WIN32)
+#include <Windows.h>
+#else
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+namespace core
+{
+
+// anonymous namespace for internal functions
+namespace
+{
+	void splitPath(const std::string& fileName, std::string* dir, std::string* name)
+	{
+		size_t pos = fileName.find_last_of("/\\");
+		if( pos == std::string::npos )
+		{
+			*dir = ".";
+			*name = fileName;
+		}
+		else
+		{
+			*dir = fileName.substr(0, pos);
+			*name = fileName.substr(pos+1);
+		}
+	}
+
+	void addUnique(std::vector<std::string>& v, const std::string& s)
+	{
+		if( std::find(v.begin(), v.end(), s) == v.end() )
+		{
+			v.push_back(s);
+		}
+	}
+
+#if defined(_WIN32)
+	long long getWriteTime(const std::string& fileName)
+	{
+		WIN32_FILE_ATTRIBUTE_DATA data;
+		if( !GetFileAttributesExA(fileName.c_str(), GetFileExInfoStandard, &data) )
+		{
+			return 0;
+		}
+
+		return ((long long)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime;
+	}
+#endif
+}
+
+
+FileWatcher::WatchedDirectory* FileWatcher::findDirectory(const std::string& path)
+{
+	for( size_t i = 0; i < m_directories.size(); ++i )
+	{
+		if( m_directories[i]->path == path )
+		{
+			return m_directories[i];
+		}
+	}
+
+	return 0;
+}
+
+void FileWatcher::fileChanged(WatchedDirectory* dir, const char* const name, std::vector<std::string>& changedFiles)
+{
+	for( size_t i = 0; i < dir->files.size(); ++i )
+	{
+		if( dir->files[i] == name )
+		{
+			addUnique(changedFiles, dir->fullNames[i]);
+		}
+	}
+}
+
+#if defined(_WIN32)
+FileWatcher::FileWatcher()
+: Object()
+{
+}
+
+FileWatcher::~FileWatcher()
+{
+	for( size_t i = 0; i < m_directories.size(); ++i )
+	{
+		FindCloseChangeNotification((HANDLE)m_directories[i]->handle);
+		delete m_directories[i];
+	}
+}
+
+bool FileWatcher::addFile(const char* const fileName)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	std::string dirName, name;
+	splitPath(fileName, &dirName, &name);
+
+	WatchedDirectory* dir = findDirectory(dirName);
+	if( dir == 0 )
+	{
+		// WaitForMultipleObjects can wait at most MAXIMUM_WAIT_OBJECTS handles.
+		if( m_directories.size() >= MAXIMUM_WAIT_OBJECTS )
+		{
+			printf("[%s] Too many watched directories\n", __FUNCTION__);
+			return false;
+		}
+
+		HANDLE h = FindFirstChangeNotificationA(dirName.c_str(), FALSE,
+			FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME);
+		if( h == INVALID_HANDLE_VALUE )
+		{
+			printf("[%s] Can not watch directory %s\n", __FUNCTION__, dirName.c_str());
+			return false;
+		}
+
+		dir = new WatchedDirectory();
+		dir->path = dirName;
+		dir->handle = h;
+		m_directories.push_back(dir);
+	}
+
+	dir->files.push_back(name);
+	dir->fullNames.push_back(fileName);
+	dir->writeTimes.push_back(getWriteTime(fileName));
+	return true;
+}
+
+void FileWatcher::poll(std::vector<std::string>& changedFiles, int timeoutMs)
+{
+	HANDLE handles[MAXIMUM_WAIT_OBJECTS];
+	DWORD count = 0;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for( size_t i = 0; i < m_directories.size(); ++i )
+		{
+			handles[count++] = (HANDLE)m_directories[i]->handle;
+		}
+	}
+
+	if( count == 0 )
+	{
+		Sleep(timeoutMs);
+		return;
+	}
+
+	DWORD res = WaitForMultipleObjects(count, handles, FALSE, timeoutMs);
+	if( res < WAIT_OBJECT_0 || res >= WAIT_OBJECT_0 + count )
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	WatchedDirectory* dir = m_directories[res - WAIT_OBJECT_0];
+	FindNextChangeNotification((HANDLE)dir->handle);
+
+	// Notification tells only that something changed in directory. Find out which files.
+	for( size_t i = 0; i < dir->files.size(); ++i )
+	{
+		long long t = getWriteTime(dir->fullNames[i]);
+		if( t != 0 && t != dir->writeTimes[i] )
+		{
+			dir->writeTimes[i] = t;
+			fileChanged(dir, dir->files[i].c_str(), changedFiles);
+		}
+	}
+}
+#else
+FileWatcher::FileWatcher()
+: Object()
+, m_fd(-1)
+{
+	m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if( m_fd < 0 )
+	{
+		printf("[%s] inotify_init1 failed: %s\n", __FUNCTION__, strerror(errno));
+	}
+}
+
+FileWatcher::~FileWatcher()
+{
+	for( size_t i = 0; i < m_directories.size(); ++i )
+	{
+		delete m_directories[i];
+	}
+
+	if( m_fd >= 0 )
+	{
+		close(m_fd);
+	}
+}
+
+bool FileWatcher::addFile(const char* const fileName)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if( m_fd < 0 )
+	{
+		return false;
+	}
+
+	std::string dirName, name;
+	splitPath(fileName, &dirName, &name);
+
+	WatchedDirectory* dir = findDirectory(dirName);
+	if( dir == 0 )
+	{
+		// IN_MOVED_TO catches editors, which save by renaming temporary file over the original.
+		int wd = inotify_add_watch(m_fd, dirName.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+		if( wd < 0 )
+		{
+			printf("[%s] Can not watch directory %s: %s\n", __FUNCTION__, dirName.c_str(), strerror(errno));
+			return false;
+		}
+
+		dir = new WatchedDirectory();
+		dir->path = dirName;
+		dir->wd = wd;
+		m_directories.push_back(dir);
+	}
+
+	dir->files.push_back(name);
+	dir->fullNames.push_back(fileName);
+	return true;
+}
+
+void FileWatcher::poll(std::vector<std::string>& changedFiles, int timeoutMs)
+{
+	if( m_fd < 0 )
+	{
+		usleep(timeoutMs*1000);
+		return;
+	}
+
+	pollfd pfd;
+	pfd.fd = m_fd;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+	if( ::poll(&pfd, 1, timeoutMs) <= 0 )
+	{
+		return;
+	}
+
+	// Buffer must be aligned for inotify_event.
+	long long buffer[4096/sizeof(long long)];
+	for( ;; )
+	{
+		ssize_t len = read(m_fd, buffer, sizeof(buffer));
+		if( len <= 0 )
+		{
+			break;
+		}
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		const char* p = (const char*)buffer;
+		while( p < (const char*)buffer + len )
+		{
+			const inotify_event* e = (const inotify_event*)p;
+			if( e->len > 0 )
+			{
+				for( size_t i = 0; i < m_directories.size(); ++i )
+				{
+					if( m_directories[i]->wd == e->wd )
+					{
+						fileChanged(m_directories[i], e->name, changedFiles);
+					}
+				}
+			}
+
+			p += sizeof(inotify_event) + e->len;
+		}
+	}
+}
+#endif
+
+}
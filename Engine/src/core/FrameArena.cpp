@@ -0,0 +1,143 @@
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Copyright (c) 2013 Mikko Romppainen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in the
+// Software without restriction, including without limitation the rights to use, copy,
+// modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+#include <core/FrameArena.h>
+#include <es_assert.h>
+#include <stdio.h>
+
+namespace core
+{
+
+FrameArena::FrameArena( size_t bytesPerFrame, int numFrames, Allocator* alloc )
+: Object()
+, m_alloc(alloc ? alloc : getDefaultAllocator())
+, m_capacity(bytesPerFrame)
+, m_current(0)
+, m_offset(0)
+, m_overflowBytes(0)
+, m_peak(0)
+, m_overflowWarned(false)
+{
+	assert( numFrames >= 1 );
+	m_frames.resize(numFrames);
+	for( int i = 0; i < numFrames; ++i )
+	{
+		m_frames[i].buffer = (uint8_t*)engineAllocMem(m_alloc, m_capacity, 64);
+		assert( m_frames[i].buffer != 0 );
+	}
+}
+
+FrameArena::~FrameArena()
+{
+	for( size_t i = 0; i < m_frames.size(); ++i )
+	{
+		for( size_t j = 0; j < m_frames[i].overflow.size(); ++j )
+		{
+			engineFreeMem(m_alloc, m_frames[i].overflow[j]);
+		}
+
+		engineFreeMem(m_alloc, m_frames[i].buffer);
+	}
+}
+
+void* FrameArena::allocate( size_t size, size_t alignment )
+{
+	assert( (alignment & (alignment - 1)) == 0 );
+	Frame& frame = m_frames[m_current];
+
+	// Buffer is aligned to 64, so aligning the offset aligns the pointer.
+	size_t offset = m_offset.load(std::memory_order_relaxed);
+	for( ;; )
+	{
+		const size_t aligned = (offset + alignment - 1) & ~(alignment - 1);
+		const size_t end = aligned + size;
+		if( end > m_capacity )
+		{
+			break;
+		}
+
+		if( m_offset.compare_exchange_weak(offset, end, std::memory_order_relaxed) )
+		{
+			return frame.buffer + aligned;
+		}
+	}
+
+	// Frame buffer is full. Use backing allocator until nextFrame.
+	void* p = engineAllocMem(m_alloc, size, alignment);
+	assert( p != 0 );
+	m_overflowBytes.fetch_add(size, std::memory_order_relaxed);
+
+	std::lock_guard<std::mutex> lock(m_overflowMutex);
+	frame.overflow.push_back(p);
+	return p;
+}
+
+void FrameArena::nextFrame()
+{
+	const size_t used = getUsedBytes();
+	if( used > m_peak )
+	{
+		m_peak = used;
+	}
+
+	// Warned once. getOverflowBytes and getPeakBytes report ongoing overflows.
+	if( m_overflowBytes.load(std::memory_order_relaxed) > 0 && !m_overflowWarned )
+	{
+		m_overflowWarned = true;
+		printf("[%s] Frame used %u bytes, arena has %u. Consider a larger arena.\n", __FUNCTION__,
+			(unsigned)used, (unsigned)m_capacity);
+	}
+
+	m_current = (m_current + 1) % (int)m_frames.size();
+
+	// Memory of this buffer was allocated numFrames frames ago and is not used anymore.
+	Frame& frame = m_frames[m_current];
+	for( size_t i = 0; i < frame.overflow.size(); ++i )
+	{
+		engineFreeMem(m_alloc, frame.overflow[i]);
+	}
+	frame.overflow.clear();
+
+	m_offset.store(0, std::memory_order_relaxed);
+	m_overflowBytes.store(0, std::memory_order_relaxed);
+}
+
+size_t FrameArena::getUsedBytes() const
+{
+	return m_offset.load(std::memory_order_relaxed) + m_overflowBytes.load(std::memory_order_relaxed);
+}
+
+size_t FrameArena::getPeakBytes() const
+{
+	return m_peak;
+}
+
+size_t FrameArena::getCapacity() const
+{
+	return m_capacity;
+}
+
+size_t FrameArena::getOverflowBytes() const
+{
+	return m_overflowBytes.load(std::memory_order_relaxed);
+}
+
+}
@@ -0,0 +1,352 @@
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Copyright (c) 2013 Mikko Romppainen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in the
+// Software without restriction, including without limitation the rights to use, copy,
+// modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+#include <core/JobSystem.h>
+#include <es_assert.h>
+
+namespace core
+{
+
+// anonymous namespace for internal functions
+namespace
+{
+	// Queue of the current thread in the job system owning it. Other threads use the shared queue.
+	thread_local JobSystem* currentSystem = 0;
+	thread_local int currentQueue = -1;
+}
+
+JobCounter::JobCounter()
+: m_count(0)
+{
+}
+
+JobCounter::~JobCounter()
+{
+	assert( isDone() ); // Counter destroyed before its jobs
+}
+
+bool JobCounter::isDone() const
+{
+	// Locked, so that the counter is not destroyed while the last job is still releasing it.
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_count == 0;
+}
+
+JobSystem::JobSystem( int numWorkers )
+: Object()
+, m_mainThread(std::this_thread::get_id())
+, m_numQueued(0)
+, m_numWaiting(0)
+, m_quit(false)
+{
+	if( numWorkers < 0 )
+	{
+		numWorkers = (int)std::thread::hardware_concurrency() - 1;
+		numWorkers = numWorkers > 0 ? numWorkers : 1;
+	}
+
+	for( int i = 0; i <= numWorkers; ++i )
+	{
+		m_queues.push_back(new WorkerQueue());
+	}
+
+	for( int i = 0; i < numWorkers; ++i )
+	{
+		m_threads.push_back(std::thread(&JobSystem::workerThread, this, i));
+	}
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+		m_quit = true;
+	}
+	m_sleepCondition.notify_all();
+
+	for( size_t i = 0; i < m_threads.size(); ++i )
+	{
+		m_threads[i].join();
+	}
+
+	for( size_t i = 0; i < m_queues.size(); ++i )
+	{
+		assert( m_queues[i]->jobs.empty() );
+		delete m_queues[i];
+	}
+}
+
+void JobSystem::run( JobFunction function, void* data, JobCounter* counter )
+{
+	if( counter != 0 )
+	{
+		std::lock_guard<std::mutex> lock(counter->m_mutex);
+		++counter->m_count;
+	}
+
+	Job job = { function, data, counter };
+	push(job);
+}
+
+void JobSystem::runAfter( JobCounter* dependency, JobFunction function, void* data, JobCounter* counter )
+{
+	if( counter != 0 )
+	{
+		std::lock_guard<std::mutex> lock(counter->m_mutex);
+		++counter->m_count;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(dependency->m_mutex);
+		if( dependency->m_count > 0 )
+		{
+			JobCounter::Continuation continuation = { function, data, counter };
+			dependency->m_continuations.push_back(continuation);
+			return;
+		}
+	}
+
+	Job job = { function, data, counter };
+	push(job);
+}
+
+void JobSystem::runOnMainThread( JobFunction function, void* data, JobCounter* counter )
+{
+	if( counter != 0 )
+	{
+		std::lock_guard<std::mutex> lock(counter->m_mutex);
+		++counter->m_count;
+	}
+
+	Job job = { function, data, counter };
+	{
+		std::lock_guard<std::mutex> lock(m_mainThreadMutex);
+		m_mainThreadJobs.push_back(job);
+	}
+
+	// Main thread may be sleeping in wait.
+	bool notify = false;
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+		notify = m_numWaiting > 0;
+	}
+	if( notify )
+	{
+		m_waitCondition.notify_all();
+	}
+}
+
+void JobSystem::runMainThreadJobs()
+{
+	assert( isMainThread() );
+	std::deque<Job> jobs;
+	{
+		std::lock_guard<std::mutex> lock(m_mainThreadMutex);
+		jobs.swap(m_mainThreadJobs);
+	}
+
+	for( size_t i = 0; i < jobs.size(); ++i )
+	{
+		execute(jobs[i]);
+	}
+}
+
+void JobSystem::wait( JobCounter* counter )
+{
+	const bool mainThread = isMainThread();
+	while( !counter->isDone() )
+	{
+		if( mainThread )
+		{
+			runMainThreadJobs();
+		}
+
+		if( tryRunOne() )
+		{
+			continue;
+		}
+
+		// Nothing to run. Sleep until a counter reaches zero or new jobs are queued.
+		std::unique_lock<std::mutex> lock(m_sleepMutex);
+		++m_numWaiting;
+		while( !counter->isDone() && m_numQueued.load() == 0 && !(mainThread && hasMainThreadJobs()) )
+		{
+			m_waitCondition.wait(lock);
+		}
+		--m_numWaiting;
+	}
+}
+
+bool JobSystem::hasMainThreadJobs()
+{
+	std::lock_guard<std::mutex> lock(m_mainThreadMutex);
+	return !m_mainThreadJobs.empty();
+}
+
+int JobSystem::getNumWorkers() const
+{
+	return (int)m_threads.size();
+}
+
+bool JobSystem::isMainThread() const
+{
+	return std::this_thread::get_id() == m_mainThread;
+}
+
+void JobSystem::push( const Job& job )
+{
+	// Counted before it is queued, so the count never goes negative.
+	++m_numQueued;
+	const int index = currentSystem == this ? currentQueue : (int)m_queues.size() - 1;
+	{
+		std::lock_guard<std::mutex> lock(m_queues[index]->mutex);
+		m_queues[index]->jobs.push_back(job);
+	}
+
+	bool notifyWaiters = false;
+	{
+		// Taking the lock makes sure a thread going to sleep sees the new job.
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+		notifyWaiters = m_numWaiting > 0;
+	}
+	m_sleepCondition.notify_one();
+	if( notifyWaiters )
+	{
+		m_waitCondition.notify_all();
+	}
+}
+
+bool JobSystem::tryRunOne()
+{
+	const int numQueues = (int)m_queues.size();
+	const int own = currentSystem == this ? currentQueue : numQueues - 1;
+
+	// Newest job of own queue first. It is most likely still in cache.
+	Job job;
+	bool found = false;
+	{
+		WorkerQueue* queue = m_queues[own];
+		std::lock_guard<std::mutex> lock(queue->mutex);
+		if( !queue->jobs.empty() )
+		{
+			job = queue->jobs.back();
+			queue->jobs.pop_back();
+			found = true;
+		}
+	}
+
+	// Steal oldest job of another queue.
+	for( int i = 1; i < numQueues && !found; ++i )
+	{
+		WorkerQueue* queue = m_queues[(own + i) % numQueues];
+		std::lock_guard<std::mutex> lock(queue->mutex);
+		if( !queue->jobs.empty() )
+		{
+			job = queue->jobs.front();
+			queue->jobs.pop_front();
+			found = true;
+		}
+	}
+
+	if( !found )
+	{
+		return false;
+	}
+
+	--m_numQueued;
+	execute(job);
+	return true;
+}
+
+void JobSystem::execute( const Job& job )
+{
+	job.function(job.data);
+	if( job.counter == 0 )
+	{
+		return;
+	}
+
+	std::vector<JobCounter::Continuation> continuations;
+	bool done = false;
+	{
+		std::lock_guard<std::mutex> lock(job.counter->m_mutex);
+		if( --job.counter->m_count == 0 )
+		{
+			continuations.swap(job.counter->m_continuations);
+			done = true;
+		}
+	}
+
+	// Wake threads waiting for the counter. It is checked by the waiters under m_sleepMutex,
+	// so taking the lock here means the wakeup can not be missed.
+	if( done )
+	{
+		bool notify = false;
+		{
+			std::lock_guard<std::mutex> lock(m_sleepMutex);
+			notify = m_numWaiting > 0;
+		}
+		if( notify )
+		{
+			m_waitCondition.notify_all();
+		}
+	}
+
+	// Counter may be destroyed from here on.
+	for( size_t i = 0; i < continuations.size(); ++i )
+	{
+		Job next = { continuations[i].function, continuations[i].data, continuations[i].counter };
+		push(next);
+	}
+}
+
+void JobSystem::workerThread( int index )
+{
+	currentSystem = this;
+	currentQueue = index;
+
+	for( ;; )
+	{
+		if( tryRunOne() )
+		{
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(m_sleepMutex);
+		while( !m_quit && m_numQueued.load() == 0 )
+		{
+			m_sleepCondition.wait(lock);
+		}
+
+		if( m_quit && m_numQueued.load() == 0 )
+		{
+			return;
+		}
+	}
+}
+
+JobSystem* getJobSystem()
+{
+	static JobSystem jobSystem;
+	return &jobSystem;
+}
+
+}
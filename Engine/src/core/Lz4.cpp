@@ -0,0 +1,256 @@
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Copyright (c) 2013 Mikko Romppainen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in the
+// Software without restriction, including without limitation the rights to use, copy,
+// modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+#include <core/Lz4.h>
+#include <string.h>
+#include <vector>
+
+namespace core
+{
+
+namespace lz4
+{
+
+// anonymous namespace for internal functions
+namespace
+{
+	const int MIN_MATCH = 4;
+	const int LAST_LITERALS = 5;		// Last 5 bytes are always literals
+	const int MATCH_FIND_LIMIT = 12;	// Last match starts at least 12 bytes before the end
+	const int MAX_OFFSET = 65535;
+	const int HASH_BITS = 12;
+
+	uint32_t read32( const uint8_t* p )
+	{
+		uint32_t v;
+		memcpy(&v, p, 4);
+		return v;
+	}
+
+	uint32_t hash( uint32_t v )
+	{
+		return (v * 2654435761U) >> (32 - HASH_BITS);
+	}
+
+	// Writes 255 bytes and remainder of a length, which did not fit to the token.
+	bool writeLength( uint8_t*& op, const uint8_t* oend, int length )
+	{
+		for( ; length >= 255; length -= 255 )
+		{
+			if( op >= oend )
+			{
+				return false;
+			}
+			*op++ = 255;
+		}
+
+		if( op >= oend )
+		{
+			return false;
+		}
+		*op++ = (uint8_t)length;
+		return true;
+	}
+
+	// Reads length continuation bytes.
+	bool readLength( const uint8_t*& ip, const uint8_t* iend, int& length )
+	{
+		uint8_t b;
+		do
+		{
+			if( ip >= iend )
+			{
+				return false;
+			}
+			b = *ip++;
+			length += b;
+		}
+		while( b == 255 );
+		return true;
+	}
+
+	// Writes token, literals and optionally a match. matchLength 0 means last literals.
+	bool writeSequence( uint8_t*& op, const uint8_t* oend, const uint8_t* literals, int numLiterals,
+		int offset, int matchLength )
+	{
+		if( op >= oend )
+		{
+			return false;
+		}
+
+		uint8_t* token = op++;
+		*token = (uint8_t)((numLiterals < 15 ? numLiterals : 15) << 4);
+		if( numLiterals >= 15 && !writeLength(op, oend, numLiterals - 15) )
+		{
+			return false;
+		}
+
+		if( oend - op < numLiterals )
+		{
+			return false;
+		}
+		memcpy(op, literals, numLiterals);
+		op += numLiterals;
+
+		if( matchLength == 0 )
+		{
+			return true;
+		}
+
+		if( oend - op < 2 )
+		{
+			return false;
+		}
+		*op++ = (uint8_t)(offset & 0xff);
+		*op++ = (uint8_t)(offset >> 8);
+
+		int length = matchLength - MIN_MATCH;
+		*token |= (uint8_t)(length < 15 ? length : 15);
+		return length < 15 || writeLength(op, oend, length - 15);
+	}
+}
+
+int compressBound( int srcSize )
+{
+	return srcSize + srcSize / 255 + 16;
+}
+
+int compress( const void* src, int srcSize, void* dst, int dstCapacity )
+{
+	const uint8_t* base = (const uint8_t*)src;
+	uint8_t* op = (uint8_t*)dst;
+	const uint8_t* oend = op + dstCapacity;
+
+	int anchor = 0;
+	if( srcSize > MATCH_FIND_LIMIT )
+	{
+		std::vector<int> table(1 << HASH_BITS, -1);
+		const int matchFindEnd = srcSize - MATCH_FIND_LIMIT;
+		const int matchEnd = srcSize - LAST_LITERALS;
+
+		int ip = 0;
+		while( ip < matchFindEnd )
+		{
+			const uint32_t sequence = read32(base + ip);
+			const uint32_t h = hash(sequence);
+			const int ref = table[h];
+			table[h] = ip;
+
+			if( ref < 0 || ip - ref > MAX_OFFSET || read32(base + ref) != sequence )
+			{
+				++ip;
+				continue;
+			}
+
+			int length = MIN_MATCH;
+			while( ip + length < matchEnd && base[ref + length] == base[ip + length] )
+			{
+				++length;
+			}
+
+			if( !writeSequence(op, oend, base + anchor, ip - anchor, ip - ref, length) )
+			{
+				return 0;
+			}
+
+			ip += length;
+			anchor = ip;
+		}
+	}
+
+	if( !writeSequence(op, oend, base + anchor, srcSize - anchor, 0, 0) )
+	{
+		return 0;
+	}
+
+	return (int)(op - (uint8_t*)dst);
+}
+
+int decompress( const void* src, int srcSize, void* dst, int dstCapacity )
+{
+	const uint8_t* ip = (const uint8_t*)src;
+	const uint8_t* iend = ip + srcSize;
+	uint8_t* op = (uint8_t*)dst;
+	uint8_t* const ostart = op;
+	const uint8_t* oend = op + dstCapacity;
+
+	while( ip < iend )
+	{
+		const uint8_t token = *ip++;
+
+		int numLiterals = token >> 4;
+		if( numLiterals == 15 && !readLength(ip, iend, numLiterals) )
+		{
+			return -1;
+		}
+
+		if( iend - ip < numLiterals || oend - op < numLiterals )
+		{
+			return -1;
+		}
+		memcpy(op, ip, numLiterals);
+		ip += numLiterals;
+		op += numLiterals;
+
+		// Last sequence has only literals.
+		if( ip == iend )
+		{
+			break;
+		}
+
+		if( iend - ip < 2 )
+		{
+			return -1;
+		}
+		const int offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+		if( offset == 0 || offset > op - ostart )
+		{
+			return -1;
+		}
+
+		int length = token & 15;
+		if( length == 15 && !readLength(ip, iend, length) )
+		{
+			return -1;
+		}
+		length += MIN_MATCH;
+
+		if( oend - op < length )
+		{
+			return -1;
+		}
+
+		// Match may overlap the output, copy byte by byte.
+		const uint8_t* match = op - offset;
+		for( int i = 0; i < length; ++i )
+		{
+			op[i] = match[i];
+		}
+		op += length;
+	}
+
+	return (int)(op - ostart);
+}
+
+}
+
+}
@@ -0,0 +1,203 @@
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Copyright (c) 2013 Mikko Romppainen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in the
+// Software without restriction, including without limitation the rights to use, copy,
+// modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+#include <core/MappedFile.h>
+#include <es_assert.h>
+#include <stdio.h>
+
+#if defined(_WIN32)
+#include <Windows.h>
+#elif defined(ANDROID)
+#include <android/asset_manager.h>
+#include <android_native_app_glue.h>
+
+extern struct android_app* g_androidState;
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace core
+{
+
+#if defined(_WIN32)
+MappedFile::MappedFile( const char* const fileName )
+: Object()
+, m_data(0)
+, m_size(0)
+, m_file(INVALID_HANDLE_VALUE)
+, m_mapping(0)
+{
+	m_file = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, 0);
+	if( m_file == INVALID_HANDLE_VALUE )
+	{
+		printf("[%s] File %s could not be opened\n", __FUNCTION__, fileName);
+		return;
+	}
+
+	LARGE_INTEGER size;
+	if( !GetFileSizeEx(m_file, &size) || size.QuadPart == 0 || size.QuadPart > 0x7fffffff )
+	{
+		return;
+	}
+
+	m_mapping = CreateFileMappingA(m_file, 0, PAGE_READONLY, 0, 0, 0);
+	if( m_mapping == 0 )
+	{
+		return;
+	}
+
+	m_data = (const uint8_t*)MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+	if( m_data != 0 )
+	{
+		m_size = (int)size.QuadPart;
+	}
+}
+
+MappedFile::~MappedFile()
+{
+	if( m_data )
+	{
+		UnmapViewOfFile(m_data);
+	}
+
+	if( m_mapping )
+	{
+		CloseHandle(m_mapping);
+	}
+
+	if( m_file != INVALID_HANDLE_VALUE )
+	{
+		CloseHandle(m_file);
+	}
+}
+#elif defined(ANDROID)
+MappedFile::MappedFile( const char* const fileName )
+: Object()
+, m_data(0)
+, m_size(0)
+, m_asset(0)
+{
+	AAssetManager* assetManager = g_androidState->activity->assetManager;
+	m_asset = AAssetManager_open(assetManager, fileName, AASSET_MODE_BUFFER);
+	if( !m_asset )
+	{
+		LOG_ERROR("[%s] File %s could not be opened", __FUNCTION__, fileName);
+		return;
+	}
+
+	// Compressed assets are inflated to memory by the asset manager.
+	m_data = (const uint8_t*)AAsset_getBuffer(m_asset);
+	if( m_data != 0 )
+	{
+		m_size = (int)AAsset_getLength(m_asset);
+	}
+}
+
+MappedFile::~MappedFile()
+{
+	if( m_asset )
+	{
+		AAsset_close(m_asset);
+	}
+}
+#else
+MappedFile::MappedFile( const char* const fileName )
+: Object()
+, m_data(0)
+, m_size(0)
+{
+	int fd = open(fileName, O_RDONLY);
+	if( fd < 0 )
+	{
+		printf("[%s] File %s could not be opened\n", __FUNCTION__, fileName);
+		return;
+	}
+
+	struct stat st;
+	if( fstat(fd, &st) == 0 && st.st_size > 0 && st.st_size <= 0x7fffffff )
+	{
+		void* p = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if( p != MAP_FAILED )
+		{
+			madvise(p, st.st_size, MADV_SEQUENTIAL);
+			m_data = (const uint8_t*)p;
+			m_size = (int)st.st_size;
+		}
+	}
+
+	// Mapping stays valid after the descriptor is closed.
+	close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+	if( m_data )
+	{
+		munmap((void*)m_data, m_size);
+	}
+}
+#endif
+
+bool MappedFile::isValid() const
+{
+	return m_data != 0;
+}
+
+const uint8_t* MappedFile::getData() const
+{
+	return m_data;
+}
+
+int MappedFile::getSize() const
+{
+	return m_size;
+}
+
+void MappedFile::advise( AccessHint hint, int offset, int size ) const
+{
+	if( m_data == 0 || offset < 0 || offset >= m_size )
+	{
+		return;
+	}
+
+	if( size < 0 || size > m_size - offset )
+	{
+		size = m_size - offset;
+	}
+
+#if !defined(_WIN32) && !defined(ANDROID)
+	static const int advice[] = { MADV_NORMAL, MADV_SEQUENTIAL, MADV_RANDOM, MADV_WILLNEED };
+
+	// madvise wants page aligned start address.
+	const uintptr_t pageMask = (uintptr_t)sysconf(_SC_PAGESIZE) - 1;
+	uintptr_t begin = (uintptr_t)(m_data + offset);
+	uintptr_t alignedBegin = begin & ~pageMask;
+	madvise((void*)alignedBegin, size + (begin - alignedBegin), advice[hint]);
+#else
+	(void)hint;
+#endif
+}
+
+}
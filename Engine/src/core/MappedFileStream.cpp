@@ -0,0 +1,126 @@
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Copyright (c) 2013 Mikko Romppainen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in the
+// Software without restriction, including without limitation the rights to use, copy,
+// modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+#include <core/MappedFileStream.h>
+#include <es_assert.h>
+#include <string.h>
+
+namespace core
+{
+
+MappedFileStream::MappedFileStream( const char* const fileName, MappedFile::AccessHint hint )
+: Stream()
+, m_file(new MappedFile(fileName))
+, m_fallback(0)
+, m_position(0)
+{
+	if( m_file->isValid() )
+	{
+		m_file->advise(hint);
+	}
+	else
+	{
+		m_file = 0;
+		m_fallback = new FileStream(fileName, FileStream::READ_ONLY);
+	}
+}
+
+MappedFileStream::~MappedFileStream()
+{
+}
+
+void MappedFileStream::write( const void* p, int n )
+{
+	assert( 0 ); // Stream is read only
+	(void)p;
+	(void)n;
+}
+
+int MappedFileStream::read( void* p, int n )
+{
+	if( m_fallback != 0 )
+	{
+		return m_fallback->read(p, n);
+	}
+
+	assert( available() >= n );
+	if( n > available() )
+	{
+		n = available();
+	}
+
+	memcpy(p, m_file->getData() + m_position, n);
+	m_position += n;
+	return n;
+}
+
+int	MappedFileStream::available() const
+{
+	return m_fallback != 0 ? m_fallback->available() : m_file->getSize() - m_position;
+}
+
+bool MappedFileStream::seek( int offset, SeekOrigin origin )
+{
+	if( m_fallback != 0 )
+	{
+		return m_fallback->seek(offset, origin);
+	}
+
+	int position = offset;
+	if( origin == ORIGIN_CURRENT )
+	{
+		position += m_position;
+	}
+	else if( origin == ORIGIN_END )
+	{
+		position += m_file->getSize();
+	}
+
+	if( position < 0 || position > m_file->getSize() )
+	{
+		return false;
+	}
+
+	m_position = position;
+	return true;
+}
+
+int MappedFileStream::tell() const
+{
+	return m_fallback != 0 ? m_fallback->tell() : m_position;
+}
+
+int MappedFileStream::size() const
+{
+	return m_fallback != 0 ? m_fallback->size() : m_file->getSize();
+}
+
+const uint8_t* MappedFileStream::data() const
+{
+	return m_file != 0 ? m_file->getData() : 0;
+}
+
+bool MappedFileStream::isMapped() const
+{
+	return m_file != 0;
+}
+
+}
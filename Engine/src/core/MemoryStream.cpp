@@ -0,0 +1,137 @@
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Copyright (c) 2013 Mikko Romppainen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in the
+// Software without restriction, including without limitation the rights to use, copy,
+// modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+#include <core/MemoryStream.h>
+#include <es_assert.h>
+#include <string.h>
+
+namespace core
+{
+
+MemoryStream::MemoryStream( int size )
+: Stream()
+, m_buffer(size)
+, m_data(size > 0 ? &m_buffer[0] : 0)
+, m_size(size)
+, m_position(0)
+, m_owner(0)
+{
+}
+
+MemoryStream::MemoryStream( const void* data, int size, Object* owner )
+: Stream()
+, m_buffer()
+, m_data((const uint8_t*)data)
+, m_size(size)
+, m_position(0)
+, m_owner(owner)
+{
+}
+
+MemoryStream::~MemoryStream()
+{
+}
+
+void MemoryStream::write( const void* p, int n )
+{
+	assert( m_data == 0 || m_buffer.size() > 0 ); // Read only view
+	if( m_position + n > (int)m_buffer.size() )
+	{
+		m_buffer.resize(m_position + n);
+	}
+
+	if( n > 0 )
+	{
+		memcpy(&m_buffer[m_position], p, n);
+	}
+
+	m_data = m_buffer.empty() ? 0 : &m_buffer[0];
+	m_position += n;
+	if( m_position > m_size )
+	{
+		m_size = m_position;
+	}
+}
+
+int MemoryStream::read( void* p, int n )
+{
+	assert( available() >= n );
+	if( n > available() )
+	{
+		n = available();
+	}
+
+	if( n > 0 )
+	{
+		memcpy(p, m_data + m_position, n);
+	}
+
+	m_position += n;
+	return n;
+}
+
+int	MemoryStream::available() const
+{
+	return m_size - m_position;
+}
+
+bool MemoryStream::seek( int offset, SeekOrigin origin )
+{
+	int position = offset;
+	if( origin == ORIGIN_CURRENT )
+	{
+		position += m_position;
+	}
+	else if( origin == ORIGIN_END )
+	{
+		position += m_size;
+	}
+
+	if( position < 0 || position > m_size )
+	{
+		return false;
+	}
+
+	m_position = position;
+	return true;
+}
+
+int MemoryStream::tell() const
+{
+	return m_position;
+}
+
+int MemoryStream::size() const
+{
+	return m_size;
+}
+
+const uint8_t* MemoryStream::data() const
+{
+	return m_data;
+}
+
+uint8_t* MemoryStream::getBuffer()
+{
+	return m_buffer.empty() ? 0 : &m_buffer[0];
+}
+
+}
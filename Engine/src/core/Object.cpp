@@ -45,6 +45,14 @@ namespace core
 
 Object::Object()
 : m_numOfRefs(0)
+, m_singleThread(false)
+{
+    refs.add(this,"");
+}
+
+Object::Object(RefCountMode mode)
+: m_numOfRefs(0)
+, m_singleThread(mode == REFCOUNT_SINGLE_THREAD)
 {
     refs.add(this,"");
 }
@@ -52,9 +60,9 @@ Object::Object()
 Object::~Object()
 {
     refs.release(this);
-    if( this->m_numOfRefs != 0 )
+    if( getRefCount() != 0 )
     {
-        assert( this->m_numOfRefs == 0 ); // "Can not delete Object, when it have references some where else";
+        assert( getRefCount() == 0 ); // "Can not delete Object, when it have references some where else";
     }
 }
 
@@ -0,0 +1,401 @@
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Copyright (c) 2013 Mikko Romppainen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in the
+// Software without restriction, including without limitation the rights to use, copy,
+// modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+#include <core/PackFile.h>
+#include <core/MemoryStream.h>
+#include <core/Lz4.h>
+#include <es_assert.h>
+#include <string.h>
+#include <stdio.h>
+#include <algorithm>
+
+namespace core
+{
+
+// anonymous namespace for internal functions
+namespace
+{
+	// Pack names are lower case with forward slashes.
+	char normalizeChar( char c )
+	{
+		if( c == '\\' )
+		{
+			return '/';
+		}
+
+		return (c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : c;
+	}
+
+	const char* skipCurrentDir( const char* name )
+	{
+		while( name[0] == '.' && (name[1] == '/' || name[1] == '\\') )
+		{
+			name += 2;
+		}
+
+		return name;
+	}
+
+	bool namesEqual( const char* packName, const char* fileName )
+	{
+		fileName = skipCurrentDir(fileName);
+		for( ; *packName != 0 && *fileName != 0; ++packName, ++fileName )
+		{
+			if( *packName != normalizeChar(*fileName) )
+			{
+				return false;
+			}
+		}
+
+		return *packName == *fileName;
+	}
+
+	int alignUp( int value, int alignment )
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	void writePadding( Stream* stream, int& position, int alignment )
+	{
+		static const uint8_t zeros[16] = { 0 };
+		int padding = alignUp(position, alignment) - position;
+		position += padding;
+		for( ; padding > 0; padding -= 16 )
+		{
+			stream->write(zeros, padding < 16 ? padding : 16);
+		}
+	}
+}
+
+PackFile::PackFile( const char* const fileName )
+: Object()
+, m_file(new MappedFile(fileName))
+, m_header(0)
+, m_entries(0)
+{
+	if( !m_file->isValid() || m_file->getSize() < (int)sizeof(PackHeader) )
+	{
+		return;
+	}
+
+	const PackHeader* header = (const PackHeader*)m_file->getData();
+	if( header->magic != MAGIC || header->version != VERSION ||
+		header->numEntries > (m_file->getSize() - sizeof(PackHeader)) / sizeof(PackEntry) )
+	{
+		printf("[%s] %s is not a valid pack file\n", __FUNCTION__, fileName);
+		return;
+	}
+
+	// Entries are looked up in random order.
+	m_file->advise(MappedFile::ACCESS_RANDOM);
+	m_header = header;
+	m_entries = (const PackEntry*)(header + 1);
+}
+
+PackFile::~PackFile()
+{
+}
+
+bool PackFile::isValid() const
+{
+	return m_header != 0;
+}
+
+bool PackFile::contains( const char* const fileName ) const
+{
+	return findEntry(fileName) != 0;
+}
+
+Stream* PackFile::open( const char* const fileName ) const
+{
+	const PackEntry* entry = findEntry(fileName);
+	if( entry == 0 )
+	{
+		return 0;
+	}
+
+	if( (uint64_t)entry->dataOffset + entry->storedSize > (uint64_t)m_file->getSize() ||
+		(entry->compression == COMPRESSION_NONE && entry->size != entry->storedSize) )
+	{
+		assert( 0 ); // Corrupted pack
+		return 0;
+	}
+
+	const uint8_t* src = m_file->getData() + entry->dataOffset;
+	if( entry->compression == COMPRESSION_NONE )
+	{
+		m_file->advise(MappedFile::ACCESS_WILLNEED, entry->dataOffset, entry->size);
+		return new MemoryStream(src, entry->size, m_file.ptr());
+	}
+
+	if( entry->compression != COMPRESSION_LZ4 )
+	{
+		printf("[%s] Unsupported compression %d in %s\n", __FUNCTION__, entry->compression, fileName);
+		return 0;
+	}
+
+	MemoryStream* stream = new MemoryStream(entry->size);
+	uint8_t* dst = stream->getBuffer();
+	const uint8_t* srcEnd = src + entry->storedSize;
+	int decoded = 0;
+	while( decoded < (int)entry->size )
+	{
+		const int expected = std::min((int)m_header->blockSize, (int)entry->size - decoded);
+		uint32_t blockSize;
+		if( srcEnd - src < 4 )
+		{
+			break;
+		}
+
+		memcpy(&blockSize, src, 4);
+		src += 4;
+		const int storedSize = (int)(blockSize & ~STORED_RAW_BIT);
+		if( srcEnd - src < storedSize )
+		{
+			break;
+		}
+
+		int n = -1;
+		if( blockSize & STORED_RAW_BIT )
+		{
+			if( storedSize == expected )
+			{
+				memcpy(dst + decoded, src, storedSize);
+				n = storedSize;
+			}
+		}
+		else
+		{
+			n = lz4::decompress(src, storedSize, dst + decoded, expected);
+		}
+
+		if( n != expected )
+		{
+			break;
+		}
+
+		src += storedSize;
+		decoded += n;
+	}
+
+	if( decoded != (int)entry->size )
+	{
+		printf("[%s] %s is corrupted\n", __FUNCTION__, fileName);
+		assert( 0 );
+		delete stream;
+		return 0;
+	}
+
+	return stream;
+}
+
+int PackFile::getNumEntries() const
+{
+	return m_header != 0 ? (int)m_header->numEntries : 0;
+}
+
+uint64_t PackFile::hashName( const char* const fileName )
+{
+	// 64 bit FNV-1a
+	uint64_t h = 14695981039346656037ULL;
+	for( const char* p = skipCurrentDir(fileName); *p != 0; ++p )
+	{
+		h ^= (uint8_t)normalizeChar(*p);
+		h *= 1099511628211ULL;
+	}
+
+	return h;
+}
+
+const PackFile::PackEntry* PackFile::findEntry( const char* const fileName ) const
+{
+	if( m_header == 0 )
+	{
+		return 0;
+	}
+
+	const uint64_t h = hashName(fileName);
+	int first = 0;
+	int last = (int)m_header->numEntries;
+	while( first < last )
+	{
+		int middle = (first + last) / 2;
+		if( m_entries[middle].nameHash < h )
+		{
+			first = middle + 1;
+		}
+		else
+		{
+			last = middle;
+		}
+	}
+
+	if( first == (int)m_header->numEntries || m_entries[first].nameHash != h )
+	{
+		return 0;
+	}
+
+	// Check the name, so that hash collisions with files outside the pack are not taken as hits.
+	const PackEntry* entry = &m_entries[first];
+	if( entry->nameOffset >= (uint32_t)m_file->getSize() ||
+		memchr(m_file->getData() + entry->nameOffset, 0, m_file->getSize() - entry->nameOffset) == 0 ||
+		!namesEqual((const char*)m_file->getData() + entry->nameOffset, fileName) )
+	{
+		return 0;
+	}
+
+	return entry;
+}
+
+PackWriter::PackWriter( int blockSize )
+: m_blockSize(blockSize)
+, m_files()
+{
+	assert( blockSize > 0 );
+}
+
+void PackWriter::addFile( const char* const fileName, const void* data, int size, PackFile::Compression compression )
+{
+	File file;
+	for( const char* p = skipCurrentDir(fileName); *p != 0; ++p )
+	{
+		file.name += normalizeChar(*p);
+	}
+
+	file.nameHash = PackFile::hashName(fileName);
+	file.size = size;
+	file.compression = PackFile::COMPRESSION_NONE;
+
+	const uint8_t* src = (const uint8_t*)data;
+	if( compression == PackFile::COMPRESSION_LZ4 )
+	{
+		std::vector<uint8_t> block(lz4::compressBound(m_blockSize));
+		for( int offset = 0; offset < size; offset += m_blockSize )
+		{
+			const int n = std::min(m_blockSize, size - offset);
+			int storedSize = lz4::compress(src + offset, n, &block[0], n);
+			uint32_t header = storedSize;
+			if( storedSize == 0 )
+			{
+				// Does not compress
+				storedSize = n;
+				header = n | PackFile::STORED_RAW_BIT;
+			}
+
+			const uint8_t* stored = (header & PackFile::STORED_RAW_BIT) ? src + offset : &block[0];
+			file.data.insert(file.data.end(), (const uint8_t*)&header, (const uint8_t*)&header + 4);
+			file.data.insert(file.data.end(), stored, stored + storedSize);
+		}
+
+		if( (int)file.data.size() <= size - size / 8 )
+		{
+			file.compression = PackFile::COMPRESSION_LZ4;
+		}
+	}
+
+	if( file.compression == PackFile::COMPRESSION_NONE )
+	{
+		file.data.assign(src, src + size);
+	}
+
+	m_files.push_back(file);
+}
+
+bool PackWriter::compareHash( const File* a, const File* b )
+{
+	return a->nameHash < b->nameHash;
+}
+
+bool PackWriter::write( Stream* stream ) const
+{
+	std::vector<const File*> files;
+	for( size_t i = 0; i < m_files.size(); ++i )
+	{
+		files.push_back(&m_files[i]);
+	}
+
+	std::sort(files.begin(), files.end(), compareHash);
+	for( size_t i = 1; i < files.size(); ++i )
+	{
+		if( files[i]->nameHash == files[i - 1]->nameHash )
+		{
+			printf("[%s] Files %s and %s collide\n", __FUNCTION__, files[i - 1]->name.c_str(), files[i]->name.c_str());
+			return false;
+		}
+	}
+
+	// Lay out the pack.
+	PackFile::PackHeader header;
+	header.magic = PackFile::MAGIC;
+	header.version = PackFile::VERSION;
+	header.numEntries = (uint32_t)files.size();
+	header.blockSize = (uint32_t)m_blockSize;
+
+	std::vector<PackFile::PackEntry> entries(files.size());
+	int position = (int)(sizeof(PackFile::PackHeader) + entries.size() * sizeof(PackFile::PackEntry));
+	for( size_t i = 0; i < files.size(); ++i )
+	{
+		entries[i].nameOffset = position;
+		position += (int)files[i]->name.size() + 1;
+	}
+
+	for( size_t i = 0; i < files.size(); ++i )
+	{
+		const File& file = *files[i];
+		position = alignUp(position, file.compression == PackFile::COMPRESSION_NONE ? (int)PackFile::DATA_ALIGNMENT : 16);
+		entries[i].nameHash = file.nameHash;
+		entries[i].dataOffset = position;
+		entries[i].size = file.size;
+		entries[i].storedSize = (uint32_t)file.data.size();
+		entries[i].compression = file.compression;
+		entries[i].reserved = 0;
+		position += (int)file.data.size();
+	}
+
+	// Write it.
+	stream->write(&header, sizeof(header));
+	if( !entries.empty() )
+	{
+		stream->write(&entries[0], (int)(entries.size() * sizeof(PackFile::PackEntry)));
+	}
+
+	position = (int)(sizeof(PackFile::PackHeader) + entries.size() * sizeof(PackFile::PackEntry));
+	for( size_t i = 0; i < files.size(); ++i )
+	{
+		stream->write(files[i]->name.c_str(), (int)files[i]->name.size() + 1);
+		position += (int)files[i]->name.size() + 1;
+	}
+
+	for( size_t i = 0; i < files.size(); ++i )
+	{
+		writePadding(stream, position, files[i]->compression == PackFile::COMPRESSION_NONE ? (int)PackFile::DATA_ALIGNMENT : 16);
+		assert( position == (int)entries[i].dataOffset );
+		if( !files[i]->data.empty() )
+		{
+			stream->write(&files[i]->data[0], (int)files[i]->data.size());
+		}
+		position += (int)files[i]->data.size();
+	}
+
+	return true;
+}
+
+}
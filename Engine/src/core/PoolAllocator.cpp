@@ -0,0 +1,307 @@
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Copyright (c) 2013 Mikko Romppainen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in the
+// Software without restriction, including without limitation the rights to use, copy,
+// modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+#include <core/PoolAllocator.h>
+#include <es_assert.h>
+#include <string.h>
+#include <atomic>
+
+namespace core
+{
+
+// anonymous namespace for internal functions
+namespace
+{
+	const size_t classSizes[PoolAllocator::NUM_CLASSES] = { 16, 32, 48, 64, 80, 96, 112, 128, 160, 192, 224, 256 };
+
+	// Number of blocks moved between thread cache and shared lists at a time.
+	const int batchSize = 32;
+
+	const uint8_t poisonAllocated = 0xCD;
+	const uint8_t poisonFreed = 0xDD;
+
+	std::atomic<int> nextPoolId(0);
+
+	// Pools by id. Cleared, when pool is destroyed, so exiting threads do not flush to it.
+	std::atomic<PoolAllocator*> pools[PoolAllocator::MAX_POOLS];
+
+	// Size class of size in 16 byte granules (index 1..16).
+	int getSizeClass( size_t size )
+	{
+		static const int classOfGranules[17] = { 0, 0, 1, 2, 3, 4, 5, 6, 7, 8, 8, 9, 9, 10, 10, 11, 11 };
+		return classOfGranules[(size + 15) / 16];
+	}
+}
+
+//
+// Free blocks cached by one thread for one pool.
+struct PoolThreadCache
+{
+	PoolAllocator*				pool;
+	PoolAllocator::FreeBlock*	lists[PoolAllocator::NUM_CLASSES];
+	int							counts[PoolAllocator::NUM_CLASSES];
+
+	PoolThreadCache()
+	: pool(0)
+	{
+		memset(lists, 0, sizeof(lists));
+		memset(counts, 0, sizeof(counts));
+	}
+
+	~PoolThreadCache()
+	{
+		// Thread exits. Give blocks back, if the pool is still alive.
+		if( pool != 0 && pools[poolId()].load() == pool )
+		{
+			flushAll();
+		}
+	}
+
+	int poolId() const
+	{
+		return pool->m_id;
+	}
+
+	void flushAll()
+	{
+		for( int c = 0; c < PoolAllocator::NUM_CLASSES; ++c )
+		{
+			if( lists[c] != 0 )
+			{
+				PoolAllocator::FreeBlock* last = lists[c];
+				while( last->next != 0 )
+				{
+					last = last->next;
+				}
+
+				pool->release(c, lists[c], last, counts[c]);
+				lists[c] = 0;
+				counts[c] = 0;
+			}
+		}
+	}
+};
+
+namespace
+{
+	thread_local PoolThreadCache threadCaches[PoolAllocator::MAX_POOLS];
+}
+
+PoolAllocator::PoolAllocator( Allocator* alloc, size_t slabSize )
+: Allocator("pool")
+, m_alloc(alloc ? alloc : getDefaultAllocator())
+, m_slabSize(slabSize)
+, m_id(nextPoolId.fetch_add(1))
+{
+	assert( slabSize >= MAX_BLOCK_SIZE*batchSize );
+	memset(m_classes, 0, sizeof(m_classes));
+	if( m_id < MAX_POOLS )
+	{
+		pools[m_id].store(this);
+	}
+}
+
+PoolAllocator::~PoolAllocator()
+{
+	if( m_id < MAX_POOLS )
+	{
+		pools[m_id].store(0);
+		PoolThreadCache& cache = threadCaches[m_id];
+		cache.pool = 0;
+		memset(cache.lists, 0, sizeof(cache.lists));
+		memset(cache.counts, 0, sizeof(cache.counts));
+	}
+
+	for( size_t i = 0; i < m_slabs.size(); ++i )
+	{
+		m_alloc->deallocate(m_slabs[i], m_slabSize);
+	}
+}
+
+size_t PoolAllocator::getBlockSize( size_t size )
+{
+	return size <= MAX_BLOCK_SIZE ? classSizes[getSizeClass(size)] : 0;
+}
+
+void* PoolAllocator::allocate( size_t size, size_t alignment )
+{
+	// Blocks are aligned to 16 bytes.
+	if( size > MAX_BLOCK_SIZE || alignment > 16 )
+	{
+		return m_alloc->allocate(size, alignment);
+	}
+
+	const int c = getSizeClass(size);
+	FreeBlock* block = 0;
+	if( m_id < MAX_POOLS )
+	{
+		PoolThreadCache& cache = threadCaches[m_id];
+		cache.pool = this;
+		if( cache.lists[c] == 0 )
+		{
+			refill(c, cache.lists[c], cache.counts[c]);
+		}
+
+		block = cache.lists[c];
+		cache.lists[c] = block->next;
+		--cache.counts[c];
+	}
+	else
+	{
+		FreeBlock* list = 0;
+		int count = 0;
+		refill(c, list, count);
+		block = list;
+		if( list->next != 0 )
+		{
+			FreeBlock* last = list->next;
+			while( last->next != 0 )
+			{
+				last = last->next;
+			}
+			release(c, list->next, last, count - 1);
+		}
+	}
+
+#if ENGINE_POOL_POISON
+	// Everything but the link must still be poisoned, otherwise block was written after free.
+	const uint8_t* bytes = (const uint8_t*)block;
+	for( size_t i = sizeof(FreeBlock); i < classSizes[c]; ++i )
+	{
+		if( bytes[i] != poisonFreed )
+		{
+			assert( 0 ); // Pool block modified after it was freed
+			break;
+		}
+	}
+	memset(block, poisonAllocated, classSizes[c]);
+#endif
+
+	return block;
+}
+
+void PoolAllocator::deallocate( void* p, size_t size )
+{
+	if( size > MAX_BLOCK_SIZE )
+	{
+		m_alloc->deallocate(p, size);
+		return;
+	}
+
+	const int c = getSizeClass(size);
+	FreeBlock* block = (FreeBlock*)p;
+#if ENGINE_POOL_POISON
+	memset(block, poisonFreed, classSizes[c]);
+#endif
+
+	if( m_id < MAX_POOLS )
+	{
+		PoolThreadCache& cache = threadCaches[m_id];
+		cache.pool = this;
+		block->next = cache.lists[c];
+		cache.lists[c] = block;
+		++cache.counts[c];
+
+		// Keep at most two batches per class in the thread. Give one back.
+		if( cache.counts[c] > 2*batchSize )
+		{
+			FreeBlock* first = cache.lists[c];
+			FreeBlock* last = first;
+			for( int i = 1; i < batchSize; ++i )
+			{
+				last = last->next;
+			}
+
+			cache.lists[c] = last->next;
+			cache.counts[c] -= batchSize;
+			last->next = 0;
+			release(c, first, last, batchSize);
+		}
+	}
+	else
+	{
+		block->next = 0;
+		release(c, block, block, 1);
+	}
+}
+
+size_t PoolAllocator::getReservedBytes() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_slabs.size() * m_slabSize;
+}
+
+void PoolAllocator::refill( int sizeClass, FreeBlock*& list, int& count )
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	SizeClass& sc = m_classes[sizeClass];
+	const size_t blockSize = classSizes[sizeClass];
+
+	while( count < batchSize )
+	{
+		FreeBlock* block = 0;
+		if( sc.freeList != 0 )
+		{
+			block = sc.freeList;
+			sc.freeList = block->next;
+			--sc.numFree;
+		}
+		else
+		{
+			if( sc.slabCursor + blockSize > sc.slabEnd )
+			{
+				// Carve blocks only on demand, so untouched slab memory is not paged in.
+				uint8_t* slab = (uint8_t*)m_alloc->allocate(m_slabSize, 64);
+				assert( slab != 0 );
+				m_slabs.push_back(slab);
+				sc.slabCursor = slab;
+				sc.slabEnd = slab + m_slabSize;
+			}
+
+			block = (FreeBlock*)sc.slabCursor;
+			sc.slabCursor += blockSize;
+#if ENGINE_POOL_POISON
+			memset(block, poisonFreed, blockSize);
+#endif
+		}
+
+		block->next = list;
+		list = block;
+		++count;
+	}
+}
+
+void PoolAllocator::release( int sizeClass, FreeBlock* first, FreeBlock* last, int count )
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	SizeClass& sc = m_classes[sizeClass];
+	last->next = sc.freeList;
+	sc.freeList = first;
+	sc.numFree += count;
+}
+
+PoolAllocator* getObjectPool()
+{
+	static PoolAllocator objectPool;
+	return &objectPool;
+}
+
+}
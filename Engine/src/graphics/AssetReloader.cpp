@@ -0,0 +1,184 @@
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Copyright (c) 2013 Mikko Romppainen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in the
+// Software without restriction, including without limitation the rights to use, copy,
+// modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+#include <graphics/AssetReloader.h>
+#include <graphics/Image.h>
+#include <es_assert.h>
+#include <stdio.h>
+
+namespace graphics
+{
+	namespace
+	{
+		const int POLL_INTERVAL_MS = 100;
+
+		// Reads whole file. Unlike FileStream, does not assert if file is missing or
+		// locked by the editor at the moment.
+		bool readTextFile(const std::string& fileName, std::string* text)
+		{
+			FILE* f = fopen(fileName.c_str(), "rb");
+			if (f == 0)
+			{
+				return false;
+			}
+
+			fseek(f, 0, SEEK_END);
+			long size = ftell(f);
+			fseek(f, 0, SEEK_SET);
+			text->resize(size);
+			bool ok = size == 0 || fread(&(*text)[0], 1, size, f) == size_t(size);
+			fclose(f);
+			return ok && size > 0;
+		}
+	}
+
+	AssetReloader::AssetReloader()
+		: Object()
+		, m_watcher(new core::FileWatcher())
+		, m_quit(false)
+	{
+		m_thread = std::thread(&AssetReloader::run, this);
+	}
+
+	AssetReloader::~AssetReloader()
+	{
+		m_quit = true;
+		m_thread.join();
+	}
+
+	void AssetReloader::addShader(Shader* shader)
+	{
+		assert(!shader->getVertexShaderFileName().empty()); // Shader must be compiled from files
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_shaders.push_back(shader);
+		}
+
+		m_watcher->addFile(shader->getVertexShaderFileName().c_str());
+		m_watcher->addFile(shader->getFragmentShaderFileName().c_str());
+	}
+
+	void AssetReloader::addTexture(Texture2D* texture, const char* const fileName,
+		Texture::FilteringMode filtering, Texture::WrappingMode wrapping)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			WatchedTexture t;
+			t.texture = texture;
+			t.fileName = fileName;
+			t.filtering = filtering;
+			t.wrapping = wrapping;
+			m_textures.push_back(t);
+		}
+
+		m_watcher->addFile(fileName);
+	}
+
+	void AssetReloader::update()
+	{
+		std::vector<PendingShader> shaders;
+		std::vector<std::string> textures;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			shaders.swap(m_pendingShaders);
+			textures.swap(m_pendingTextures);
+		}
+
+		for (size_t i = 0; i < shaders.size(); ++i)
+		{
+			PendingShader& p = shaders[i];
+			if (p.shader->reload(p.vertexSource.c_str(), p.fragmentSource.c_str()))
+			{
+				printf("[%s] Reloaded shader %s, %s\n", __FUNCTION__,
+					p.shader->getVertexShaderFileName().c_str(), p.shader->getFragmentShaderFileName().c_str());
+			}
+			else
+			{
+				printf("[%s] Shader %s, %s failed to compile. Keeping old program.\n", __FUNCTION__,
+					p.shader->getVertexShaderFileName().c_str(), p.shader->getFragmentShaderFileName().c_str());
+			}
+		}
+
+		for (size_t i = 0; i < textures.size(); ++i)
+		{
+			// Image is decoded here, because engine objects are created on the render thread only.
+			core::Ref<Image> image = Image::loadFromTGA(textures[i]);
+			if (!image)
+			{
+				printf("[%s] Could not load texture %s\n", __FUNCTION__, textures[i].c_str());
+				continue;
+			}
+
+			for (size_t j = 0; j < m_textures.size(); ++j)
+			{
+				WatchedTexture& t = m_textures[j];
+				if (t.fileName == textures[i])
+				{
+					t.texture->setData(image, t.filtering, t.wrapping);
+					printf("[%s] Reloaded texture %s\n", __FUNCTION__, t.fileName.c_str());
+				}
+			}
+		}
+	}
+
+	void AssetReloader::run()
+	{
+		std::vector<std::string> changed;
+		while (!m_quit)
+		{
+			changed.clear();
+			m_watcher->poll(changed, POLL_INTERVAL_MS);
+
+			for (size_t i = 0; i < changed.size(); ++i)
+			{
+				const std::string& fileName = changed[i];
+
+				std::lock_guard<std::mutex> lock(m_mutex);
+				for (size_t j = 0; j < m_shaders.size(); ++j)
+				{
+					Shader* shader = m_shaders[j].ptr();
+					if (shader->getVertexShaderFileName() != fileName &&
+						shader->getFragmentShaderFileName() != fileName)
+					{
+						continue;
+					}
+
+					PendingShader p;
+					p.shader = shader;
+					if (readTextFile(shader->getVertexShaderFileName(), &p.vertexSource) &&
+						readTextFile(shader->getFragmentShaderFileName(), &p.fragmentSource))
+					{
+						m_pendingShaders.push_back(p);
+					}
+				}
+
+				for (size_t j = 0; j < m_textures.size(); ++j)
+				{
+					if (m_textures[j].fileName == fileName)
+					{
+						m_pendingTextures.push_back(fileName);
+						break;
+					}
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,498 @@
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Copyright (c) 2013 Mikko Romppainen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in the
+// Software without restriction, including without limitation the rights to use, copy,
+// modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+#include <graphics/CommandBuffer.h>
+#include <es_assert.h>
+#include <string.h>
+#include <stdio.h>
+#include <algorithm>
+
+namespace graphics
+{
+	namespace
+	{
+		struct BindShaderCommand
+		{
+			Shader*		shader;
+		};
+
+		struct BindMaterialCommand
+		{
+			ShaderUniforms*	material;
+		};
+
+		struct BindTextureCommand
+		{
+			int			unit;
+			GLenum		target;
+			GLuint		texture;
+		};
+
+		// Followed by the uniform data.
+		struct SetUniformCommand
+		{
+			const char*	name;
+			GLenum		type;
+			int			count;
+		};
+
+		struct DrawMeshCommand
+		{
+			Mesh*		mesh;
+		};
+
+		struct CallbackCommand
+		{
+			CommandCallback	function;
+			void*			data;
+		};
+
+		int getUniformSize(GLenum type)
+		{
+			switch (type)
+			{
+			case GL_FLOAT:			return 4;
+			case GL_FLOAT_VEC2:		return 8;
+			case GL_FLOAT_VEC3:		return 12;
+			case GL_FLOAT_VEC4:		return 16;
+			case GL_INT:			return 4;
+			case GL_FLOAT_MAT3:		return 36;
+			case GL_FLOAT_MAT4:		return 64;
+			default:
+				printf("[%s] Unsupported uniform type: 0x%X\n", __FUNCTION__, type);
+				assert(0);
+				return 0;
+			}
+		}
+
+		const int MAX_TEXTURE_UNITS = 8;
+	}
+
+	CommandBuffer::CommandBuffer(int initialBytes)
+		: Object()
+		, m_size(0)
+	{
+		m_data.reserve(initialBytes / sizeof(uint64_t));
+	}
+
+	CommandBuffer::~CommandBuffer()
+	{
+	}
+
+	void CommandBuffer::beginDraw(uint64_t sortKey)
+	{
+		if (!m_packets.empty())
+		{
+			m_packets.back().end = m_size;
+		}
+
+		Packet packet;
+		packet.key = sortKey;
+		packet.begin = m_size;
+		packet.end = m_size;
+		m_packets.push_back(packet);
+	}
+
+	void* CommandBuffer::addCommand(CommandType type, int size)
+	{
+		assert(!m_packets.empty());	// beginDraw must be called first
+		size = (sizeof(CommandHeader) + size + 7) & ~7;
+
+		int offset = m_size;
+		m_size += size;
+		if ((size_t)m_size > m_data.size()*sizeof(uint64_t))
+		{
+			m_data.resize(std::max(m_data.size() * 2, (size_t)m_size / sizeof(uint64_t)));
+		}
+
+		uint8_t* p = (uint8_t*)&m_data[0] + offset;
+		CommandHeader* header = (CommandHeader*)p;
+		header->type = (uint32_t)type;
+		header->size = (uint32_t)size;
+		m_packets.back().end = m_size;
+		return p + sizeof(CommandHeader);
+	}
+
+	void CommandBuffer::bindShader(Shader* shader)
+	{
+		assert(shader != 0);
+		BindShaderCommand* cmd = (BindShaderCommand*)addCommand(CMD_BIND_SHADER, sizeof(BindShaderCommand));
+		cmd->shader = shader;
+	}
+
+	void CommandBuffer::bindMaterial(ShaderUniforms* material)
+	{
+		assert(material != 0);
+		BindMaterialCommand* cmd = (BindMaterialCommand*)addCommand(CMD_BIND_MATERIAL, sizeof(BindMaterialCommand));
+		cmd->material = material;
+	}
+
+	void CommandBuffer::bindTexture(int unit, GLenum target, GLuint texture)
+	{
+		BindTextureCommand* cmd = (BindTextureCommand*)addCommand(CMD_BIND_TEXTURE, sizeof(BindTextureCommand));
+		cmd->unit = unit;
+		cmd->target = target;
+		cmd->texture = texture;
+	}
+
+	void CommandBuffer::setUniform(const char* const name, GLenum type, const void* data, int count)
+	{
+		assert(count > 0);
+		int dataSize = getUniformSize(type) * count;
+		SetUniformCommand* cmd = (SetUniformCommand*)addCommand(CMD_SET_UNIFORM, sizeof(SetUniformCommand) + dataSize);
+		cmd->name = name;
+		cmd->type = type;
+		cmd->count = count;
+		memcpy(cmd + 1, data, dataSize);
+	}
+
+	void CommandBuffer::setUniform(const char* const name, float value)
+	{
+		setUniform(name, GL_FLOAT, &value);
+	}
+
+	void CommandBuffer::setUniform(const char* const name, int value)
+	{
+		setUniform(name, GL_INT, &value);
+	}
+
+	void CommandBuffer::setUniform(const char* const name, const slmath::vec3& value)
+	{
+		setUniform(name, GL_FLOAT_VEC3, &value.x);
+	}
+
+	void CommandBuffer::setUniform(const char* const name, const slmath::vec4& value)
+	{
+		setUniform(name, GL_FLOAT_VEC4, &value.x);
+	}
+
+	void CommandBuffer::setUniform(const char* const name, const slmath::mat4& value)
+	{
+		setUniform(name, GL_FLOAT_MAT4, &value[0][0]);
+	}
+
+	void CommandBuffer::drawMesh(Mesh* mesh)
+	{
+		assert(mesh != 0);
+		DrawMeshCommand* cmd = (DrawMeshCommand*)addCommand(CMD_DRAW_MESH, sizeof(DrawMeshCommand));
+		cmd->mesh = mesh;
+	}
+
+	void CommandBuffer::callback(CommandCallback function, void* data)
+	{
+		assert(function != 0);
+		CallbackCommand* cmd = (CallbackCommand*)addCommand(CMD_CALLBACK, sizeof(CallbackCommand));
+		cmd->function = function;
+		cmd->data = data;
+	}
+
+	void CommandBuffer::reset()
+	{
+		m_size = 0;
+		m_packets.clear();
+	}
+
+	int CommandBuffer::getNumPackets() const
+	{
+		return (int)m_packets.size();
+	}
+
+	int CommandBuffer::getSize() const
+	{
+		return m_size;
+	}
+
+	uint64_t CommandBuffer::makeSortKey(int layer, uint32_t stateId, float depth)
+	{
+		depth = depth < 0.0f ? 0.0f : (depth > 1.0f ? 1.0f : depth);
+		uint64_t quantizedDepth = (uint64_t)(depth * (float)0xFFFFFF);
+		return ((uint64_t)(layer & 0xFF) << 56) | ((uint64_t)stateId << 24) | quantizedDepth;
+	}
+
+
+	RenderQueue::RenderQueue(int numBuffers)
+		: Object()
+		, m_numUsed(0)
+		, m_maxBatches(numBuffers > 0 ? numBuffers : core::getJobSystem()->getNumWorkers() + 1)
+		, m_shader(0)
+		, m_program(0)
+		, m_material(0)
+		, m_mesh(0)
+		, m_numDrawCalls(0)
+		, m_numSkippedBinds(0)
+	{
+	}
+
+	RenderQueue::~RenderQueue()
+	{
+	}
+
+	CommandBuffer* RenderQueue::addBuffers(int count)
+	{
+		while ((int)m_buffers.size() < m_numUsed + count)
+		{
+			m_buffers.push_back(new CommandBuffer());
+		}
+
+		CommandBuffer* first = m_buffers[m_numUsed].ptr();
+		m_numUsed += count;
+		return first;
+	}
+
+	CommandBuffer* RenderQueue::getBuffer(int index)
+	{
+		assert(index >= 0);
+		if (index >= m_numUsed)
+		{
+			addBuffers(index + 1 - m_numUsed);
+		}
+		return m_buffers[index].ptr();
+	}
+
+	int RenderQueue::getNumBuffers() const
+	{
+		return m_numUsed;
+	}
+
+	void RenderQueue::reset()
+	{
+		for (int i = 0; i < m_numUsed; ++i)
+		{
+			m_buffers[i]->reset();
+		}
+		m_numUsed = 0;
+	}
+
+	void RenderQueue::execute()
+	{
+		m_sorted.clear();
+		for (int i = 0; i < m_numUsed; ++i)
+		{
+			const std::vector<CommandBuffer::Packet>& packets = m_buffers[i]->m_packets;
+			for (size_t j = 0; j < packets.size(); ++j)
+			{
+				SortEntry e;
+				e.key = packets[j].key;
+				e.buffer = (uint32_t)i;
+				e.packet = (uint32_t)j;
+				m_sorted.push_back(e);
+			}
+		}
+		std::sort(m_sorted.begin(), m_sorted.end());
+
+		// State is not known at start, so first binds are never skipped.
+		m_shader = 0;
+		m_program = 0;
+		m_material = 0;
+		m_mesh = 0;
+		for (int i = 0; i < MAX_TEXTURE_UNITS; ++i)
+		{
+			m_textureTargets[i] = 0;
+			m_textures[i] = 0;
+		}
+		m_numDrawCalls = 0;
+		m_numSkippedBinds = 0;
+
+		for (size_t i = 0; i < m_sorted.size(); ++i)
+		{
+			const CommandBuffer& buffer = *m_buffers[m_sorted[i].buffer];
+			replay(buffer.m_packets[m_sorted[i].packet], buffer);
+		}
+
+		if (m_mesh != 0)
+		{
+			m_mesh->unbind();
+			m_mesh = 0;
+		}
+	}
+
+	void RenderQueue::replay(const CommandBuffer::Packet& packet, const CommandBuffer& buffer)
+	{
+		const uint8_t* data = (const uint8_t*)&buffer.m_data[0];
+		uint32_t offset = packet.begin;
+		while (offset < packet.end)
+		{
+			const CommandBuffer::CommandHeader* header = (const CommandBuffer::CommandHeader*)(data + offset);
+			const void* cmd = header + 1;
+			offset += header->size;
+
+			switch (header->type)
+			{
+			case CommandBuffer::CMD_BIND_SHADER:
+			{
+				Shader* shader = ((const BindShaderCommand*)cmd)->shader;
+				if (shader == m_shader && shader->getProgram() == m_program)
+				{
+					++m_numSkippedBinds;
+					break;
+				}
+
+				shader->bind();
+				m_shader = shader;
+				m_program = shader->getProgram();
+				m_material = 0;
+				break;
+			}
+
+			case CommandBuffer::CMD_BIND_MATERIAL:
+			{
+				ShaderUniforms* material = ((const BindMaterialCommand*)cmd)->material;
+				if (material == m_material && material->getShader()->getProgram() == m_program)
+				{
+					++m_numSkippedBinds;
+					break;
+				}
+
+				material->bind();
+				m_material = material;
+				m_shader = material->getShader();
+				m_program = m_shader->getProgram();
+
+				// Materials bind textures themselves.
+				for (int i = 0; i < MAX_TEXTURE_UNITS; ++i)
+				{
+					m_textureTargets[i] = 0;
+				}
+				break;
+			}
+
+			case CommandBuffer::CMD_BIND_TEXTURE:
+			{
+				const BindTextureCommand* c = (const BindTextureCommand*)cmd;
+				assert(c->unit >= 0 && c->unit < MAX_TEXTURE_UNITS);
+				if (m_textureTargets[c->unit] == c->target && m_textures[c->unit] == c->texture)
+				{
+					++m_numSkippedBinds;
+					break;
+				}
+
+				glActiveTexture(GL_TEXTURE0 + c->unit);
+				glBindTexture(c->target, c->texture);
+				m_textureTargets[c->unit] = c->target;
+				m_textures[c->unit] = c->texture;
+				break;
+			}
+
+			case CommandBuffer::CMD_SET_UNIFORM:
+			{
+				const SetUniformCommand* c = (const SetUniformCommand*)cmd;
+				GLint loc = getUniformLocation(c->name);
+				if (loc < 0)
+				{
+					break;
+				}
+
+				const float* src = (const float*)(c + 1);
+				switch (c->type)
+				{
+				case GL_FLOAT:			glUniform1fv(loc, c->count, src); break;
+				case GL_FLOAT_VEC2:		glUniform2fv(loc, c->count, src); break;
+				case GL_FLOAT_VEC3:		glUniform3fv(loc, c->count, src); break;
+				case GL_FLOAT_VEC4:		glUniform4fv(loc, c->count, src); break;
+				case GL_INT:			glUniform1iv(loc, c->count, (const GLint*)src); break;
+				case GL_FLOAT_MAT3:		glUniformMatrix3fv(loc, c->count, GL_FALSE, src); break;
+				case GL_FLOAT_MAT4:		glUniformMatrix4fv(loc, c->count, GL_FALSE, src); break;
+				default:
+					break;
+				}
+				break;
+			}
+
+			case CommandBuffer::CMD_DRAW_MESH:
+			{
+				Mesh* mesh = ((const DrawMeshCommand*)cmd)->mesh;
+				if (mesh == m_mesh)
+				{
+					++m_numSkippedBinds;
+				}
+				else
+				{
+					if (m_mesh != 0)
+					{
+						m_mesh->unbind();
+					}
+					mesh->bind();
+					m_mesh = mesh;
+				}
+
+				mesh->draw();
+				++m_numDrawCalls;
+				break;
+			}
+
+			case CommandBuffer::CMD_CALLBACK:
+			{
+				// Callback may change any state.
+				if (m_mesh != 0)
+				{
+					m_mesh->unbind();
+				}
+
+				const CallbackCommand* c = (const CallbackCommand*)cmd;
+				c->function(c->data);
+				m_shader = 0;
+				m_program = 0;
+				m_material = 0;
+				m_mesh = 0;
+				for (int i = 0; i < MAX_TEXTURE_UNITS; ++i)
+				{
+					m_textureTargets[i] = 0;
+				}
+				break;
+			}
+
+			default:
+				assert(0);
+				break;
+			}
+		}
+	}
+
+	GLint RenderQueue::getUniformLocation(const char* name)
+	{
+		assert(m_program != 0);	// Shader or material must be bound before setUniform
+		UniformKey key;
+		key.shader = m_shader;
+		key.name = name;
+
+		const int revision = m_shader->getRevision();
+		std::map<UniformKey, UniformLocation>::iterator it = m_uniformLocations.find(key);
+		if (it != m_uniformLocations.end() && it->second.revision == revision)
+		{
+			return it->second.location;
+		}
+
+		UniformLocation& entry = m_uniformLocations[key];
+		entry.revision = revision;
+		entry.location = glGetUniformLocation(m_program, name);
+		return entry.location;
+	}
+
+	int RenderQueue::getNumDrawCalls() const
+	{
+		return m_numDrawCalls;
+	}
+
+	int RenderQueue::getNumSkippedBinds() const
+	{
+		return m_numSkippedBinds;
+	}
+}
@@ -0,0 +1,370 @@
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Copyright (c) 2013 Mikko Romppainen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in the
+// Software without restriction, including without limitation the rights to use, copy,
+// modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+#include <graphics/Etc1.h>
+#include <core/JobSystem.h>
+#include <es_assert.h>
+#include <string.h>
+#include <vector>
+
+namespace graphics
+{
+	namespace
+	{
+		// Modifier tables. Pixel index 0..3 selects +a, +b, -a, -b.
+		const int MODIFIER_TABLE[8][2] =
+		{
+			{ 2, 8 }, { 5, 17 }, { 9, 29 }, { 13, 42 },
+			{ 18, 60 }, { 24, 80 }, { 33, 106 }, { 47, 183 }
+		};
+
+		int getModifier(int table, int index)
+		{
+			int m = MODIFIER_TABLE[table][index & 1];
+			return (index & 2) ? -m : m;
+		}
+
+		int clamp255(int v)
+		{
+			return v < 0 ? 0 : (v > 255 ? 255 : v);
+		}
+
+		int expand4(int c)
+		{
+			return (c << 4) | c;
+		}
+
+		int expand5(int c)
+		{
+			return (c << 3) | (c >> 2);
+		}
+
+		// Returns true, if pixel (x, y) of the block belongs to the second sub block.
+		bool isSecondSubBlock(int x, int y, bool flip)
+		{
+			return flip ? y >= 2 : x >= 2;
+		}
+
+		struct SubBlockFit
+		{
+			int			table;
+			int			error;
+			uint8_t		indices[8];
+		};
+
+		// Finds best modifier table and pixel indices for 8 pixels with given base color.
+		void fitSubBlock(const int pixels[8][3], const int base[3], SubBlockFit& fit)
+		{
+			fit.error = 0x7fffffff;
+			for (int t = 0; t < 8; ++t)
+			{
+				int error = 0;
+				uint8_t indices[8];
+				for (int p = 0; p < 8 && error < fit.error; ++p)
+				{
+					int best = 0x7fffffff;
+					for (int i = 0; i < 4; ++i)
+					{
+						int m = getModifier(t, i);
+						int dr = clamp255(base[0] + m) - pixels[p][0];
+						int dg = clamp255(base[1] + m) - pixels[p][1];
+						int db = clamp255(base[2] + m) - pixels[p][2];
+						int e = dr*dr + dg*dg + db*db;
+						if (e < best)
+						{
+							best = e;
+							indices[p] = (uint8_t)i;
+						}
+					}
+					error += best;
+				}
+
+				if (error < fit.error)
+				{
+					fit.error = error;
+					fit.table = t;
+					memcpy(fit.indices, indices, sizeof(indices));
+				}
+			}
+		}
+
+		struct BlockCandidate
+		{
+			int			error;
+			uint32_t	high;
+			uint32_t	low;
+		};
+
+		void encodeCandidate(const uint8_t* rgb, bool flip, bool differential, BlockCandidate& out)
+		{
+			// Gather sub block pixels in block pixel order
+			int pixels[2][8][3];
+			int count[2] = { 0, 0 };
+			int sum[2][3] = { { 0, 0, 0 }, { 0, 0, 0 } };
+			for (int y = 0; y < 4; ++y)
+			{
+				for (int x = 0; x < 4; ++x)
+				{
+					int s = isSecondSubBlock(x, y, flip) ? 1 : 0;
+					for (int c = 0; c < 3; ++c)
+					{
+						pixels[s][count[s]][c] = rgb[(y * 4 + x) * 3 + c];
+						sum[s][c] += rgb[(y * 4 + x) * 3 + c];
+					}
+					++count[s];
+				}
+			}
+
+			// Quantize average colors of sub blocks
+			int q[2][3];
+			int base[2][3];
+			for (int s = 0; s < 2; ++s)
+			{
+				for (int c = 0; c < 3; ++c)
+				{
+					int avg = (sum[s][c] + 4) / 8;
+					if (differential)
+					{
+						q[s][c] = (avg * 31 + 127) / 255;
+					}
+					else
+					{
+						q[s][c] = (avg * 15 + 127) / 255;
+					}
+				}
+			}
+
+			if (differential)
+			{
+				// Second color is stored as 3-bit signed delta from the first one.
+				for (int c = 0; c < 3; ++c)
+				{
+					int d = q[1][c] - q[0][c];
+					d = d < -4 ? -4 : (d > 3 ? 3 : d);
+					q[1][c] = q[0][c] + d;
+				}
+			}
+
+			for (int s = 0; s < 2; ++s)
+			{
+				for (int c = 0; c < 3; ++c)
+				{
+					base[s][c] = differential ? expand5(q[s][c]) : expand4(q[s][c]);
+				}
+			}
+
+			SubBlockFit fit[2];
+			fitSubBlock(pixels[0], base[0], fit[0]);
+			fitSubBlock(pixels[1], base[1], fit[1]);
+			out.error = fit[0].error + fit[1].error;
+
+			uint32_t high = 0;
+			if (differential)
+			{
+				for (int c = 0; c < 3; ++c)
+				{
+					int d = (q[1][c] - q[0][c]) & 7;
+					high |= uint32_t((q[0][c] << 3) | d) << (24 - c * 8);
+				}
+			}
+			else
+			{
+				for (int c = 0; c < 3; ++c)
+				{
+					high |= uint32_t((q[0][c] << 4) | q[1][c]) << (24 - c * 8);
+				}
+			}
+
+			high |= uint32_t(fit[0].table) << 5;
+			high |= uint32_t(fit[1].table) << 2;
+			high |= differential ? 2 : 0;
+			high |= flip ? 1 : 0;
+
+			// Pixel index bits are in column major order: bit x*4+y
+			uint32_t low = 0;
+			int next[2] = { 0, 0 };
+			for (int y = 0; y < 4; ++y)
+			{
+				for (int x = 0; x < 4; ++x)
+				{
+					int s = isSecondSubBlock(x, y, flip) ? 1 : 0;
+					int index = fit[s].indices[next[s]++];
+					int bit = x * 4 + y;
+					low |= uint32_t(index >> 1) << (bit + 16);
+					low |= uint32_t(index & 1) << bit;
+				}
+			}
+
+			out.high = high;
+			out.low = low;
+		}
+
+		void writeBigEndian(uint8_t* p, uint32_t v)
+		{
+			p[0] = uint8_t(v >> 24);
+			p[1] = uint8_t(v >> 16);
+			p[2] = uint8_t(v >> 8);
+			p[3] = uint8_t(v);
+		}
+
+		uint32_t readBigEndian(const uint8_t* p)
+		{
+			return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+		}
+
+		// Copies 4x4 block at (bx, by) to rgb, repeating edge pixels outside the image.
+		void fetchBlock(const uint8_t* pixels, int width, int height, int bpp, int bx, int by, uint8_t* rgb)
+		{
+			for (int y = 0; y < 4; ++y)
+			{
+				int sy = by * 4 + y < height ? by * 4 + y : height - 1;
+				for (int x = 0; x < 4; ++x)
+				{
+					int sx = bx * 4 + x < width ? bx * 4 + x : width - 1;
+					const uint8_t* p = pixels + (sy*width + sx)*bpp;
+					uint8_t* d = rgb + (y * 4 + x) * 3;
+					d[0] = p[0];
+					d[1] = p[1];
+					d[2] = p[2];
+				}
+			}
+		}
+
+		void encodeBlockRows(const uint8_t* pixels, int width, int height, int bpp, uint8_t* dst, int firstRow, int lastRow)
+		{
+			const int blocksX = (width + 3) / 4;
+			uint8_t rgb[16 * 3];
+			for (int by = firstRow; by < lastRow; ++by)
+			{
+				for (int bx = 0; bx < blocksX; ++bx)
+				{
+					fetchBlock(pixels, width, height, bpp, bx, by, rgb);
+					etc1EncodeBlock(rgb, dst + (by*blocksX + bx)*ETC1_BLOCK_SIZE);
+				}
+			}
+		}
+	}
+
+	int etc1GetEncodedSize(int width, int height)
+	{
+		return ((width + 3) / 4) * ((height + 3) / 4) * ETC1_BLOCK_SIZE;
+	}
+
+	void etc1EncodeBlock(const uint8_t* rgb, uint8_t* block)
+	{
+		BlockCandidate best = BlockCandidate();
+		best.error = 0x7fffffff;
+		for (int mode = 0; mode < 4; ++mode)
+		{
+			BlockCandidate c;
+			encodeCandidate(rgb, (mode & 1) != 0, (mode & 2) != 0, c);
+			if (c.error < best.error)
+			{
+				best = c;
+			}
+		}
+
+		writeBigEndian(block, best.high);
+		writeBigEndian(block + 4, best.low);
+	}
+
+	void etc1DecodeBlock(const uint8_t* block, uint8_t* rgb)
+	{
+		uint32_t high = readBigEndian(block);
+		uint32_t low = readBigEndian(block + 4);
+		bool flip = (high & 1) != 0;
+		bool differential = (high & 2) != 0;
+
+		int base[2][3];
+		for (int c = 0; c < 3; ++c)
+		{
+			int bits = (high >> (24 - c * 8)) & 0xff;
+			if (differential)
+			{
+				int c1 = bits >> 3;
+				int d = bits & 7;
+				d = d >= 4 ? d - 8 : d;
+				base[0][c] = expand5(c1);
+				base[1][c] = expand5((c1 + d) & 31);
+			}
+			else
+			{
+				base[0][c] = expand4(bits >> 4);
+				base[1][c] = expand4(bits & 15);
+			}
+		}
+
+		int table[2] = { int((high >> 5) & 7), int((high >> 2) & 7) };
+
+		for (int y = 0; y < 4; ++y)
+		{
+			for (int x = 0; x < 4; ++x)
+			{
+				int bit = x * 4 + y;
+				int index = (((low >> (bit + 16)) & 1) << 1) | ((low >> bit) & 1);
+				int s = isSecondSubBlock(x, y, flip) ? 1 : 0;
+				int m = getModifier(table[s], index);
+				uint8_t* d = rgb + (y * 4 + x) * 3;
+				for (int c = 0; c < 3; ++c)
+				{
+					d[c] = (uint8_t)clamp255(base[s][c] + m);
+				}
+			}
+		}
+	}
+
+	void etc1EncodeImage(const uint8_t* pixels, int width, int height, int bytesPerPixel, uint8_t* dst, int numThreads)
+	{
+		assert(bytesPerPixel == 3 || bytesPerPixel == 4);
+		const int blocksY = (height + 3) / 4;
+
+		if (numThreads == 1)
+		{
+			encodeBlockRows(pixels, width, height, bytesPerPixel, dst, 0, blocksY);
+			return;
+		}
+
+		// Block rows are independent, so they are split into batches for the job system.
+		core::getJobSystem()->parallelFor(0, blocksY, 1, [=](int first, int last)
+		{
+			encodeBlockRows(pixels, width, height, bytesPerPixel, dst, first, last);
+		}, numThreads);
+	}
+
+	void etc1DecodeImage(const uint8_t* src, int width, int height, uint8_t* rgb)
+	{
+		const int blocksX = (width + 3) / 4;
+		const int blocksY = (height + 3) / 4;
+		uint8_t block[16 * 3];
+		for (int by = 0; by < blocksY; ++by)
+		{
+			for (int bx = 0; bx < blocksX; ++bx)
+			{
+				etc1DecodeBlock(src + (by*blocksX + bx)*ETC1_BLOCK_SIZE, block);
+				for (int y = 0; y < 4 && by * 4 + y < height; ++y)
+				{
+					int numX = width - bx * 4 < 4 ? width - bx * 4 : 4;
+					memcpy(rgb + ((by * 4 + y)*width + bx * 4) * 3, block + y * 4 * 3, numX * 3);
+				}
+			}
+		}
+	}
+}
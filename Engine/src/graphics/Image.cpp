@@ -23,8 +23,10 @@
 #include <core/Object.h>
 #include <vector>
 #include <core/FileStream.h>
+#include <core/FileSystem.h>
 #include <core/Ref.h>
 #include <stdint.h>
+#include <graphics/TgaFormat.h>
 namespace graphics
 {
 
@@ -72,45 +74,101 @@ namespace graphics
 
 	Image* Image::loadFromTGA(const char* strFileName)
 	{
-		struct TARGA_HEADER
+		core::Ref<core::Stream> s = core::FileSystem::openFile(strFileName);
+		if (s == 0)
 		{
-			uint8_t   IDLength, ColormapType, ImageType;
-			uint8_t   ColormapSpecification[5];
-			uint16_t XOrigin, YOrigin;
-			uint16_t ImageWidth, ImageHeight;
-			uint8_t   PixelDepth;
-			uint8_t   ImageDescriptor;
-		};
-
-		core::Ref<core::FileStream> s = new core::FileStream(strFileName, core::FileStream::READ_ONLY);
-
-		static TARGA_HEADER header;
-		if (sizeof(header) != s->read(&header, sizeof(header)))
+			return 0;
+		}
+
+		if (s->data() != 0)
+		{
+			// Decode straight from the mapped file or pack.
+			return loadFromTGA(s->data(), s->size());
+		}
+
+		return loadFromTGA(s.ptr());
+	}
+
+	Image* Image::loadFromTGA(core::Stream* s)
+	{
+		uint8_t headerData[TgaHeader::SIZE];
+		TgaHeader header;
+		if (TgaHeader::SIZE != s->read(headerData, TgaHeader::SIZE) || !header.parse(headerData))
 		{
 			return 0;
 		}
 
-		Image* img = new Image(header.ImageWidth, header.ImageHeight, header.PixelDepth / 8);
+		// Skip image ID field
+		uint8_t id[255];
+		if (header.idLength != s->read(id, header.idLength))
+		{
+			return 0;
+		}
 
-		if (img->getDataLenInBytes() != s->read(img->getData(), img->getDataLenInBytes()))
+		std::vector<uint8_t> colorMap(header.getColorMapSize());
+		if (!colorMap.empty() && (int)colorMap.size() != s->read(&colorMap[0], (int)colorMap.size()))
 		{
-			delete img;
 			return 0;
 		}
 
-		// Convert the image from BGRA to RGBA
-		uint8_t* p = img->getData();
-		for (int y = 0; y < header.ImageHeight; y++)
+		Image* img = new Image(header.width, header.height, header.getDecodedBPP());
+
+		if (header.isDirectlyDecodable())
 		{
-			for (int x = 0; x < header.ImageWidth; x++)
+			// Read pixels straight to the image and convert in place.
+			if (img->getDataLenInBytes() != s->read(img->getData(), img->getDataLenInBytes()))
 			{
-				uint8_t temp = p[2]; p[2] = p[0]; p[0] = temp;
-				p += header.PixelDepth / 8;
+				delete img;
+				return 0;
+			}
+
+			finishTgaPixels(header, img->getData());
+		}
+		else
+		{
+			std::vector<uint8_t> pixelData(s->available());
+			if (pixelData.empty() || (int)pixelData.size() != s->read(&pixelData[0], (int)pixelData.size()))
+			{
+				delete img;
+				return 0;
+			}
+
+			if (!decodeTgaPixels(header, colorMap.empty() ? 0 : &colorMap[0],
+				&pixelData[0], (int)pixelData.size(), img->getData()))
+			{
+				delete img;
+				return 0;
 			}
 		}
 
 		return img;
 	}
-}
 
+	Image* Image::loadFromTGA(const void* data, int size)
+	{
+		const uint8_t* p = static_cast<const uint8_t*>(data);
+		TgaHeader header;
+		if (size < TgaHeader::SIZE || !header.parse(p))
+		{
+			return 0;
+		}
+
+		int offset = header.getPixelDataOffset();
+		if (offset >= size)
+		{
+			return 0;
+		}
+
+		const uint8_t* colorMap = header.getColorMapSize() > 0 ? p + TgaHeader::SIZE + header.idLength : 0;
+
+		Image* img = new Image(header.width, header.height, header.getDecodedBPP());
+		if (!decodeTgaPixels(header, colorMap, p + offset, size - offset, img->getData()))
+		{
+			delete img;
+			return 0;
+		}
+
+		return img;
+	}
+}
 
@@ -0,0 +1,311 @@
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Copyright (c) 2013 Mikko Romppainen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in the
+// Software without restriction, including without limitation the rights to use, copy,
+// modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+#include <graphics/KtxFormat.h>
+#include <graphics/Etc1.h>
+#include <graphics/OpenGLES/es_ext.h>
+#include <es_assert.h>
+#include <string.h>
+
+namespace graphics
+{
+	namespace
+	{
+		const uint8_t KTX_IDENTIFIER[12] =
+		{
+			0xAB, 0x4B, 0x54, 0x58, 0x20, 0x31, 0x31, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A
+		};
+
+		const uint32_t KTX_ENDIANNESS = 0x04030201;
+		const uint32_t KTX_ENDIANNESS_SWAPPED = 0x01020304;
+
+		// Tells loaders, that first row of the data is the bottom row (OpenGL convention).
+		const char KTX_ORIENTATION_KEY[] = "KTXorientation";
+		const char KTX_ORIENTATION_VALUE[] = "S=r,T=u";
+
+		uint32_t swap32(uint32_t v)
+		{
+			return (v >> 24) | ((v >> 8) & 0xff00) | ((v << 8) & 0xff0000) | (v << 24);
+		}
+
+		uint32_t readU32(const uint8_t* p, bool swap)
+		{
+			uint32_t v;
+			memcpy(&v, p, 4);
+			return swap ? swap32(v) : v;
+		}
+
+		int padTo4(int n)
+		{
+			return (n + 3) & ~3;
+		}
+
+		// Bytes per pixel of uncompressed format and type, 0 if not known.
+		int getPixelSize(uint32_t format, uint32_t type)
+		{
+			int components = 0;
+			switch (format)
+			{
+			case GL_ALPHA:
+			case GL_LUMINANCE:
+			case GL_RED:
+			case GL_RED_INTEGER:
+				components = 1;
+				break;
+			case GL_LUMINANCE_ALPHA:
+			case GL_RG:
+			case GL_RG_INTEGER:
+				components = 2;
+				break;
+			case GL_RGB:
+			case GL_RGB_INTEGER:
+				components = 3;
+				break;
+			case GL_RGBA:
+			case GL_RGBA_INTEGER:
+			case GL_BGRA_EXT:
+				components = 4;
+				break;
+			default:
+				return 0;
+			}
+
+			switch (type)
+			{
+			case GL_UNSIGNED_BYTE:
+			case GL_BYTE:
+				return components;
+			case GL_UNSIGNED_SHORT:
+			case GL_SHORT:
+			case GL_HALF_FLOAT:
+			case GL_HALF_FLOAT_OES:
+				return components * 2;
+			case GL_UNSIGNED_INT:
+			case GL_INT:
+			case GL_FLOAT:
+				return components * 4;
+			// Packed types hold the whole pixel
+			case GL_UNSIGNED_SHORT_5_6_5:
+			case GL_UNSIGNED_SHORT_4_4_4_4:
+			case GL_UNSIGNED_SHORT_5_5_5_1:
+				return 2;
+			case GL_UNSIGNED_INT_2_10_10_10_REV:
+			case GL_UNSIGNED_INT_10F_11F_11F_REV:
+			case GL_UNSIGNED_INT_5_9_9_9_REV:
+				return 4;
+			default:
+				return 0;
+			}
+		}
+
+		// Bytes per 4x4 block of compressed format, 0 if not known.
+		int getBlockSize(uint32_t internalFormat)
+		{
+			switch (internalFormat)
+			{
+			case GL_ETC1_RGB8_OES:
+			case GL_COMPRESSED_RGB8_ETC2:
+			case GL_COMPRESSED_SRGB8_ETC2:
+			case GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2:
+			case GL_COMPRESSED_SRGB8_PUNCHTHROUGH_ALPHA1_ETC2:
+			case GL_COMPRESSED_R11_EAC:
+			case GL_COMPRESSED_SIGNED_R11_EAC:
+			case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+			case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+				return 8;
+			case GL_COMPRESSED_RGBA8_ETC2_EAC:
+			case GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC:
+			case GL_COMPRESSED_RG11_EAC:
+			case GL_COMPRESSED_SIGNED_RG11_EAC:
+			case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+			case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+				return 16;
+			default:
+				return 0;
+			}
+		}
+
+		void writeU32(core::Stream* s, uint32_t v)
+		{
+			s->write(&v, 4);
+		}
+	}
+
+	bool parseKtx(const void* data, int size, KtxHeader& header, std::vector<KtxLevel>& levels)
+	{
+		const uint8_t* p = static_cast<const uint8_t*>(data);
+		const int headerEnd = KtxHeader::SIZE;
+		if (size < headerEnd || memcmp(p, KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER)) != 0)
+		{
+			return false;
+		}
+
+		p += sizeof(KTX_IDENTIFIER);
+		uint32_t endianness;
+		memcpy(&endianness, p, 4);
+		if (endianness != KTX_ENDIANNESS && endianness != KTX_ENDIANNESS_SWAPPED)
+		{
+			return false;
+		}
+
+		const bool swap = endianness == KTX_ENDIANNESS_SWAPPED;
+		uint32_t* fields = &header.glType;
+		for (int i = 0; i < 12; ++i)
+		{
+			fields[i] = readU32(p + 4 + i * 4, swap);
+		}
+
+		// Level sizes are checked against these, so that GL never reads past the data.
+		// Compressed formats with unknown block size are checked by glCompressedTexImage2D.
+		const int pixelSize = header.isCompressed() ? 0 : getPixelSize(header.glFormat, header.glType);
+		const int blockSize = header.isCompressed() ? getBlockSize(header.glInternalFormat) : 0;
+		if (!header.isCompressed() && pixelSize == 0)
+		{
+			return false;
+		}
+
+		// Swapping pixel data of multi byte types is not supported.
+		if (swap && !header.isCompressed() && header.glTypeSize > 1)
+		{
+			return false;
+		}
+
+		if (header.pixelWidth == 0 || header.pixelHeight == 0 || header.pixelDepth > 1 ||
+			header.numberOfArrayElements > 0 || header.numberOfFaces != 1)
+		{
+			return false;
+		}
+
+		const uint8_t* end = static_cast<const uint8_t*>(data) + size;
+		p = static_cast<const uint8_t*>(data) + headerEnd;
+		if (header.bytesOfKeyValueData > uint32_t(end - p))
+		{
+			return false;
+		}
+		p += header.bytesOfKeyValueData;
+
+		// 0 levels means, that the loader should generate mipmaps.
+		int numLevels = header.numberOfMipmapLevels > 0 ? (int)header.numberOfMipmapLevels : 1;
+		levels.clear();
+		for (int i = 0; i < numLevels; ++i)
+		{
+			if (end - p < 4)
+			{
+				return false;
+			}
+
+			uint32_t imageSize = readU32(p, swap);
+			p += 4;
+			if (imageSize > uint32_t(end - p))
+			{
+				return false;
+			}
+
+			KtxLevel level;
+			level.data = p;
+			level.size = (int)imageSize;
+			level.width = (int)(header.pixelWidth >> i) > 0 ? (int)(header.pixelWidth >> i) : 1;
+			level.height = (int)(header.pixelHeight >> i) > 0 ? (int)(header.pixelHeight >> i) : 1;
+
+			// Rows of uncompressed levels are padded to 4 bytes. Decoders read whole blocks.
+			long long levelSize = 0;
+			if (pixelSize > 0)
+			{
+				long long rowSize = ((long long)level.width * pixelSize + 3) / 4 * 4;
+				levelSize = rowSize * level.height;
+			}
+			else if (blockSize > 0)
+			{
+				levelSize = (long long)((level.width + 3) / 4) * ((level.height + 3) / 4) * blockSize;
+			}
+
+			if (level.size < levelSize)
+			{
+				return false;
+			}
+			levels.push_back(level);
+
+			p += padTo4(imageSize) < end - p ? padTo4(imageSize) : end - p;
+		}
+
+		return true;
+	}
+
+	void writeKtx(core::Stream* stream, const KtxHeader& header, const std::vector<KtxLevel>& levels)
+	{
+		assert(!levels.empty());
+
+		KtxHeader h = header;
+		h.pixelWidth = levels[0].width;
+		h.pixelHeight = levels[0].height;
+		h.pixelDepth = 0;
+		h.numberOfArrayElements = 0;
+		h.numberOfFaces = 1;
+		h.numberOfMipmapLevels = (uint32_t)levels.size();
+
+		// Key value pair: size, key and value with null terminators, padding to 4 bytes
+		const int keyValueSize = (int)(sizeof(KTX_ORIENTATION_KEY) + sizeof(KTX_ORIENTATION_VALUE));
+		h.bytesOfKeyValueData = 4 + padTo4(keyValueSize);
+
+		const uint8_t padding[4] = { 0, 0, 0, 0 };
+		stream->write(KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER));
+		writeU32(stream, KTX_ENDIANNESS);
+		stream->write(&h.glType, 12 * 4);
+
+		writeU32(stream, keyValueSize);
+		stream->write(KTX_ORIENTATION_KEY, sizeof(KTX_ORIENTATION_KEY));
+		stream->write(KTX_ORIENTATION_VALUE, sizeof(KTX_ORIENTATION_VALUE));
+		stream->write(padding, padTo4(keyValueSize) - keyValueSize);
+
+		for (size_t i = 0; i < levels.size(); ++i)
+		{
+			writeU32(stream, levels[i].size);
+			stream->write(levels[i].data, levels[i].size);
+			stream->write(padding, padTo4(levels[i].size) - levels[i].size);
+		}
+	}
+
+	void writeEtc1Ktx(core::Stream* stream, const std::vector< core::Ref<Image> >& levels, int numThreads)
+	{
+		assert(!levels.empty());
+
+		std::vector< std::vector<uint8_t> > encoded(levels.size());
+		std::vector<KtxLevel> ktxLevels(levels.size());
+		for (size_t i = 0; i < levels.size(); ++i)
+		{
+			Image* image = levels[i].ptr();
+			encoded[i].resize(etc1GetEncodedSize(image->getWidth(), image->getHeight()));
+			etc1EncodeImage(image->getData(), image->getWidth(), image->getHeight(), image->getBPP(), &encoded[i][0], numThreads);
+
+			ktxLevels[i].data = &encoded[i][0];
+			ktxLevels[i].size = (int)encoded[i].size();
+			ktxLevels[i].width = image->getWidth();
+			ktxLevels[i].height = image->getHeight();
+		}
+
+		KtxHeader header;
+		memset(&header, 0, sizeof(header));
+		header.glTypeSize = 1;
+		header.glInternalFormat = GL_ETC1_RGB8_OES;
+		header.glBaseInternalFormat = GL_RGB;
+		writeKtx(stream, header, ktxLevels);
+	}
+}
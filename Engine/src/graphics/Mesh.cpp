@@ -180,9 +180,24 @@ namespace graphics
 	}
 
 	void Mesh::render()
+	{
+		bind();
+		draw();
+		unbind();
+	}
+
+	void Mesh::bind()
 	{
 		m_vb->bind();
+	}
+
+	void Mesh::draw()
+	{
 		m_ib->drawElements();
+	}
+
+	void Mesh::unbind()
+	{
 		m_vb->unbind();
 	}
 
@@ -0,0 +1,340 @@
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Copyright (c) 2013 Mikko Romppainen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in the
+// Software without restriction, including without limitation the rights to use, copy,
+// modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+#include <graphics/MipmapGenerator.h>
+#include <core/JobSystem.h>
+#include <es_assert.h>
+#include <math.h>
+#include <algorithm>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#include <emmintrin.h>
+#define MIPMAP_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define MIPMAP_NEON
+#endif
+
+namespace graphics
+{
+	namespace
+	{
+		// Kaiser filter support radius in destination pixels and window shape parameter.
+		const float KAISER_RADIUS = 2.0f;
+		const float KAISER_ALPHA = 4.0f;
+
+		// Minimum number of pixels per job system batch. Smaller levels are filtered on the calling thread.
+		const int MIN_PIXELS_PER_THREAD = 64*64;
+
+		const int LINEAR_TO_SRGB_LUT_SIZE = 4096;
+
+		//
+		// Per axis filter weights. Taps of destination pixel i are
+		// indices/weights[offsets[i] .. offsets[i+1]).
+		struct FilterWeights
+		{
+			std::vector<int>	offsets;
+			std::vector<int>	indices;
+			std::vector<float>	weights;
+		};
+
+		float besselI0(float x)
+		{
+			// Power series, converges fast for the small arguments used here.
+			float sum = 1.0f;
+			float term = 1.0f;
+			float halfX = 0.5f*x;
+			for (int k = 1; k < 20; ++k)
+			{
+				term *= (halfX / k)*(halfX / k);
+				sum += term;
+			}
+			return sum;
+		}
+
+		float kaiser(float x)
+		{
+			float t = x / KAISER_RADIUS;
+			if (t*t >= 1.0f)
+			{
+				return 0.0f;
+			}
+
+			float sinc = 1.0f;
+			if (fabsf(x) > 1e-5f)
+			{
+				float px = 3.14159265f*x;
+				sinc = sinf(px) / px;
+			}
+
+			return sinc * besselI0(KAISER_ALPHA*sqrtf(1.0f - t*t)) / besselI0(KAISER_ALPHA);
+		}
+
+		void buildWeights(int srcSize, int dstSize, MipmapFilter filter, FilterWeights& w)
+		{
+			const float scale = float(srcSize) / float(dstSize);
+			w.offsets.resize(dstSize + 1);
+			w.indices.clear();
+			w.weights.clear();
+
+			for (int d = 0; d < dstSize; ++d)
+			{
+				w.offsets[d] = (int)w.indices.size();
+				const float center = (d + 0.5f)*scale;
+				const float support = filter == MIPMAP_BOX_FILTER ? 0.5f*scale : KAISER_RADIUS*scale;
+				const int first = (int)floorf(center - support);
+				const int last = (int)ceilf(center + support);
+
+				float sum = 0.0f;
+				for (int s = first; s < last; ++s)
+				{
+					float weight;
+					if (filter == MIPMAP_BOX_FILTER)
+					{
+						// Coverage of source pixel by destination pixel footprint
+						float lo = center - support > float(s) ? center - support : float(s);
+						float hi = center + support < float(s + 1) ? center + support : float(s + 1);
+						weight = hi - lo;
+					}
+					else
+					{
+						weight = kaiser((s + 0.5f - center) / scale);
+					}
+
+					if (weight == 0.0f)
+					{
+						continue;
+					}
+
+					// Clamp to edge
+					int index = s < 0 ? 0 : (s >= srcSize ? srcSize - 1 : s);
+					w.indices.push_back(index);
+					w.weights.push_back(weight);
+					sum += weight;
+				}
+
+				for (size_t i = w.offsets[d]; i < w.weights.size(); ++i)
+				{
+					w.weights[i] /= sum;
+				}
+			}
+
+			w.offsets[dstSize] = (int)w.indices.size();
+		}
+
+		// dst[i] += weight*src[i]
+		void accumulateRow(float* dst, const float* src, float weight, int n)
+		{
+			int i = 0;
+#if defined(MIPMAP_SSE2)
+			__m128 w = _mm_set1_ps(weight);
+			for (; i + 4 <= n; i += 4)
+			{
+				__m128 d = _mm_loadu_ps(dst + i);
+				d = _mm_add_ps(d, _mm_mul_ps(w, _mm_loadu_ps(src + i)));
+				_mm_storeu_ps(dst + i, d);
+			}
+#elif defined(MIPMAP_NEON)
+			float32x4_t w = vdupq_n_f32(weight);
+			for (; i + 4 <= n; i += 4)
+			{
+				vst1q_f32(dst + i, vmlaq_f32(vld1q_f32(dst + i), vld1q_f32(src + i), w));
+			}
+#endif
+			for (; i < n; ++i)
+			{
+				dst[i] += weight*src[i];
+			}
+		}
+
+		struct ConversionTables
+		{
+			float	srgbToLinear[256];
+			uint8_t	linearToSrgb[LINEAR_TO_SRGB_LUT_SIZE];
+
+			ConversionTables()
+			{
+				for (int i = 0; i < 256; ++i)
+				{
+					float c = i / 255.0f;
+					srgbToLinear[i] = c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+				}
+
+				for (int i = 0; i < LINEAR_TO_SRGB_LUT_SIZE; ++i)
+				{
+					float c = i / float(LINEAR_TO_SRGB_LUT_SIZE - 1);
+					float s = c <= 0.0031308f ? c*12.92f : 1.055f*powf(c, 1.0f / 2.4f) - 0.055f;
+					linearToSrgb[i] = (uint8_t)(s*255.0f + 0.5f);
+				}
+			}
+		};
+
+		const ConversionTables& getTables()
+		{
+			static const ConversionTables tables;
+			return tables;
+		}
+
+		// Returns true, if channel c of pixel with bpp channels holds alpha.
+		bool isAlphaChannel(int c, int bpp)
+		{
+			return (bpp == 4 && c == 3) || (bpp == 2 && c == 1);
+		}
+
+		void toFloat(const uint8_t* src, float* dst, int numPixels, int bpp, bool srgb)
+		{
+			const ConversionTables& t = getTables();
+			for (int c = 0; c < bpp; ++c)
+			{
+				bool linear = !srgb || isAlphaChannel(c, bpp);
+				for (int i = c; i < numPixels*bpp; i += bpp)
+				{
+					dst[i] = linear ? src[i] / 255.0f : t.srgbToLinear[src[i]];
+				}
+			}
+		}
+
+		uint8_t toByte(float v, bool srgb)
+		{
+			v = v < 0.0f ? 0.0f : (v > 1.0f ? 1.0f : v);
+			if (srgb)
+			{
+				return getTables().linearToSrgb[(int)(v*(LINEAR_TO_SRGB_LUT_SIZE - 1) + 0.5f)];
+			}
+			return (uint8_t)(v*255.0f + 0.5f);
+		}
+
+		struct LevelJob
+		{
+			const float*			src;
+			int						srcWidth;
+			float*					dst;
+			uint8_t*				dstBytes;
+			int						dstWidth;
+			int						bpp;
+			bool					srgb;
+			const FilterWeights*	horizontal;
+			const FilterWeights*	vertical;
+		};
+
+		// Filters destination rows [y0, y1). Vertical pass first (SIMD over whole rows),
+		// then horizontal pass on the single filtered row.
+		void filterRows(const LevelJob& job, int y0, int y1)
+		{
+			const int srcRowLen = job.srcWidth*job.bpp;
+			const int bpp = job.bpp;
+			std::vector<float> row(srcRowLen);
+
+			for (int y = y0; y < y1; ++y)
+			{
+				std::fill(row.begin(), row.end(), 0.0f);
+				const FilterWeights& v = *job.vertical;
+				for (int k = v.offsets[y]; k < v.offsets[y + 1]; ++k)
+				{
+					accumulateRow(&row[0], job.src + v.indices[k]*srcRowLen, v.weights[k], srcRowLen);
+				}
+
+				float* dst = job.dst + y*job.dstWidth*bpp;
+				uint8_t* dstBytes = job.dstBytes + y*job.dstWidth*bpp;
+				const FilterWeights& h = *job.horizontal;
+				for (int x = 0; x < job.dstWidth; ++x)
+				{
+					float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+					for (int k = h.offsets[x]; k < h.offsets[x + 1]; ++k)
+					{
+						const float* p = &row[h.indices[k]*bpp];
+						const float w = h.weights[k];
+						for (int c = 0; c < bpp; ++c)
+						{
+							sum[c] += w*p[c];
+						}
+					}
+
+					for (int c = 0; c < bpp; ++c)
+					{
+						dst[x*bpp + c] = sum[c];
+						dstBytes[x*bpp + c] = toByte(sum[c], job.srgb && !isAlphaChannel(c, bpp));
+					}
+				}
+			}
+		}
+	}
+
+	void generateMipmaps(Image* image, std::vector< core::Ref<Image> >& levels, const MipmapSettings& settings)
+	{
+		assert(image != 0);
+		const int bpp = image->getBPP();
+		assert(bpp >= 1 && bpp <= 4);
+
+		levels.clear();
+		levels.push_back(image);
+
+		int width = image->getWidth();
+		int height = image->getHeight();
+		std::vector<float> src(width*height*bpp);
+		std::vector<float> dst;
+		toFloat(image->getData(), &src[0], width*height, bpp, settings.srgb);
+
+		FilterWeights horizontal;
+		FilterWeights vertical;
+
+		while (width > 1 || height > 1)
+		{
+			const int dstWidth = width > 1 ? width / 2 : 1;
+			const int dstHeight = height > 1 ? height / 2 : 1;
+			buildWeights(width, dstWidth, settings.filter, horizontal);
+			buildWeights(height, dstHeight, settings.filter, vertical);
+
+			// Images are created here, so jobs never touch reference counts.
+			Image* level = new Image(dstWidth, dstHeight, bpp);
+			levels.push_back(level);
+			dst.resize(dstWidth*dstHeight*bpp);
+
+			LevelJob job;
+			job.src = &src[0];
+			job.srcWidth = width;
+			job.dst = &dst[0];
+			job.dstBytes = level->getData();
+			job.dstWidth = dstWidth;
+			job.bpp = bpp;
+			job.srgb = settings.srgb;
+			job.horizontal = &horizontal;
+			job.vertical = &vertical;
+
+			if (settings.numThreads == 1 || dstWidth*dstHeight < 2*MIN_PIXELS_PER_THREAD)
+			{
+				filterRows(job, 0, dstHeight);
+			}
+			else
+			{
+				const int minRows = (MIN_PIXELS_PER_THREAD + dstWidth - 1) / dstWidth;
+				core::getJobSystem()->parallelFor(0, dstHeight, minRows, [&job](int first, int last)
+				{
+					filterRows(job, first, last);
+				}, settings.numThreads);
+			}
+
+			src.swap(dst);
+			width = dstWidth;
+			height = dstHeight;
+		}
+	}
+}
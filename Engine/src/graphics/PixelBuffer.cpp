@@ -0,0 +1,245 @@
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Copyright (c) 2013 Mikko Romppainen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in the
+// Software without restriction, including without limitation the rights to use, copy,
+// modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+#include <graphics/PixelBuffer.h>
+#include <es_assert.h>
+#include <string.h>
+
+namespace graphics
+{
+	namespace
+	{
+		// Returns true, if fence has signaled. Does not wait.
+		bool isSignaled(GLsync fence)
+		{
+			GLenum res = esClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+			assert(res != GL_WAIT_FAILED);
+			return res == GL_ALREADY_SIGNALED || res == GL_CONDITION_SATISFIED;
+		}
+	}
+
+	PixelUnpackRing::PixelUnpackRing(int bytesPerBuffer, int numBuffers)
+		: Object()
+		, m_bytesPerBuffer(bytesPerBuffer)
+		, m_next(0)
+	{
+		assert(numBuffers > 0);
+		if( !esIsVersion3() )
+		{
+			return;
+		}
+
+		m_buffers.resize(numBuffers);
+		m_fences.resize(numBuffers, (GLsync)0);
+		glGenBuffers(numBuffers, &m_buffers[0]);
+		for( int i = 0; i < numBuffers; ++i )
+		{
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_buffers[i]);
+			glBufferData(GL_PIXEL_UNPACK_BUFFER, m_bytesPerBuffer, 0, GL_STREAM_DRAW);
+		}
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+
+	PixelUnpackRing::~PixelUnpackRing()
+	{
+		for( size_t i = 0; i < m_fences.size(); ++i )
+		{
+			if( m_fences[i] )
+			{
+				esDeleteSync(m_fences[i]);
+			}
+		}
+
+		if( !m_buffers.empty() )
+		{
+			glDeleteBuffers((GLsizei)m_buffers.size(), &m_buffers[0]);
+		}
+	}
+
+	bool PixelUnpackRing::update(Texture2D* texture, Image* image, int x, int y)
+	{
+		return update(texture, image->getData(), x, y, image->getWidth(), image->getHeight(), image->getBPP());
+	}
+
+	bool PixelUnpackRing::update(Texture2D* texture, const uint8_t* pixels, int x, int y, int width, int height, int bytesPerPixel)
+	{
+		const int size = width*height*bytesPerPixel;
+		if( m_buffers.empty() )
+		{
+			texture->setSubData(pixels, x, y, width, height, bytesPerPixel);
+			return true;
+		}
+
+		assert(size <= m_bytesPerBuffer);
+		GLsync& fence = m_fences[m_next];
+		if( fence )
+		{
+			if( !isSignaled(fence) )
+			{
+				return false;
+			}
+
+			esDeleteSync(fence);
+			fence = 0;
+		}
+
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_buffers[m_next]);
+		void* p = esMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+		if( p == 0 )
+		{
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			return false;
+		}
+
+		memcpy(p, pixels, size);
+		esUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+		// With unpack buffer bound, the pixel pointer is an offset to the buffer.
+		texture->setSubData(0, x, y, width, height, bytesPerPixel);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+		fence = esFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		m_next = (m_next + 1) % (int)m_buffers.size();
+		return true;
+	}
+
+	PixelReadback::PixelReadback(int maxWidth, int maxHeight, int numBuffers)
+		: Object()
+		, m_maxBytes(maxWidth*maxHeight*4)
+		, m_first(0)
+		, m_numPending(0)
+	{
+		assert(numBuffers > 0);
+		m_slots.resize(numBuffers);
+		for( int i = 0; i < numBuffers; ++i )
+		{
+			Slot& s = m_slots[i];
+			s.buffer = 0;
+			s.fence = 0;
+			s.width = 0;
+			s.height = 0;
+
+			if( esIsVersion3() )
+			{
+				glGenBuffers(1, &s.buffer);
+				glBindBuffer(GL_PIXEL_PACK_BUFFER, s.buffer);
+				glBufferData(GL_PIXEL_PACK_BUFFER, m_maxBytes, 0, GL_STREAM_READ);
+			}
+		}
+
+		if( esIsVersion3() )
+		{
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		}
+	}
+
+	PixelReadback::~PixelReadback()
+	{
+		for( size_t i = 0; i < m_slots.size(); ++i )
+		{
+			if( m_slots[i].fence )
+			{
+				esDeleteSync(m_slots[i].fence);
+			}
+
+			if( m_slots[i].buffer )
+			{
+				glDeleteBuffers(1, &m_slots[i].buffer);
+			}
+		}
+	}
+
+	bool PixelReadback::request(int x, int y, int width, int height)
+	{
+		assert(width*height*4 <= m_maxBytes);
+		if( m_numPending == (int)m_slots.size() )
+		{
+			return false;
+		}
+
+		Slot& s = m_slots[(m_first + m_numPending) % m_slots.size()];
+		s.width = width;
+		s.height = height;
+		glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+		if( s.buffer )
+		{
+			// With pack buffer bound, glReadPixels returns immediately and writes to the buffer.
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, s.buffer);
+			glReadPixels(x, y, width, height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+			s.fence = esFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		}
+		else
+		{
+			s.pixels.resize(width*height*4);
+			glReadPixels(x, y, width, height, GL_RGBA, GL_UNSIGNED_BYTE, &s.pixels[0]);
+		}
+
+		++m_numPending;
+		return true;
+	}
+
+	Image* PixelReadback::poll()
+	{
+		if( m_numPending == 0 )
+		{
+			return 0;
+		}
+
+		Slot& s = m_slots[m_first];
+		Image* image = 0;
+		if( s.buffer )
+		{
+			if( !isSignaled(s.fence) )
+			{
+				return 0;
+			}
+
+			esDeleteSync(s.fence);
+			s.fence = 0;
+
+			image = new Image(s.width, s.height, 4);
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, s.buffer);
+			const void* p = esMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, image->getDataLenInBytes(), GL_MAP_READ_BIT);
+			if( p )
+			{
+				memcpy(image->getData(), p, image->getDataLenInBytes());
+				esUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+			}
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		}
+		else
+		{
+			image = new Image(s.width, s.height, 4);
+			memcpy(image->getData(), &s.pixels[0], image->getDataLenInBytes());
+		}
+
+		m_first = (m_first + 1) % (int)m_slots.size();
+		--m_numPending;
+		return image;
+	}
+
+	int PixelReadback::getNumPending() const
+	{
+		return m_numPending;
+	}
+}
@@ -0,0 +1,196 @@
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Copyright (c) 2013 Mikko Romppainen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in the
+// Software without restriction, including without limitation the rights to use, copy,
+// modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+#include <graphics/PixelConvert.h>
+#include <es_assert.h>
+#include <string.h>
+#include <vector>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define PIXEL_CONVERT_SSSE3
+#include <tmmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define SSSE3_FUNCTION
+#else
+#include <cpuid.h>
+#define SSSE3_FUNCTION __attribute__((target("ssse3")))
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define PIXEL_CONVERT_NEON
+#include <arm_neon.h>
+#endif
+
+namespace graphics
+{
+	namespace
+	{
+		void swapRedBlueScalar(uint8_t* dst, const uint8_t* src, int numPixels, int bpp)
+		{
+			for (int i = 0; i < numPixels; ++i)
+			{
+				uint8_t r = src[2];
+				uint8_t g = src[1];
+				uint8_t b = src[0];
+				dst[0] = r;
+				dst[1] = g;
+				dst[2] = b;
+				if (bpp == 4)
+				{
+					dst[3] = src[3];
+				}
+
+				src += bpp;
+				dst += bpp;
+			}
+		}
+
+#if defined(PIXEL_CONVERT_SSSE3)
+		bool hasSSSE3()
+		{
+			static int result = -1;
+			if (result < 0)
+			{
+#if defined(_MSC_VER)
+				int info[4];
+				__cpuid(info, 1);
+				result = (info[2] & (1 << 9)) ? 1 : 0;
+#else
+				unsigned int eax, ebx, ecx, edx;
+				result = (__get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_SSSE3)) ? 1 : 0;
+#endif
+			}
+
+			return result == 1;
+		}
+
+		// Returns number of pixels processed.
+		SSSE3_FUNCTION int swapRedBlueSSSE3(uint8_t* dst, const uint8_t* src, int numPixels, int bpp)
+		{
+			int i = 0;
+			if (bpp == 4)
+			{
+				const __m128i mask = _mm_setr_epi8(2,1,0,3, 6,5,4,7, 10,9,8,11, 14,13,12,15);
+				for (; i + 4 <= numPixels; i += 4)
+				{
+					__m128i v = _mm_loadu_si128((const __m128i*)(src + i*4));
+					_mm_storeu_si128((__m128i*)(dst + i*4), _mm_shuffle_epi8(v, mask));
+				}
+			}
+			else
+			{
+				// 5 pixels (15 bytes) per iteration. 16th byte is copied as is, so 16 bytes
+				// must be available after the 5 pixels: stop one pixel early.
+				const __m128i mask = _mm_setr_epi8(2,1,0, 5,4,3, 8,7,6, 11,10,9, 14,13,12, 15);
+				for (; i + 6 <= numPixels; i += 5)
+				{
+					__m128i v = _mm_loadu_si128((const __m128i*)(src + i*3));
+					_mm_storeu_si128((__m128i*)(dst + i*3), _mm_shuffle_epi8(v, mask));
+				}
+			}
+
+			return i;
+		}
+#endif
+
+#if defined(PIXEL_CONVERT_NEON)
+		// Returns number of pixels processed.
+		int swapRedBlueNEON(uint8_t* dst, const uint8_t* src, int numPixels, int bpp)
+		{
+			int i = 0;
+			if (bpp == 4)
+			{
+				for (; i + 16 <= numPixels; i += 16)
+				{
+					uint8x16x4_t v = vld4q_u8(src + i*4);
+					uint8x16_t t = v.val[0];
+					v.val[0] = v.val[2];
+					v.val[2] = t;
+					vst4q_u8(dst + i*4, v);
+				}
+			}
+			else
+			{
+				for (; i + 16 <= numPixels; i += 16)
+				{
+					uint8x16x3_t v = vld3q_u8(src + i*3);
+					uint8x16_t t = v.val[0];
+					v.val[0] = v.val[2];
+					v.val[2] = t;
+					vst3q_u8(dst + i*3, v);
+				}
+			}
+
+			return i;
+		}
+#endif
+	}
+
+	void swapRedBlue(uint8_t* dst, const uint8_t* src, int numPixels, int bytesPerPixel)
+	{
+		assert(bytesPerPixel == 3 || bytesPerPixel == 4);
+		int done = 0;
+#if defined(PIXEL_CONVERT_SSSE3)
+		if (hasSSSE3())
+		{
+			done = swapRedBlueSSSE3(dst, src, numPixels, bytesPerPixel);
+		}
+#elif defined(PIXEL_CONVERT_NEON)
+		done = swapRedBlueNEON(dst, src, numPixels, bytesPerPixel);
+#endif
+		swapRedBlueScalar(dst + done*bytesPerPixel, src + done*bytesPerPixel, numPixels - done, bytesPerPixel);
+	}
+
+	void flipRows(uint8_t* data, int rowBytes, int numRows)
+	{
+		std::vector<uint8_t> temp(rowBytes);
+		uint8_t* top = data;
+		uint8_t* bottom = data + (numRows-1)*rowBytes;
+		while (top < bottom)
+		{
+			memcpy(&temp[0], top, rowBytes);
+			memcpy(top, bottom, rowBytes);
+			memcpy(bottom, &temp[0], rowBytes);
+			top += rowBytes;
+			bottom -= rowBytes;
+		}
+	}
+
+	void mirrorRows(uint8_t* data, int width, int height, int bytesPerPixel)
+	{
+		for (int y = 0; y < height; ++y)
+		{
+			uint8_t* left = data + y*width*bytesPerPixel;
+			uint8_t* right = left + (width-1)*bytesPerPixel;
+			while (left < right)
+			{
+				for (int c = 0; c < bytesPerPixel; ++c)
+				{
+					uint8_t t = left[c];
+					left[c] = right[c];
+					right[c] = t;
+				}
+				left += bytesPerPixel;
+				right -= bytesPerPixel;
+			}
+		}
+	}
+}
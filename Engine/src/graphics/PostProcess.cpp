@@ -0,0 +1,453 @@
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Copyright (c) 2013 Mikko Romppainen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in the
+// Software without restriction, including without limitation the rights to use, copy,
+// modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+#include <graphics/PostProcess.h>
+#include <slmath/float_util.h>
+#include <es_assert.h>
+#include <stdio.h>
+
+namespace graphics
+{
+	namespace
+	{
+		const char* const fullScreenVertexShader =
+			"attribute vec2 g_vPosition;\n"
+			"varying vec2 g_vTexCoord;\n"
+			"void main()\n"
+			"{\n"
+			"	g_vTexCoord = g_vPosition*0.5 + 0.5;\n"
+			"	gl_Position = vec4(g_vPosition, 0.0, 1.0);\n"
+			"}\n";
+
+		// Four bilinear taps one texel off the center average 4x4 source texels.
+		const char* const downsampleFragmentShader =
+			"precision mediump float;\n"
+			"uniform sampler2D g_texture;\n"
+			"uniform vec2 g_texelSize;\n"
+			"uniform float g_param0;\n"
+			"varying vec2 g_vTexCoord;\n"
+			"void main()\n"
+			"{\n"
+			"	vec3 c = texture2D(g_texture, g_vTexCoord + vec2(-1.0, -1.0)*g_texelSize).rgb;\n"
+			"	c += texture2D(g_texture, g_vTexCoord + vec2( 1.0, -1.0)*g_texelSize).rgb;\n"
+			"	c += texture2D(g_texture, g_vTexCoord + vec2(-1.0,  1.0)*g_texelSize).rgb;\n"
+			"	c += texture2D(g_texture, g_vTexCoord + vec2( 1.0,  1.0)*g_texelSize).rgb;\n"
+			"	c *= 0.25;\n"
+			"#ifdef THRESHOLD\n"
+			"	float l = max(max(c.r, c.g), c.b);\n"
+			"	c *= max(l - g_param0, 0.0) / max(l, 0.0001);\n"
+			"#endif\n"
+			"	gl_FragColor = vec4(c, 1.0);\n"
+			"}\n";
+
+		// Bloom composite and Reinhard tonemapping. Alpha is luma for FXAA.
+		const char* const compositeFragmentShader =
+			"precision mediump float;\n"
+			"uniform sampler2D g_texture;\n"
+			"uniform sampler2D g_texture2;\n"
+			"uniform float g_param0;\n"
+			"uniform float g_param1;\n"
+			"varying vec2 g_vTexCoord;\n"
+			"void main()\n"
+			"{\n"
+			"	vec3 c = texture2D(g_texture, g_vTexCoord).rgb;\n"
+			"#ifdef BLOOM\n"
+			"	c += texture2D(g_texture2, g_vTexCoord).rgb * g_param0;\n"
+			"#endif\n"
+			"#ifdef TONEMAP\n"
+			"	c *= g_param1;\n"
+			"	c = c / (1.0 + c);\n"
+			"#endif\n"
+			"	gl_FragColor = vec4(c, dot(c, vec3(0.299, 0.587, 0.114)));\n"
+			"}\n";
+
+		// FXAA with luma in alpha (Timothy Lottes, FXAA 3.11 console version simplified).
+		const char* const fxaaFragmentShader =
+			"precision mediump float;\n"
+			"uniform sampler2D g_texture;\n"
+			"uniform vec2 g_texelSize;\n"
+			"varying vec2 g_vTexCoord;\n"
+			"#define FXAA_REDUCE_MIN (1.0/128.0)\n"
+			"#define FXAA_REDUCE_MUL (1.0/8.0)\n"
+			"#define FXAA_SPAN_MAX 8.0\n"
+			"void main()\n"
+			"{\n"
+			"	float lumaNW = texture2D(g_texture, g_vTexCoord + vec2(-1.0, -1.0)*g_texelSize).a;\n"
+			"	float lumaNE = texture2D(g_texture, g_vTexCoord + vec2( 1.0, -1.0)*g_texelSize).a;\n"
+			"	float lumaSW = texture2D(g_texture, g_vTexCoord + vec2(-1.0,  1.0)*g_texelSize).a;\n"
+			"	float lumaSE = texture2D(g_texture, g_vTexCoord + vec2( 1.0,  1.0)*g_texelSize).a;\n"
+			"	vec4 rgbM = texture2D(g_texture, g_vTexCoord);\n"
+			"	float lumaMin = min(rgbM.a, min(min(lumaNW, lumaNE), min(lumaSW, lumaSE)));\n"
+			"	float lumaMax = max(rgbM.a, max(max(lumaNW, lumaNE), max(lumaSW, lumaSE)));\n"
+			"	vec2 dir = vec2(-((lumaNW + lumaNE) - (lumaSW + lumaSE)), (lumaNW + lumaSW) - (lumaNE + lumaSE));\n"
+			"	float dirReduce = max((lumaNW + lumaNE + lumaSW + lumaSE)*(0.25*FXAA_REDUCE_MUL), FXAA_REDUCE_MIN);\n"
+			"	float rcpDirMin = 1.0/(min(abs(dir.x), abs(dir.y)) + dirReduce);\n"
+			"	dir = clamp(dir*rcpDirMin, -FXAA_SPAN_MAX, FXAA_SPAN_MAX)*g_texelSize;\n"
+			"	vec3 rgbA = 0.5*(texture2D(g_texture, g_vTexCoord + dir*(1.0/3.0 - 0.5)).rgb\n"
+			"		+ texture2D(g_texture, g_vTexCoord + dir*(2.0/3.0 - 0.5)).rgb);\n"
+			"	vec3 rgbB = rgbA*0.5 + 0.25*(texture2D(g_texture, g_vTexCoord - dir*0.5).rgb\n"
+			"		+ texture2D(g_texture, g_vTexCoord + dir*0.5).rgb);\n"
+			"	float lumaB = dot(rgbB, vec3(0.299, 0.587, 0.114));\n"
+			"	gl_FragColor = vec4((lumaB < lumaMin || lumaB > lumaMax) ? rgbA : rgbB, 1.0);\n"
+			"}\n";
+
+		// Varyings: center + one vec4 (both sides) per tap. ES 2.0 guarantees 8.
+		const int maxBlurTaps = 7;
+
+		std::string formatFloat(float f)
+		{
+			char buf[32];
+			snprintf(buf, sizeof(buf), "%.8f", f);
+			return buf;
+		}
+
+		std::string formatInt(int i)
+		{
+			char buf[16];
+			snprintf(buf, sizeof(buf), "%d", i);
+			return buf;
+		}
+	}
+
+	PostProcessSettings::PostProcessSettings()
+		: bloom(true)
+		, bloomThreshold(0.8f)
+		, bloomIntensity(0.6f)
+		, bloomDownsample(4)
+		, bloomKernelSize(13)
+		, bloomSigma(0.0f)
+		, tonemap(true)
+		, exposure(1.0f)
+		, fxaa(true)
+	{
+	}
+
+	PostProcessChain::PostProcessChain(RenderTargetPool* pool, const PostProcessSettings& settings)
+		: Object()
+		, m_pool(pool)
+		, m_settings(settings)
+		, m_outputFBO(0)
+		, m_numPasses(0)
+	{
+		// One triangle covering the screen, so there is no diagonal seam between two triangles.
+		const float vertices[] = { -1.0f, -1.0f, 3.0f, -1.0f, -1.0f, 3.0f };
+		glGenBuffers(1, &m_vbo);
+		glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	PostProcessChain::~PostProcessChain()
+	{
+		glDeleteBuffers(1, &m_vbo);
+	}
+
+	int PostProcessChain::computeLinearBlurTaps(int kernelSize, float sigma, std::vector<float>& offsets, std::vector<float>& weights)
+	{
+		assert(kernelSize >= 1 && (kernelSize & 1));
+		std::vector<float> kernel(kernelSize);
+		slmath::getGaussianBlurKernel1D(kernelSize, sigma, &kernel[0], kernel.size());
+
+		const int r = (kernelSize - 1) / 2;
+		offsets.clear();
+		weights.clear();
+		offsets.push_back(0.0f);
+		weights.push_back(kernel[r]);
+
+		// Bilinear tap between texels i and i+1, placed by their kernel weights w1 and w2,
+		// returns (w1*t[i] + w2*t[i+1]) / (w1 + w2). Its weight is w1 + w2.
+		for( int i = 1; i <= r; i += 2 )
+		{
+			const float w1 = kernel[r + i];
+			const float w2 = i + 1 <= r ? kernel[r + i + 1] : 0.0f;
+			const float w = w1 + w2;
+			offsets.push_back((float(i)*w1 + float(i + 1)*w2) / w);
+			weights.push_back(w);
+		}
+
+		return (int)offsets.size();
+	}
+
+	PostProcessChain::Program PostProcessChain::createProgram(const std::string& vertexShader, const std::string& fragmentShader)
+	{
+		SHADER_ATTRIBUTE attributes[] = { { "g_vPosition", ATTRIB_POSITION } };
+
+		Program p;
+		p.shader = new Shader(vertexShader.c_str(), fragmentShader.c_str(), attributes, 1, false);
+		const GLuint program = p.shader->getProgram();
+		p.texture = glGetUniformLocation(program, "g_texture");
+		p.texture2 = glGetUniformLocation(program, "g_texture2");
+		p.texelSize = glGetUniformLocation(program, "g_texelSize");
+		p.param0 = glGetUniformLocation(program, "g_param0");
+		p.param1 = glGetUniformLocation(program, "g_param1");
+		return p;
+	}
+
+	PostProcessChain::Program& PostProcessChain::getBlurProgram(int kernelSize, float sigma)
+	{
+		for( size_t i = 0; i < m_blurPrograms.size(); ++i )
+		{
+			if( m_blurPrograms[i].kernelSize == kernelSize && m_blurPrograms[i].sigma == sigma )
+			{
+				return m_blurPrograms[i].program;
+			}
+		}
+
+		std::vector<float> offsets;
+		std::vector<float> weights;
+		const int numTaps = computeLinearBlurTaps(kernelSize, sigma, offsets, weights);
+		assert(numTaps <= maxBlurTaps);
+
+		// Tap coordinates are computed in the vertex shader, so the fragment shader
+		// has no dependent texture reads. Weights are compiled in as constants.
+		std::string vs =
+			"attribute vec2 g_vPosition;\n"
+			"uniform vec2 g_texelSize;\n"
+			"varying vec2 g_vTexCoord;\n";
+		std::string fs =
+			"precision mediump float;\n"
+			"uniform sampler2D g_texture;\n"
+			"varying vec2 g_vTexCoord;\n";
+
+		for( int i = 1; i < numTaps; ++i )
+		{
+			std::string decl = "varying vec4 g_vTap" + formatInt(i) + ";\n";
+			vs += decl;
+			fs += decl;
+		}
+
+		vs +=
+			"void main()\n"
+			"{\n"
+			"	g_vTexCoord = g_vPosition*0.5 + 0.5;\n";
+		fs +=
+			"void main()\n"
+			"{\n"
+			"	vec4 c = texture2D(g_texture, g_vTexCoord) * " + formatFloat(weights[0]) + ";\n";
+
+		for( int i = 1; i < numTaps; ++i )
+		{
+			const std::string tap = "g_vTap" + formatInt(i);
+			const std::string offset = formatFloat(offsets[i]);
+			vs += "	" + tap + " = vec4(g_vTexCoord + g_texelSize*" + offset + ", g_vTexCoord - g_texelSize*" + offset + ");\n";
+			fs += "	c += (texture2D(g_texture, " + tap + ".xy) + texture2D(g_texture, " + tap + ".zw)) * " + formatFloat(weights[i]) + ";\n";
+		}
+
+		vs +=
+			"	gl_Position = vec4(g_vPosition, 0.0, 1.0);\n"
+			"}\n";
+		fs +=
+			"	gl_FragColor = c;\n"
+			"}\n";
+
+		BlurProgram bp;
+		bp.kernelSize = kernelSize;
+		bp.sigma = sigma;
+		bp.program = createProgram(vs, fs);
+		m_blurPrograms.push_back(bp);
+		return m_blurPrograms.back().program;
+	}
+
+	void PostProcessChain::begin(RenderTarget* target)
+	{
+		if( target )
+		{
+			target->bind();
+
+			// Every pixel is overwritten, so previous contents need not be loaded to tile memory.
+			target->discard(RenderTarget::DISCARD_ALL);
+		}
+		else
+		{
+			glBindFramebuffer(GL_FRAMEBUFFER, m_outputFBO);
+		}
+	}
+
+	void PostProcessChain::drawPass(Program& program, Texture* texture, float texelX, float texelY, Texture* texture2,
+		float param0, float param1, RenderTarget* target, int width, int height)
+	{
+		begin(target);
+		glViewport(0, 0, width, height);
+
+		program.shader->bind();
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, texture->getTextureId());
+		glUniform1i(program.texture, 0);
+
+		if( texture2 && program.texture2 >= 0 )
+		{
+			glActiveTexture(GL_TEXTURE1);
+			glBindTexture(GL_TEXTURE_2D, texture2->getTextureId());
+			glUniform1i(program.texture2, 1);
+			glActiveTexture(GL_TEXTURE0);
+		}
+
+		if( program.texelSize >= 0 )
+		{
+			glUniform2f(program.texelSize, texelX, texelY);
+		}
+
+		if( program.param0 >= 0 )
+		{
+			glUniform1f(program.param0, param0);
+		}
+
+		if( program.param1 >= 0 )
+		{
+			glUniform1f(program.param1, param1);
+		}
+
+		glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+		glEnableVertexAttribArray(ATTRIB_POSITION);
+		glVertexAttribPointer(ATTRIB_POSITION, 2, GL_FLOAT, GL_FALSE, 0, 0);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+		glDisableVertexAttribArray(ATTRIB_POSITION);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		++m_numPasses;
+	}
+
+	void PostProcessChain::blurPass(Texture* src, int width, int height, RenderTarget* dst, int kernelSize, float sigma, bool horizontal)
+	{
+		Program& program = getBlurProgram(kernelSize, sigma);
+		const float texelX = horizontal ? 1.0f / float(width) : 0.0f;
+		const float texelY = horizontal ? 0.0f : 1.0f / float(height);
+		drawPass(program, src, texelX, texelY, 0, 0.0f, 0.0f, dst, width, height);
+	}
+
+	void PostProcessChain::render(Texture* scene, int width, int height, RenderTarget* output)
+	{
+		m_numPasses = 0;
+		glGetIntegerv(GL_FRAMEBUFFER_BINDING, &m_outputFBO);
+		glDisable(GL_DEPTH_TEST);
+		glDisable(GL_BLEND);
+		glDisable(GL_CULL_FACE);
+
+		RenderTarget* bloom = 0;
+		if( m_settings.bloom )
+		{
+			int bw = slmath::max(width / 2, 1);
+			int bh = slmath::max(height / 2, 1);
+			if( !m_brightPass.shader )
+			{
+				m_brightPass = createProgram(fullScreenVertexShader, std::string("#define THRESHOLD\n") + downsampleFragmentShader);
+			}
+
+			bloom = m_pool->acquire(bw, bh, false);
+			drawPass(m_brightPass, scene, 1.0f / float(width), 1.0f / float(height), 0, m_settings.bloomThreshold, 0.0f, bloom, bw, bh);
+
+			if( m_settings.bloomDownsample >= 4 )
+			{
+				if( !m_downsample.shader )
+				{
+					m_downsample = createProgram(fullScreenVertexShader, downsampleFragmentShader);
+				}
+
+				RenderTarget* quarter = m_pool->acquire(slmath::max(bw / 2, 1), slmath::max(bh / 2, 1), false);
+				drawPass(m_downsample, bloom->getColorBuffer(), 1.0f / float(bw), 1.0f / float(bh), 0, 0.0f, 0.0f, quarter, quarter->getWidth(), quarter->getHeight());
+				m_pool->release(bloom);
+				bloom = quarter;
+				bw = quarter->getWidth();
+				bh = quarter->getHeight();
+			}
+
+			RenderTarget* tmp = m_pool->acquire(bw, bh, false);
+			blurPass(bloom->getColorBuffer(), bw, bh, tmp, m_settings.bloomKernelSize, m_settings.bloomSigma, true);
+			blurPass(tmp->getColorBuffer(), bw, bh, bloom, m_settings.bloomKernelSize, m_settings.bloomSigma, false);
+			m_pool->release(tmp);
+		}
+
+		const int variant = (bloom ? 1 : 0) + (m_settings.tonemap ? 2 : 0);
+		Program& composite = m_composite[variant];
+		if( !composite.shader )
+		{
+			std::string defines;
+			defines += bloom ? "#define BLOOM\n" : "";
+			defines += m_settings.tonemap ? "#define TONEMAP\n" : "";
+			composite = createProgram(fullScreenVertexShader, defines + compositeFragmentShader);
+		}
+
+		Texture* bloomTexture = bloom ? bloom->getColorBuffer() : 0;
+		const float texelX = 1.0f / float(width);
+		const float texelY = 1.0f / float(height);
+		if( m_settings.fxaa )
+		{
+			if( !m_fxaa.shader )
+			{
+				m_fxaa = createProgram(fullScreenVertexShader, fxaaFragmentShader);
+			}
+
+			RenderTarget* ldr = m_pool->acquire(width, height, false);
+			drawPass(composite, scene, texelX, texelY, bloomTexture, m_settings.bloomIntensity, m_settings.exposure, ldr, width, height);
+			if( bloom )
+			{
+				m_pool->release(bloom);
+			}
+
+			drawPass(m_fxaa, ldr->getColorBuffer(), texelX, texelY, 0, 0.0f, 0.0f, output, width, height);
+			m_pool->release(ldr);
+		}
+		else
+		{
+			drawPass(composite, scene, texelX, texelY, bloomTexture, m_settings.bloomIntensity, m_settings.exposure, output, width, height);
+			if( bloom )
+			{
+				m_pool->release(bloom);
+			}
+		}
+
+		// Passes bind targets one after another, so output was bound over an intermediate
+		// target. Restore the frame buffer, which was bound when the chain started.
+		if( output )
+		{
+			output->unbind();
+			glBindFramebuffer(GL_FRAMEBUFFER, m_outputFBO);
+		}
+	}
+
+	void PostProcessChain::blur(Texture* src, RenderTarget* dst, int kernelSize, float sigma)
+	{
+		m_numPasses = 0;
+		glGetIntegerv(GL_FRAMEBUFFER_BINDING, &m_outputFBO);
+		glDisable(GL_DEPTH_TEST);
+		glDisable(GL_BLEND);
+		glDisable(GL_CULL_FACE);
+
+		const int width = dst->getWidth();
+		const int height = dst->getHeight();
+		RenderTarget* tmp = m_pool->acquire(width, height, false);
+		blurPass(src, width, height, tmp, kernelSize, sigma, true);
+		blurPass(tmp->getColorBuffer(), width, height, dst, kernelSize, sigma, false);
+		m_pool->release(tmp);
+		dst->unbind();
+		glBindFramebuffer(GL_FRAMEBUFFER, m_outputFBO);
+	}
+
+	PostProcessSettings& PostProcessChain::getSettings()
+	{
+		return m_settings;
+	}
+
+	int PostProcessChain::getNumPasses() const
+	{
+		return m_numPasses;
+	}
+}
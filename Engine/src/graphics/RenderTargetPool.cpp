@@ -0,0 +1,184 @@
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Copyright (c) 2013 Mikko Romppainen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in the
+// Software without restriction, including without limitation the rights to use, copy,
+// modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+#include <graphics/RenderTargetPool.h>
+#include <graphics/OpenGLES/es_ext.h>
+#include <es_assert.h>
+
+namespace graphics
+{
+	RenderTargetPool::RenderTargetPool(int maxIdleFrames)
+		: Object()
+		, m_maxIdleFrames(maxIdleFrames)
+		, m_frame(0)
+	{
+	}
+
+	RenderTargetPool::~RenderTargetPool()
+	{
+		assert(getNumAcquired() == 0);
+	}
+
+	RenderTarget* RenderTargetPool::acquire(int width, int height, bool depthBuffer, GLenum format, GLenum type, int samples)
+	{
+		for( size_t i = 0; i < m_entries.size(); ++i )
+		{
+			Entry& e = m_entries[i];
+			if( !e.acquired && e.width == width && e.height == height && e.depthBuffer == depthBuffer
+				&& e.format == format && e.type == type && e.samples == samples )
+			{
+				e.acquired = true;
+				e.lastUsedFrame = m_frame;
+				return e.target.ptr();
+			}
+		}
+
+		Entry e;
+		e.target = new RenderTarget(width, height, depthBuffer, format, type, samples);
+		e.width = width;
+		e.height = height;
+		e.depthBuffer = depthBuffer;
+		e.format = format;
+		e.type = type;
+		e.samples = samples;
+
+		// Resolved color texture, plus multisampled buffers. Samples of implicitly
+		// resolved targets stay in tile memory, but drivers may still allocate them.
+		const int colorBytes = getBytesPerPixel(format, type);
+		const int numSamples = e.target->getSamples();
+		e.bytes = width*height*colorBytes;
+		if( numSamples > 1 )
+		{
+			e.bytes += width*height*numSamples*(colorBytes + (depthBuffer ? 2 : 0));
+		}
+		else if( depthBuffer )
+		{
+			e.bytes += width*height*2;
+		}
+		e.acquired = true;
+		e.lastUsedFrame = m_frame;
+		m_entries.push_back(e);
+		return e.target.ptr();
+	}
+
+	void RenderTargetPool::release(RenderTarget* target)
+	{
+		for( size_t i = 0; i < m_entries.size(); ++i )
+		{
+			if( m_entries[i].target.ptr() == target )
+			{
+				assert(m_entries[i].acquired);
+				m_entries[i].acquired = false;
+				m_entries[i].lastUsedFrame = m_frame;
+				return;
+			}
+		}
+
+		assert(0); // Target is not from this pool
+	}
+
+	void RenderTargetPool::nextFrame()
+	{
+		++m_frame;
+		for( size_t i = 0; i < m_entries.size(); )
+		{
+			const Entry& e = m_entries[i];
+			if( !e.acquired && m_frame - e.lastUsedFrame > m_maxIdleFrames )
+			{
+				m_entries[i] = m_entries.back();
+				m_entries.pop_back();
+			}
+			else
+			{
+				++i;
+			}
+		}
+	}
+
+	void RenderTargetPool::clear()
+	{
+		for( size_t i = 0; i < m_entries.size(); )
+		{
+			if( !m_entries[i].acquired )
+			{
+				m_entries[i] = m_entries.back();
+				m_entries.pop_back();
+			}
+			else
+			{
+				++i;
+			}
+		}
+	}
+
+	int RenderTargetPool::getNumTargets() const
+	{
+		return (int)m_entries.size();
+	}
+
+	int RenderTargetPool::getNumAcquired() const
+	{
+		int count = 0;
+		for( size_t i = 0; i < m_entries.size(); ++i )
+		{
+			if( m_entries[i].acquired )
+			{
+				++count;
+			}
+		}
+		return count;
+	}
+
+	int RenderTargetPool::getMemoryUsage() const
+	{
+		int bytes = 0;
+		for( size_t i = 0; i < m_entries.size(); ++i )
+		{
+			bytes += m_entries[i].bytes;
+		}
+		return bytes;
+	}
+
+	int RenderTargetPool::getBytesPerPixel(GLenum format, GLenum type)
+	{
+		if( type == GL_UNSIGNED_SHORT_5_6_5 || type == GL_UNSIGNED_SHORT_4_4_4_4 || type == GL_UNSIGNED_SHORT_5_5_5_1 )
+		{
+			return 2;
+		}
+
+		int channels = 4;
+		switch( format )
+		{
+		case GL_ALPHA:
+		case GL_LUMINANCE:			channels = 1; break;
+		case GL_LUMINANCE_ALPHA:	channels = 2; break;
+		case GL_RGB:				channels = 3; break;
+		default:					channels = 4; break;
+		}
+
+		switch( type )
+		{
+		case GL_HALF_FLOAT_OES:	return channels*2;
+		case GL_FLOAT:			return channels*4;
+		default:				return channels;
+		}
+	}
+}
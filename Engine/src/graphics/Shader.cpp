@@ -25,15 +25,15 @@
 #include <slmath/mat4.h>
 #include <vector>
 #include <string>
-#include <core/FileStream.h>
+#include <string.h>
+#include <core/FileSystem.h>
 
 namespace graphics
 {
 	namespace
 	{
-		bool FrmLoadFile(const char* strFileName, void** ppData)
+		bool FrmLoadFile(core::Stream* fs, void** ppData)
 		{
-			core::Ref<core::FileStream> fs = new core::FileStream(strFileName, core::FileStream::READ_ONLY);
 			int size = fs->available();
 			if (0 == size)
 			{
@@ -67,9 +67,10 @@ namespace graphics
 		// Name: FrmCompileShaderFromString()
 		// Desc: 
 		//--------------------------------------------------------------------------------------
-		bool FrmCompileShaderFromString(const char* strShaderSource, GLuint hShaderHandle)
+		bool FrmCompileShaderFromString(const char* strShaderSource, GLuint hShaderHandle, bool assertOnError = true, GLint nSourceLength = -1)
 		{
-			glShaderSource(hShaderHandle, 1, &strShaderSource, NULL);
+			// Negative length means null terminated source.
+			glShaderSource(hShaderHandle, 1, &strShaderSource, nSourceLength < 0 ? NULL : &nSourceLength);
 			glCompileShader(hShaderHandle);
 
 			// Check for compile success
@@ -81,8 +82,8 @@ namespace graphics
 				GLint nLength;
 				glGetShaderInfoLog(hShaderHandle, 1024, &nLength, strInfoLog);
 				printf("Unable to compile shader: %s", strInfoLog);
-				printf(strShaderSource);
-				assert(0);
+				printf("%.*s", nSourceLength < 0 ? (int)strlen(strShaderSource) : (int)nSourceLength, strShaderSource);
+				assert(!assertOnError);
 				return false;
 			}
 
@@ -135,20 +136,37 @@ namespace graphics
 
 		bool FrmLoadShaderObjectFromFile(const char* strFileName, GLuint hShaderHandle)
 		{
-			char* strShaderSource;
-			if (!FrmLoadFile(strFileName, (void**)&strShaderSource))
+			core::Ref<core::Stream> fs = core::FileSystem::openFile(strFileName);
+			if (fs == 0)
 			{
-				printf("ERROR: Could not load shader file");
+				printf("ERROR: Could not open shader file %s", strFileName);
 				return false;
 			}
 
-			bool bResult = FrmCompileShaderFromString(strShaderSource, hShaderHandle);
+			bool bResult = false;
+			if (fs->data() != 0)
+			{
+				// Compile straight from the mapped file or pack, source length is passed to GL.
+				bResult = FrmCompileShaderFromString((const char*)fs->data(), hShaderHandle, true, fs->size());
+			}
+			else
+			{
+				char* strShaderSource;
+				if (!FrmLoadFile(fs.ptr(), (void**)&strShaderSource))
+				{
+					printf("ERROR: Could not load shader file");
+					return false;
+				}
+
+				bResult = FrmCompileShaderFromString(strShaderSource, hShaderHandle);
+				FrmUnloadFile(strShaderSource);
+			}
+
 			if (!bResult)
 			{
 				printf("ERROR: Could compile shader file");
 			}
 
-			FrmUnloadFile(strShaderSource);
 			return bResult;
 		}
 
@@ -213,9 +231,19 @@ namespace graphics
 		int numAttributes, bool compileFromFile)
 		: Object()
 		, m_program(0)
+		, m_revision(0)
 	{
+		for (int i = 0; i < numAttributes; ++i)
+		{
+			m_attributeNames.push_back(attributes[i].strName);
+			m_attributeLocations.push_back(attributes[i].nLocation);
+		}
+
 		if (compileFromFile)
 		{
+			m_vertexShaderFileName = strVertexShaderFileName;
+			m_fragmentShaderFileName = strFragmentShaderFileName;
+
 			FrmCompileShaderProgramFromFile(strVertexShaderFileName,
 				strFragmentShaderFileName, &m_program, attributes, numAttributes);
 		}
@@ -229,6 +257,10 @@ namespace graphics
 
 	Shader::~Shader()
 	{
+		if (m_program)
+		{
+			glDeleteProgram(m_program);
+		}
 	}
 
 	GLuint Shader::getProgram() const
@@ -241,10 +273,56 @@ namespace graphics
 		glUseProgram(m_program);
 	}
 
+	bool Shader::reload(const char* const strVertexShader, const char* const strFragmentShader)
+	{
+		std::vector<SHADER_ATTRIBUTE> attributes(m_attributeNames.size());
+		for (size_t i = 0; i < attributes.size(); ++i)
+		{
+			attributes[i].strName = m_attributeNames[i].c_str();
+			attributes[i].nLocation = m_attributeLocations[i];
+		}
+
+		GLuint program = 0;
+		if (!compileShaderProgram(strVertexShader, strFragmentShader, &program,
+			attributes.empty() ? 0 : &attributes[0], attributes.size(), false))
+		{
+			// Keep using the old program
+			return false;
+		}
+
+		GLint current = 0;
+		glGetIntegerv(GL_CURRENT_PROGRAM, &current);
+		if ((GLuint)current == m_program)
+		{
+			glUseProgram(program);
+		}
+
+		glDeleteProgram(m_program);
+		m_program = program;
+		++m_revision;
+		return true;
+	}
+
+	int Shader::getRevision() const
+	{
+		return m_revision;
+	}
+
+	const std::string& Shader::getVertexShaderFileName() const
+	{
+		return m_vertexShaderFileName;
+	}
+
+	const std::string& Shader::getFragmentShaderFileName() const
+	{
+		return m_fragmentShaderFileName;
+	}
+
 
 	ShaderUniforms::ShaderUniforms(Shader* shader)
 		: m_shader(shader)
 		, m_initDone(false)
+		, m_shaderRevision(0)
 	{
 		assert(shader != 0);
 	}
@@ -255,10 +333,12 @@ namespace graphics
 
 	void ShaderUniforms::bind()
 	{
-		if (!m_initDone)
+		// Uniform locations must be queried again, if shader program has been reloaded.
+		if (!m_initDone || m_shaderRevision != m_shader->getRevision())
 		{
 			getUniformLocations(m_shader);
 			m_initDone = true;
+			m_shaderRevision = m_shader->getRevision();
 		}
 
 		bind(m_shader);
@@ -279,20 +359,21 @@ namespace graphics
 		const char* strFragmentShader,
 		GLuint* pShaderProgramHandle,
 		const SHADER_ATTRIBUTE* pAttributes,
-		size_t nNumAttributes)
+		size_t nNumAttributes,
+		bool assertOnError)
 	{
 		// Create the object handles
 		GLuint hVertexShader = glCreateShader(GL_VERTEX_SHADER);
 		GLuint hFragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
 
 		// Compile the shaders
-		if (!FrmCompileShaderFromString(strVertexShader, hVertexShader))
+		if (!FrmCompileShaderFromString(strVertexShader, hVertexShader, assertOnError))
 		{
 			glDeleteShader(hVertexShader);
 			glDeleteShader(hFragmentShader);
 			return false;
 		}
-		if (!FrmCompileShaderFromString(strFragmentShader, hFragmentShader))
+		if (!FrmCompileShaderFromString(strFragmentShader, hFragmentShader, assertOnError))
 		{
 			glDeleteShader(hVertexShader);
 			glDeleteShader(hFragmentShader);
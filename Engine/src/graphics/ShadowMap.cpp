@@ -0,0 +1,459 @@
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Copyright (c) 2013 Mikko Romppainen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in the
+// Software without restriction, including without limitation the rights to use, copy,
+// modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+#include <graphics/ShadowMap.h>
+#include <es_assert.h>
+#include <math.h>
+#include <float.h>
+
+namespace graphics
+{
+	namespace
+	{
+		const char* const depthVertexShader =
+			"uniform mat4 g_matModelViewProj;\n"
+			"attribute vec4 g_vPositionOS;\n"
+			"void main()\n"
+			"{\n"
+			"	gl_Position = g_matModelViewProj * g_vPositionOS;\n"
+			"}\n";
+
+		const char* const depthFragmentShader =
+			"precision mediump float;\n"
+			"void main()\n"
+			"{\n"
+			"	gl_FragColor = vec4(1.0);\n"
+			"}\n";
+
+		const char* const shaderFunctions =
+			"//\n"
+			"// Shadow map sampling helpers. Transform world space position with the shadow\n"
+			"// matrix of the cascade (preferably in vertex shader):\n"
+			"//   vec4 coord = g_matShadow0 * vec4(positionWS, 1.0);\n"
+			"//   float lit = shadowPCF(g_shadowMap0, coord.xyz, g_shadowMapSize);\n"
+			"// ES 2.0 can not index sampler arrays dynamically, so select the cascade with\n"
+			"// shadowCascadeIndex and branch to the matching sampler.\n"
+			"// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=\n"
+			"// highp is optional in ES 2.0 fragment shaders.\n"
+			"#ifdef GL_FRAGMENT_PRECISION_HIGH\n"
+			"#define SHADOW_HIGHP highp\n"
+			"#else\n"
+			"#define SHADOW_HIGHP mediump\n"
+			"#endif\n"
+			"uniform SHADOW_HIGHP vec4 g_shadowSplits;		// CascadedShadowMap::getSplitDistances\n"
+			"uniform SHADOW_HIGHP vec2 g_shadowMapSize;	// (resolution, 1.0 / resolution)\n"
+			"\n"
+			"// Returns cascade index for positive view space depth (numCascades = not shadowed).\n"
+			"float shadowCascadeIndex(SHADOW_HIGHP float viewDepth)\n"
+			"{\n"
+			"	return dot(step(g_shadowSplits, vec4(viewDepth)), vec4(1.0));\n"
+			"}\n"
+			"\n"
+			"// 1.0, if lit.\n"
+			"float shadowCompare(sampler2D shadowMap, SHADOW_HIGHP vec2 uv, SHADOW_HIGHP float depth)\n"
+			"{\n"
+			"	return step(depth, texture2D(shadowMap, uv).r);\n"
+			"}\n"
+			"\n"
+			"// Compares 2x2 texels and filters the results bilinearly.\n"
+			"float shadowBilinear(sampler2D shadowMap, SHADOW_HIGHP vec3 coord, SHADOW_HIGHP vec2 size)\n"
+			"{\n"
+			"	SHADOW_HIGHP vec2 texel = coord.xy*size.x - 0.5;\n"
+			"	SHADOW_HIGHP vec2 f = fract(texel);\n"
+			"	SHADOW_HIGHP vec2 uv = (floor(texel) + 0.5)*size.y;\n"
+			"	float s00 = shadowCompare(shadowMap, uv, coord.z);\n"
+			"	float s10 = shadowCompare(shadowMap, uv + vec2(size.y, 0.0), coord.z);\n"
+			"	float s01 = shadowCompare(shadowMap, uv + vec2(0.0, size.y), coord.z);\n"
+			"	float s11 = shadowCompare(shadowMap, uv + vec2(size.y, size.y), coord.z);\n"
+			"	return mix(mix(s00, s10, f.x), mix(s01, s11, f.x), f.y);\n"
+			"}\n"
+			"\n"
+			"// Percentage closer filter: 4 bilinear taps, 3x3 texel tent filter.\n"
+			"float shadowPCF(sampler2D shadowMap, SHADOW_HIGHP vec3 coord, SHADOW_HIGHP vec2 size)\n"
+			"{\n"
+			"	SHADOW_HIGHP float o = 0.5*size.y;\n"
+			"	float s = shadowBilinear(shadowMap, coord + vec3(-o, -o, 0.0), size);\n"
+			"	s += shadowBilinear(shadowMap, coord + vec3( o, -o, 0.0), size);\n"
+			"	s += shadowBilinear(shadowMap, coord + vec3(-o,  o, 0.0), size);\n"
+			"	s += shadowBilinear(shadowMap, coord + vec3( o,  o, 0.0), size);\n"
+			"	return 0.25*s;\n"
+			"}\n";
+
+		// Split distances of unused cascades. Fits highp float and becomes infinity in mediump,
+		// which still compares greater than any depth.
+		const float noSplit = 1e30f;
+
+		// Maps x to [l,r], y to [b,t] and view space depth [n,f] to clip space [-1,1].
+		slmath::mat4 orthoOffCenter(float l, float r, float b, float t, float n, float f)
+		{
+			slmath::mat4 m;
+			m[0] = slmath::vec4(2.0f/(r-l), 0, 0, 0);
+			m[1] = slmath::vec4(0, 2.0f/(t-b), 0, 0);
+			m[2] = slmath::vec4(0, 0, -2.0f/(f-n), 0);
+			m[3] = slmath::vec4(-(r+l)/(r-l), -(t+b)/(t-b), -(f+n)/(f-n), 1);
+			return m;
+		}
+
+		// Perspective projection to clip space [-1,1] (perspectiveFovRH maps depth to [0,1]).
+		slmath::mat4 perspective(float fovy, float n, float f)
+		{
+			const float y = 1.0f / tanf(fovy*0.5f);
+			slmath::mat4 m;
+			m[0] = slmath::vec4(y, 0, 0, 0);
+			m[1] = slmath::vec4(0, y, 0, 0);
+			m[2] = slmath::vec4(0, 0, (f+n)/(n-f), -1);
+			m[3] = slmath::vec4(0, 0, 2.0f*f*n/(n-f), 0);
+			return m;
+		}
+
+		// Clip space [-1,1] to texture space [0,1].
+		slmath::mat4 textureBias()
+		{
+			slmath::mat4 m;
+			m[0] = slmath::vec4(0.5f, 0, 0, 0);
+			m[1] = slmath::vec4(0, 0.5f, 0, 0);
+			m[2] = slmath::vec4(0, 0, 0.5f, 0);
+			m[3] = slmath::vec4(0.5f, 0.5f, 0.5f, 1);
+			return m;
+		}
+
+		slmath::mat4 lightLookAt(const slmath::vec3& eye, const slmath::vec3& direction)
+		{
+			slmath::vec3 up = fabsf(direction.y) > 0.99f ? slmath::vec3(1, 0, 0) : slmath::vec3(0, 1, 0);
+			return slmath::lookAtRH(eye, eye + direction, up);
+		}
+
+		// Bounding box of box (min, max) transformed by m.
+		void transformBox(const slmath::mat4& m, const slmath::vec3& min, const slmath::vec3& max,
+			slmath::vec3& outMin, slmath::vec3& outMax)
+		{
+			outMin = slmath::vec3(FLT_MAX);
+			outMax = slmath::vec3(-FLT_MAX);
+			for( int i = 0; i < 8; ++i )
+			{
+				slmath::vec4 p(i & 1 ? max.x : min.x, i & 2 ? max.y : min.y, i & 4 ? max.z : min.z, 1);
+				slmath::vec3 t = (m * p).xyz();
+				outMin = slmath::min(outMin, t);
+				outMax = slmath::max(outMax, t);
+			}
+		}
+
+		// True, if box is completely outside one of the clip planes.
+		bool isBoxOutside(const slmath::mat4& viewProj, const slmath::vec3& min, const slmath::vec3& max)
+		{
+			int outside[6] = { 0, 0, 0, 0, 0, 0 };
+			for( int i = 0; i < 8; ++i )
+			{
+				slmath::vec4 c = viewProj * slmath::vec4(i & 1 ? max.x : min.x, i & 2 ? max.y : min.y, i & 4 ? max.z : min.z, 1);
+				outside[0] += c.x < -c.w;
+				outside[1] += c.x > c.w;
+				outside[2] += c.y < -c.w;
+				outside[3] += c.y > c.w;
+				outside[4] += c.z < -c.w;
+				outside[5] += c.z > c.w;
+			}
+
+			for( int i = 0; i < 6; ++i )
+			{
+				if( outside[i] == 8 )
+				{
+					return true;
+				}
+			}
+
+			return false;
+		}
+	}
+
+	ShadowSettings::ShadowSettings()
+		: resolution(1024)
+		, numCascades(3)
+		, shadowDistance(100.0f)
+		, splitLambda(0.75f)
+		, depthBiasFactor(2.0f)
+		, depthBiasUnits(4.0f)
+	{
+		updateInterval[0] = 1;
+		updateInterval[1] = 1;
+		updateInterval[2] = 2;
+		updateInterval[3] = 4;
+	}
+
+	CascadedShadowMap::CascadedShadowMap(const ShadowSettings& settings)
+		: Object()
+		, m_settings(settings)
+		, m_spot(false)
+		, m_lightPosition(0.0f)
+		, m_lightDirection(0, -1, 0)
+		, m_spotFovy(0.0f)
+		, m_spotRange(0.0f)
+		, m_frame(0)
+	{
+		assert(m_settings.numCascades >= 1 && m_settings.numCascades <= MAX_CASCADES);
+
+		for( int i = 0; i < MAX_CASCADES; ++i )
+		{
+			Cascade& c = m_cascades[i];
+			if( i < m_settings.numCascades )
+			{
+				// Color is never written, so use the smallest format.
+				c.target = new RenderTarget(m_settings.resolution, m_settings.resolution, true, GL_RGB, GL_UNSIGNED_SHORT_5_6_5);
+			}
+
+			c.matViewProj = slmath::mat4(1.0f);
+			c.matShadow = slmath::mat4(1.0f);
+			c.splitFar = noSplit;
+			c.lastUpdateFrame = -1;
+			c.numCastersRendered = 0;
+		}
+
+		SHADER_ATTRIBUTE attributes[] = { { "g_vPositionOS", ATTRIB_POSITION } };
+		m_shader = new Shader(depthVertexShader, depthFragmentShader, attributes, 1, false);
+		m_mvpLoc = glGetUniformLocation(m_shader->getProgram(), "g_matModelViewProj");
+	}
+
+	CascadedShadowMap::~CascadedShadowMap()
+	{
+	}
+
+	void CascadedShadowMap::setDirectionalLight(const slmath::vec3& direction)
+	{
+		m_spot = false;
+		m_lightDirection = slmath::normalize(direction);
+		for( int i = 0; i < MAX_CASCADES; ++i )
+		{
+			m_cascades[i].lastUpdateFrame = -1;
+		}
+	}
+
+	void CascadedShadowMap::setSpotLight(const slmath::vec3& position, const slmath::vec3& direction, float fovy, float range)
+	{
+		m_spot = true;
+		m_lightPosition = position;
+		m_lightDirection = slmath::normalize(direction);
+		m_spotFovy = fovy;
+		m_spotRange = range;
+		for( int i = 0; i < MAX_CASCADES; ++i )
+		{
+			m_cascades[i].lastUpdateFrame = -1;
+			m_cascades[i].splitFar = noSplit;
+		}
+	}
+
+	void CascadedShadowMap::update(const slmath::mat4& matView, const slmath::mat4& matProjection, float cameraNear, float cameraFar,
+		const std::vector<ShadowCaster>& casters, core::FrameArena* arena)
+	{
+		++m_frame;
+		core::FrameVector<int> visible((core::FrameAllocator<int>(arena)));
+		visible.reserve(casters.size());
+
+		if( m_spot )
+		{
+			Cascade& c = m_cascades[0];
+			if( c.lastUpdateFrame < 0 || m_frame - c.lastUpdateFrame >= m_settings.updateInterval[0] )
+			{
+				fitSpot(casters, visible);
+				render(0, casters, visible);
+			}
+			return;
+		}
+
+		// Half extents of the view frustum at unit distance.
+		const float tanX = 1.0f / matProjection[0][0];
+		const float tanY = 1.0f / matProjection[1][1];
+		const slmath::mat4 matCameraToWorld = slmath::inverse(matView);
+
+		const float n = cameraNear;
+		const float f = slmath::min(cameraFar, m_settings.shadowDistance);
+		const int numCascades = m_settings.numCascades;
+
+		float splitNear = n;
+		for( int i = 0; i < numCascades; ++i )
+		{
+			// Blend of logarithmic and uniform split scheme.
+			const float t = float(i + 1) / float(numCascades);
+			const float splitLog = n * powf(f / n, t);
+			const float splitUniform = n + (f - n) * t;
+			const float splitFar = m_settings.splitLambda * splitLog + (1.0f - m_settings.splitLambda) * splitUniform;
+
+			Cascade& c = m_cascades[i];
+			c.splitFar = splitFar;
+			if( c.lastUpdateFrame < 0 || m_frame - c.lastUpdateFrame >= m_settings.updateInterval[i] )
+			{
+				fitDirectional(i, matCameraToWorld, tanX, tanY, splitNear, splitFar, casters, visible);
+				render(i, casters, visible);
+			}
+
+			splitNear = splitFar;
+		}
+	}
+
+	void CascadedShadowMap::fitDirectional(int cascade, const slmath::mat4& matCameraToWorld, float tanX, float tanY,
+		float splitNear, float splitFar, const std::vector<ShadowCaster>& casters, core::FrameVector<int>& visible)
+	{
+		const slmath::mat4 matLightView = lightLookAt(slmath::vec3(0.0f), m_lightDirection);
+		const slmath::mat4 matCameraToLight = matLightView * matCameraToWorld;
+
+		// Light space bounds of the split.
+		slmath::vec3 min(FLT_MAX);
+		slmath::vec3 max(-FLT_MAX);
+		for( int i = 0; i < 8; ++i )
+		{
+			const float d = i & 4 ? splitFar : splitNear;
+			slmath::vec4 corner((i & 1 ? tanX : -tanX)*d, (i & 2 ? tanY : -tanY)*d, -d, 1);
+			slmath::vec3 p = (matCameraToLight * corner).xyz();
+			min = slmath::min(min, p);
+			max = slmath::max(max, p);
+		}
+
+		// Snap to texels, so shadow edges do not crawl, when the camera moves.
+		const float res = float(m_settings.resolution);
+		const float texelX = (max.x - min.x) / res;
+		const float texelY = (max.y - min.y) / res;
+		min.x = floorf(min.x / texelX) * texelX;
+		max.x = ceilf(max.x / texelX) * texelX;
+		min.y = floorf(min.y / texelY) * texelY;
+		max.y = ceilf(max.y / texelY) * texelY;
+
+		// Light looks towards -z: receivers are between depths nearDepth and farDepth.
+		float nearDepth = -max.z;
+		const float farDepth = -min.z;
+
+		// Keep casters overlapping the cascade, which are not behind all receivers.
+		// Casters between the light and the receivers extend the near plane.
+		visible.clear();
+		for( size_t i = 0; i < casters.size(); ++i )
+		{
+			slmath::vec3 cmin, cmax;
+			transformBox(matLightView, casters[i].boundsMin, casters[i].boundsMax, cmin, cmax);
+			if( cmax.x < min.x || cmin.x > max.x || cmax.y < min.y || cmin.y > max.y || -cmax.z > farDepth )
+			{
+				continue;
+			}
+
+			nearDepth = slmath::min(nearDepth, -cmax.z);
+			visible.push_back((int)i);
+		}
+
+		Cascade& c = m_cascades[cascade];
+		const slmath::mat4 matProj = orthoOffCenter(min.x, max.x, min.y, max.y, nearDepth, slmath::max(farDepth, nearDepth + 0.01f));
+		c.matViewProj = matProj * matLightView;
+		c.matShadow = textureBias() * c.matViewProj;
+	}
+
+	void CascadedShadowMap::fitSpot(const std::vector<ShadowCaster>& casters, core::FrameVector<int>& visible)
+	{
+		const slmath::mat4 matLightView = lightLookAt(m_lightPosition, m_lightDirection);
+		const float nearDepth = slmath::max(m_spotRange * 0.005f, 0.05f);
+		const slmath::mat4 matProj = perspective(m_spotFovy, nearDepth, m_spotRange);
+
+		Cascade& c = m_cascades[0];
+		c.matViewProj = matProj * matLightView;
+		c.matShadow = textureBias() * c.matViewProj;
+
+		visible.clear();
+		for( size_t i = 0; i < casters.size(); ++i )
+		{
+			if( !isBoxOutside(c.matViewProj, casters[i].boundsMin, casters[i].boundsMax) )
+			{
+				visible.push_back((int)i);
+			}
+		}
+	}
+
+	void CascadedShadowMap::render(int cascade, const std::vector<ShadowCaster>& casters, const core::FrameVector<int>& visible)
+	{
+		Cascade& c = m_cascades[cascade];
+		c.target->bind();
+
+		glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+		glEnable(GL_DEPTH_TEST);
+		glDepthMask(GL_TRUE);
+		glClear(GL_DEPTH_BUFFER_BIT);
+		glEnable(GL_POLYGON_OFFSET_FILL);
+		glPolygonOffset(m_settings.depthBiasFactor, m_settings.depthBiasUnits);
+
+		m_shader->bind();
+		for( size_t i = 0; i < visible.size(); ++i )
+		{
+			const ShadowCaster& caster = casters[visible[i]];
+			slmath::mat4 mvp = c.matViewProj * caster.matWorld;
+			glUniformMatrix4fv(m_mvpLoc, 1, GL_FALSE, &mvp[0][0]);
+			caster.mesh->render();
+		}
+
+		glDisable(GL_POLYGON_OFFSET_FILL);
+		glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+		// Only depth is sampled later.
+		c.target->unbind(RenderTarget::DISCARD_COLOR);
+
+		c.lastUpdateFrame = m_frame;
+		c.numCastersRendered = (int)visible.size();
+	}
+
+	int CascadedShadowMap::getNumCascades() const
+	{
+		return m_spot ? 1 : m_settings.numCascades;
+	}
+
+	Texture* CascadedShadowMap::getShadowMap(int cascade) const
+	{
+		assert(cascade >= 0 && cascade < getNumCascades());
+		return m_cascades[cascade].target->getDepthBuffer();
+	}
+
+	const slmath::mat4& CascadedShadowMap::getShadowMatrix(int cascade) const
+	{
+		assert(cascade >= 0 && cascade < getNumCascades());
+		return m_cascades[cascade].matShadow;
+	}
+
+	slmath::vec4 CascadedShadowMap::getSplitDistances() const
+	{
+		if( m_spot )
+		{
+			return slmath::vec4(noSplit, noSplit, noSplit, noSplit);
+		}
+
+		return slmath::vec4(m_cascades[0].splitFar, m_cascades[1].splitFar, m_cascades[2].splitFar, m_cascades[3].splitFar);
+	}
+
+	int CascadedShadowMap::getNumCastersRendered(int cascade) const
+	{
+		return m_cascades[cascade].numCastersRendered;
+	}
+
+	int CascadedShadowMap::getLastUpdateFrame(int cascade) const
+	{
+		return m_cascades[cascade].lastUpdateFrame;
+	}
+
+	ShadowSettings& CascadedShadowMap::getSettings()
+	{
+		return m_settings;
+	}
+
+	const char* CascadedShadowMap::getShaderFunctions()
+	{
+		return shaderFunctions;
+	}
+}
@@ -21,6 +21,14 @@
 // =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 #include <graphics/Texture.h>
 #include <graphics/Image.h>
+#include <graphics/TgaFormat.h>
+#include <graphics/PixelConvert.h>
+#include <graphics/KtxFormat.h>
+#include <graphics/Etc1.h>
+#include <graphics/OpenGLES/es_ext.h>
+#include <core/FileSystem.h>
+#include <string.h>
+#include <vector>
 //#include <core/log.h>
 
 namespace graphics
@@ -72,6 +80,101 @@ namespace graphics
 			return w==h && isNPot(w) && isNPot(h);
 
 		}
+
+		GLenum getFormatForBPP(int bpp)
+		{
+			switch( bpp )
+			{
+			case 1:		return GL_LUMINANCE;
+			case 2:		return GL_LUMINANCE_ALPHA;
+			case 3:		return GL_RGB;
+			default:	return GL_RGBA;
+			}
+		}
+
+		GLenum getImageFormat(Image* image)
+		{
+			return getFormatForBPP(image->getBPP());
+		}
+
+		// Sets filtering and wrapping of texture bound to GL_TEXTURE_2D. Generates mipmaps, if
+		// needed and generateMipmaps is true.
+		void setTexture2DParameters(Texture::FilteringMode filtering, Texture::WrappingMode wrapping, bool generateMipmaps = true)
+		{
+			// Trilinear filtering
+			if( filtering == Texture::TRILINEAR_FILTERING )
+			{
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_LINEAR);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+				if( generateMipmaps )
+				{
+					glGenerateMipmap(GL_TEXTURE_2D);
+				}
+			}
+
+			// Bilinear filtering
+			if( filtering == Texture::BILINEAR_FILTERING )
+			{
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+				if( generateMipmaps )
+				{
+					glGenerateMipmap(GL_TEXTURE_2D);
+				}
+			}
+
+			// Linear filtering
+			if( filtering == Texture::LINEAR_FILTERING )
+			{
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			}
+
+			// No filtering
+			if( filtering == Texture::NO_FILTERING )
+			{
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			}
+
+			// Repeat
+			if( wrapping == Texture::REPEAT )
+			{
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+			}
+
+			if( wrapping == Texture::CLAMP )
+			{
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			}
+		}
+
+		// Size of the staging buffer used to convert mapped TGA pixels before upload.
+		const int TGA_STAGING_SIZE = 64*1024;
+
+		bool isCompressedFormatSupported(GLenum format)
+		{
+			GLint numFormats = 0;
+			glGetIntegerv(GL_NUM_COMPRESSED_TEXTURE_FORMATS, &numFormats);
+			if( numFormats <= 0 )
+			{
+				return false;
+			}
+
+			std::vector<GLint> formats(numFormats);
+			glGetIntegerv(GL_COMPRESSED_TEXTURE_FORMATS, &formats[0]);
+			for( int i = 0; i < numFormats; ++i )
+			{
+				if( GLenum(formats[i]) == format )
+				{
+					return true;
+				}
+			}
+
+			return false;
+		}
 	}
 
 Texture::Texture()
@@ -111,123 +214,328 @@ Texture2D::Texture2D(int width, int height, GLint fmt, GLenum type, Texture::Fil
 	glTexImage2D(GL_TEXTURE_2D, 0, fmt, width, height, 0,  fmt, type, 0 );
 	checkOpenGL();
 
-	// Trilinear filtering
-	if( filtering == TRILINEAR_FILTERING )
-	{
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glGenerateMipmap(GL_TEXTURE_2D);
-	}
+	setTexture2DParameters(filtering, wrapping);
 
-	// Bilinear filtering
-	if( filtering == BILINEAR_FILTERING )
-	{
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glGenerateMipmap(GL_TEXTURE_2D);
-	}
+	glBindTexture(GL_TEXTURE_2D, boundTexture );
+}
 
-	// Linear filtering
-	if( filtering == LINEAR_FILTERING )
-	{
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	}
+Texture2D::Texture2D()
+: Texture()
+{
+}
 
-	// No filtering
-	if( filtering == NO_FILTERING )
+
+Texture2D::~Texture2D()
+{
+}
+
+void Texture2D::setData( Image* image, Texture::FilteringMode filtering, Texture::WrappingMode wrapping )
+{
+	setData(image->getData(), image->getWidth(), image->getHeight(), image->getBPP(), filtering, wrapping);
+}
+
+void Texture2D::setData( const uint8_t* pixels, int width, int height, int bytesPerPixel, Texture::FilteringMode filtering, Texture::WrappingMode wrapping )
+{
+	if( !isNpotSquare(width,height) )
 	{
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		printf("Image is not NPOT Square texture (w:%d, h:%d)", width, height);
 	}
 
-	// Repeat
-	if( wrapping == REPEAT )
+	GLuint boundTexture = 0;
+	glGetIntegerv(GL_TEXTURE_BINDING_2D, (GLint*) &boundTexture);
+	checkOpenGL();
+
+	GLint fmt = getFormatForBPP(bytesPerPixel);
+
+	glBindTexture(GL_TEXTURE_2D, getTextureId());
+	// Rows of 1 and 3 byte per pixel images are not 4 byte aligned
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, 0, fmt, width, height, 0,  fmt, GL_UNSIGNED_BYTE, pixels );
+	checkOpenGL();
+
+	// Texture allocated without pixels gets its mipmaps in setParameters after setSubData.
+	if( pixels )
 	{
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		setTexture2DParameters(filtering, wrapping);
 	}
 
-	if( wrapping == CLAMP )
+	glBindTexture(GL_TEXTURE_2D, boundTexture );
+}
+
+void Texture2D::allocate( int width, int height, int bytesPerPixel, int numLevels )
+{
+	GLuint boundTexture = 0;
+	glGetIntegerv(GL_TEXTURE_BINDING_2D, (GLint*) &boundTexture);
+
+	GLint fmt = getFormatForBPP(bytesPerPixel);
+	glBindTexture(GL_TEXTURE_2D, getTextureId());
+	for( int i = 0; i < numLevels; ++i )
 	{
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		int w = width >> i;
+		int h = height >> i;
+		glTexImage2D(GL_TEXTURE_2D, i, fmt, w > 0 ? w : 1, h > 0 ? h : 1, 0, fmt, GL_UNSIGNED_BYTE, 0);
 	}
+	checkOpenGL();
 
 	glBindTexture(GL_TEXTURE_2D, boundTexture );
 }
 
-Texture2D::Texture2D()
-: Texture()
+void Texture2D::setSubData( const uint8_t* pixels, int x, int y, int width, int height, int bytesPerPixel, int level )
 {
+	GLuint boundTexture = 0;
+	glGetIntegerv(GL_TEXTURE_BINDING_2D, (GLint*) &boundTexture);
+
+	GLenum fmt = getFormatForBPP(bytesPerPixel);
+	glBindTexture(GL_TEXTURE_2D, getTextureId());
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexSubImage2D(GL_TEXTURE_2D, level, x, y, width, height, fmt, GL_UNSIGNED_BYTE, pixels);
+	checkOpenGL();
+
+	glBindTexture(GL_TEXTURE_2D, boundTexture );
 }
 
+void Texture2D::setParameters( Texture::FilteringMode filtering, Texture::WrappingMode wrapping, bool generateMipmaps )
+{
+	GLuint boundTexture = 0;
+	glGetIntegerv(GL_TEXTURE_BINDING_2D, (GLint*) &boundTexture);
 
-Texture2D::~Texture2D()
+	glBindTexture(GL_TEXTURE_2D, getTextureId());
+	setTexture2DParameters(filtering, wrapping, generateMipmaps);
+	checkOpenGL();
+
+	glBindTexture(GL_TEXTURE_2D, boundTexture );
+}
+
+void Texture2D::setData( const std::vector< core::Ref<Image> >& levels, Texture::FilteringMode filtering, Texture::WrappingMode wrapping )
 {
+	assert( !levels.empty() );
+
+	GLuint boundTexture = 0;
+	glGetIntegerv(GL_TEXTURE_BINDING_2D, (GLint*) &boundTexture);
+	checkOpenGL();
+
+	glBindTexture(GL_TEXTURE_2D, getTextureId());
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for( size_t i = 0; i < levels.size(); ++i )
+	{
+		Image* image = levels[i].ptr();
+		GLint fmt = getImageFormat(image);
+		glTexImage2D(GL_TEXTURE_2D, (GLint)i, fmt, image->getWidth(), image->getHeight(), 0,  fmt, GL_UNSIGNED_BYTE, image->getData() );
+		checkOpenGL();
+	}
+
+	// Incomplete mip chain would make the texture incomplete, so it is only used as is,
+	// if it goes down to 1x1.
+	Image* last = levels.back().ptr();
+	bool complete = last->getWidth() == 1 && last->getHeight() == 1;
+	setTexture2DParameters(filtering, wrapping, !complete);
+
+	glBindTexture(GL_TEXTURE_2D, boundTexture );
 }
 
-void Texture2D::setData( Image* image, Texture::FilteringMode filtering, Texture::WrappingMode wrapping )
+bool Texture2D::setDataFromTGA( const char* const fileName, Texture::FilteringMode filtering, Texture::WrappingMode wrapping )
 {
-	if( !isNpotSquare(image->getWidth(),image->getHeight()) )
+	core::Ref<core::Stream> file = core::FileSystem::openFileInMemory(fileName);
+	if( file == 0 || file->data() == 0 )
 	{
-		printf("Image is not NPOT Square texture (w:%d, h:%d)", image->getWidth(), image->getHeight());
+		return false;
 	}
 
+	return setDataFromTGA(file->data(), file->size(), filtering, wrapping);
+}
+
+bool Texture2D::setDataFromTGA( const void* tgaData, int size, Texture::FilteringMode filtering, Texture::WrappingMode wrapping )
+{
+	const uint8_t* data = static_cast<const uint8_t*>(tgaData);
+	TgaHeader header;
+	if( size < TgaHeader::SIZE || !header.parse(data) )
+	{
+		return false;
+	}
+
+	const int width = header.width;
+	const int height = header.height;
+	const int bpp = header.getDecodedBPP();
+	const int rowBytes = width*bpp;
+	const int offset = header.getPixelDataOffset();
+
+	// Compressed, color mapped and mirrored images are decoded to an image first.
+	if( !header.isDirectlyDecodable() || header.isRightOrigin() || offset + rowBytes*height > size )
+	{
+		core::Ref<Image> image = Image::loadFromTGA(tgaData, size);
+		if( image == 0 )
+		{
+			return false;
+		}
+
+		setData(image, filtering, wrapping);
+		return true;
+	}
+
+	if( !isNpotSquare(width, height) )
+	{
+		printf("Image is not NPOT Square texture (w:%d, h:%d)", width, height);
+	}
+
+	const uint8_t* pixels = data + offset;
+	const bool swizzle = bpp >= 3;
+	const bool flip = header.isTopOrigin();
+
 	GLuint boundTexture = 0;
 	glGetIntegerv(GL_TEXTURE_BINDING_2D, (GLint*) &boundTexture);
 	checkOpenGL();
 
-	GLint fmt = image->getBPP() == 3 ? GL_RGB : GL_RGBA;
-
 	glBindTexture(GL_TEXTURE_2D, getTextureId());
-	glTexImage2D(GL_TEXTURE_2D, 0, fmt, image->getWidth(), image->getHeight(), 0,  fmt, GL_UNSIGNED_BYTE, image->getData() );
-	checkOpenGL();
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 
-	// Trilinear filtering
-	if( filtering == TRILINEAR_FILTERING )
+	if( !flip && (!swizzle || (bpp == 4 && esHasExtension("GL_EXT_texture_format_BGRA8888"))) )
 	{
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glGenerateMipmap(GL_TEXTURE_2D);
+		// Upload straight from the mapped file. BGRA8888 lets the driver do the swizzle.
+		GLenum fmt = swizzle ? GL_BGRA_EXT : getFormatForBPP(bpp);
+		glTexImage2D(GL_TEXTURE_2D, 0, fmt, width, height, 0, fmt, GL_UNSIGNED_BYTE, pixels);
+		checkOpenGL();
+	}
+	else
+	{
+		// Convert strips of rows to a small staging buffer and upload them with glTexSubImage2D.
+		GLenum fmt = getFormatForBPP(bpp);
+		glTexImage2D(GL_TEXTURE_2D, 0, fmt, width, height, 0, fmt, GL_UNSIGNED_BYTE, 0);
+		checkOpenGL();
+
+		const int rowsPerStrip = rowBytes < TGA_STAGING_SIZE ? TGA_STAGING_SIZE / rowBytes : 1;
+		std::vector<uint8_t> staging(rowsPerStrip*rowBytes);
+		for( int y = 0; y < height; y += rowsPerStrip )
+		{
+			int numRows = height - y < rowsPerStrip ? height - y : rowsPerStrip;
+			for( int r = 0; r < numRows; ++r )
+			{
+				int srcRow = flip ? height - 1 - (y + r) : y + r;
+				const uint8_t* src = pixels + srcRow*rowBytes;
+				uint8_t* dst = &staging[r*rowBytes];
+				if( swizzle )
+				{
+					swapRedBlue(dst, src, width, bpp);
+				}
+				else
+				{
+					memcpy(dst, src, rowBytes);
+				}
+			}
+
+			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, y, width, numRows, fmt, GL_UNSIGNED_BYTE, &staging[0]);
+			checkOpenGL();
+		}
 	}
 
-	// Bilinear filtering
-	if( filtering == BILINEAR_FILTERING )
+	setTexture2DParameters(filtering, wrapping);
+
+	glBindTexture(GL_TEXTURE_2D, boundTexture );
+	return true;
+}
+
+bool Texture2D::setDataFromKTX( const char* const fileName, Texture::FilteringMode filtering, Texture::WrappingMode wrapping )
+{
+	core::Ref<core::Stream> file = core::FileSystem::openFileInMemory(fileName);
+	if( file == 0 || file->data() == 0 )
 	{
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glGenerateMipmap(GL_TEXTURE_2D);
+		return false;
 	}
 
-	// Linear filtering
-	if( filtering == LINEAR_FILTERING )
+	return setDataFromKTX(file->data(), file->size(), filtering, wrapping);
+}
+
+bool Texture2D::setDataFromKTX( const void* ktxData, int size, Texture::FilteringMode filtering, Texture::WrappingMode wrapping )
+{
+	KtxHeader header;
+	std::vector<KtxLevel> levels;
+	if( !parseKtx(ktxData, size, header, levels) )
 	{
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		return false;
 	}
 
-	// No filtering
-	if( filtering == NO_FILTERING )
+	return setData(header, levels, filtering, wrapping);
+}
+
+bool Texture2D::setData( const KtxHeader& header, const std::vector<KtxLevel>& levels, Texture::FilteringMode filtering, Texture::WrappingMode wrapping )
+{
+	assert( !levels.empty() );
+
+	GLenum internalFormat = header.glInternalFormat;
+	bool decodeEtc1 = false;
+	if( header.isCompressed() )
 	{
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		// ETC1 is a subset of ETC2, which every OpenGL ES 3.0 driver supports.
+		if( internalFormat == GL_ETC1_RGB8_OES && !isCompressedFormatSupported(internalFormat) && esIsVersion3() )
+		{
+			internalFormat = GL_COMPRESSED_RGB8_ETC2;
+		}
+
+		if( !isCompressedFormatSupported(internalFormat) )
+		{
+			if( internalFormat != GL_ETC1_RGB8_OES )
+			{
+				printf("[%s] Compressed texture format 0x%X is not supported\n", __FUNCTION__, internalFormat);
+				return false;
+			}
+
+			decodeEtc1 = true;
+		}
 	}
 
-	// Repeat
-	if( wrapping == REPEAT )
+	GLuint boundTexture = 0;
+	glGetIntegerv(GL_TEXTURE_BINDING_2D, (GLint*) &boundTexture);
+	checkOpenGL();
+
+	glBindTexture(GL_TEXTURE_2D, getTextureId());
+	for( size_t i = 0; i < levels.size(); ++i )
 	{
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		const KtxLevel& level = levels[i];
+		if( decodeEtc1 )
+		{
+			if( level.size < etc1GetEncodedSize(level.width, level.height) )
+			{
+				printf("[%s] ETC1 level %d is truncated\n", __FUNCTION__, (int)i);
+				glBindTexture(GL_TEXTURE_2D, boundTexture);
+				return false;
+			}
+
+			std::vector<uint8_t> rgb(level.width*level.height*3);
+			etc1DecodeImage(level.data, level.width, level.height, &rgb[0]);
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+			glTexImage2D(GL_TEXTURE_2D, (GLint)i, GL_RGB, level.width, level.height, 0, GL_RGB, GL_UNSIGNED_BYTE, &rgb[0]);
+		}
+		else if( header.isCompressed() )
+		{
+			glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)i, internalFormat, level.width, level.height, 0, level.size, level.data);
+		}
+		else
+		{
+			// KTX stores sized internal formats (for example GL_RGBA8), but OpenGL ES 2.0
+			// needs the internal format to be the same as the format.
+			GLenum levelFormat = esIsVersion3() ? internalFormat : header.glFormat;
+
+			// KTX rows are padded to 4 bytes
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+			glTexImage2D(GL_TEXTURE_2D, (GLint)i, levelFormat, level.width, level.height, 0, header.glFormat, header.glType, level.data);
+		}
+		checkOpenGL();
 	}
 
-	if( wrapping == CLAMP )
+	// glGenerateMipmap does not work with compressed textures, so missing mip levels
+	// of a compressed texture mean, that it can not be mip mapped.
+	const KtxLevel& last = levels.back();
+	bool complete = last.width == 1 && last.height == 1;
+	bool canGenerateMipmaps = !header.isCompressed() || decodeEtc1;
+	if( !complete && !canGenerateMipmaps && (filtering == TRILINEAR_FILTERING || filtering == BILINEAR_FILTERING) )
 	{
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		printf("[%s] Compressed texture has no full mip chain, using linear filtering\n", __FUNCTION__);
+		filtering = LINEAR_FILTERING;
 	}
 
+	setTexture2DParameters(filtering, wrapping, !complete && canGenerateMipmaps);
+
 	glBindTexture(GL_TEXTURE_2D, boundTexture );
+	return true;
 }
 
 TextureCube::TextureCube()
@@ -253,7 +561,8 @@ void TextureCube::setData(Image* images[6], Texture::FilteringMode filtering)
 			printf("Image is not NPOT Square texture (w:%d, h:%d)", image->getWidth(), image->getHeight());
 		}
 
-		GLint fmt = image->getBPP() == 3 ? GL_RGB : GL_RGBA;
+		GLint fmt = getImageFormat(image);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 		glTexImage2D( GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, fmt, image->getWidth(), image->getHeight(), 0,  fmt, GL_UNSIGNED_BYTE, image->getData() );
 		checkOpenGL();
     }
@@ -299,12 +608,32 @@ TextureDepth::~TextureDepth()
 }
 
 
-RenderTarget::RenderTarget (int w, int h, bool createDepthBuffer, const GLenum format, const GLenum type )
+RenderTarget::RenderTarget (int w, int h, bool createDepthBuffer, const GLenum format, const GLenum type, int samples )
+: m_FBO(0)
+, m_msaaFBO(0)
+, m_colorRenderbuffer(0)
+, m_depthRenderbuffer(0)
+, m_samples(1)
 {
-	GLint defaultFBO;
-	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &defaultFBO);
+	GLint boundFBO = 0;
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &boundFBO);
+	m_previousFBO = boundFBO;
 	m_width = w;
 	m_height = h;
+
+	// Make a color buffer texture
+	m_colorBuffer = new Texture2D(m_width, m_height, format, type, Texture::LINEAR_FILTERING, Texture::CLAMP );
+   
+	checkOpenGL();
+
+	if( samples > 1 && (esFramebufferTexture2DMultisampleEXT || esIsVersion3()) )
+	{
+		createMultisampled(createDepthBuffer, format, type, samples);
+		glBindFramebuffer( GL_FRAMEBUFFER, boundFBO );
+		checkOpenGL();
+		return;
+	}
+
     // Make a depth buffer texture
     if( createDepthBuffer )
     {
@@ -313,11 +642,6 @@ RenderTarget::RenderTarget (int w, int h, bool createDepthBuffer, const GLenum f
 
 	checkOpenGL();
 
-	// Make a color buffer texture
-	m_colorBuffer = new Texture2D(m_width, m_height, format, type, Texture::LINEAR_FILTERING, Texture::CLAMP );
-   
-	checkOpenGL();
-
     // Create a frame buffer object (FBO)
 	glGenFramebuffers( 1, &m_FBO );
 	
@@ -325,14 +649,7 @@ RenderTarget::RenderTarget (int w, int h, bool createDepthBuffer, const GLenum f
 
     glBindFramebuffer( GL_FRAMEBUFFER, m_FBO );
 
-	//checkOpenGL();
-	// Make sure everything went ok
-	/*if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-	{
-		assert(0);
-	}*/
-
-	// Set color attachment 0 to FBO
+	// Set color attachment 0 to FBO. Attachments stay for the lifetime of the FBO.
 	glFramebufferTexture2D( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_colorBuffer->getTextureId(), 0 );
     
     if( m_depthBuffer ) 
@@ -347,72 +664,204 @@ RenderTarget::RenderTarget (int w, int h, bool createDepthBuffer, const GLenum f
 		assert(0);
     }
 
-	GLenum test = glGetError();
 	checkOpenGL();
 	
-    // Reset default frame buffer (screen)
-	glBindFramebuffer(GL_FRAMEBUFFER, defaultFBO);
+    // Restore previous frame buffer
+	glBindFramebuffer(GL_FRAMEBUFFER, boundFBO);
 
-	test = glGetError();
 	checkOpenGL();
 }
 
 
-RenderTarget::~RenderTarget()
+void RenderTarget::createMultisampled(bool createDepthBuffer, GLenum format, GLenum type, int samples)
 {
-	if( m_FBO )
-    {
-		// Unbind color and texture attachments and delete frame buffer object
-		glBindFramebuffer( GL_FRAMEBUFFER, m_FBO );
-        glFramebufferTexture2D( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 0, 0 );
+	GLint maxSamples = 1;
+	glGetIntegerv(GL_MAX_SAMPLES, &maxSamples);
+	m_samples = samples < maxSamples ? samples : maxSamples;
+
+	glGenFramebuffers( 1, &m_FBO );
+    glBindFramebuffer( GL_FRAMEBUFFER, m_FBO );
 
-        if( m_depthBuffer )
+	if( esFramebufferTexture2DMultisampleEXT )
+	{
+		// Samples live in tile memory only and are resolved to the texture, when the tile is written.
+		esFramebufferTexture2DMultisampleEXT( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_colorBuffer->getTextureId(), 0, m_samples );
+		if( createDepthBuffer )
+		{
+			glGenRenderbuffers( 1, &m_depthRenderbuffer );
+			glBindRenderbuffer( GL_RENDERBUFFER, m_depthRenderbuffer );
+			esRenderbufferStorageMultisampleEXT( GL_RENDERBUFFER, m_samples, GL_DEPTH_COMPONENT16, m_width, m_height );
+			glFramebufferRenderbuffer( GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_depthRenderbuffer );
+		}
+	}
+	else
+	{
+		// m_FBO holds the resolved color texture, rendering goes to m_msaaFBO.
+		glFramebufferTexture2D( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_colorBuffer->getTextureId(), 0 );
+	    if( glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE )
 		{
-            glFramebufferTexture2D( GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, 0, 0 );
+			assert(0);
 		}
-		
-		glBindFramebuffer( GL_FRAMEBUFFER, 0 );
-  
+
+		// Blit requires the same internal format in both buffers.
+		GLenum internalFormat = GL_RGBA8;
+		if( type == GL_UNSIGNED_SHORT_5_6_5 )
+		{
+			internalFormat = GL_RGB565;
+		}
+		else if( type == GL_HALF_FLOAT_OES )
+		{
+			internalFormat = format == GL_RGB ? GL_RGB16F : GL_RGBA16F;
+		}
+		else if( format == GL_RGB )
+		{
+			internalFormat = GL_RGB8;
+		}
+
+		glGenFramebuffers( 1, &m_msaaFBO );
+		glBindFramebuffer( GL_FRAMEBUFFER, m_msaaFBO );
+
+		glGenRenderbuffers( 1, &m_colorRenderbuffer );
+		glBindRenderbuffer( GL_RENDERBUFFER, m_colorRenderbuffer );
+		esRenderbufferStorageMultisample( GL_RENDERBUFFER, m_samples, internalFormat, m_width, m_height );
+		glFramebufferRenderbuffer( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_colorRenderbuffer );
+
+		if( createDepthBuffer )
+		{
+			glGenRenderbuffers( 1, &m_depthRenderbuffer );
+			glBindRenderbuffer( GL_RENDERBUFFER, m_depthRenderbuffer );
+			esRenderbufferStorageMultisample( GL_RENDERBUFFER, m_samples, GL_DEPTH_COMPONENT16, m_width, m_height );
+			glFramebufferRenderbuffer( GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_depthRenderbuffer );
+		}
+	}
+
+	glBindRenderbuffer( GL_RENDERBUFFER, 0 );
+
+	// Make sure everything went ok
+    if( glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE )
+    {
+		assert(0);
+    }
+
+	checkOpenGL();
+}
+
+
+RenderTarget::~RenderTarget()
+{
+	// Deleting bound FBO binds frame buffer 0
+	GLint boundFBO = 0;
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &boundFBO);
+
+	if( m_FBO )
+    {
         glDeleteFramebuffers( 1, &m_FBO );
     }
+
+	if( m_msaaFBO )
+	{
+		glDeleteFramebuffers( 1, &m_msaaFBO );
+	}
+
+	if( m_colorRenderbuffer )
+	{
+		glDeleteRenderbuffers( 1, &m_colorRenderbuffer );
+	}
+
+	if( m_depthRenderbuffer )
+	{
+		glDeleteRenderbuffers( 1, &m_depthRenderbuffer );
+	}
+
+	if( boundFBO != 0 && (boundFBO == (GLint)m_FBO || boundFBO == (GLint)m_msaaFBO) )
+	{
+		glBindFramebuffer( GL_FRAMEBUFFER, m_previousFBO );
+	}
 }
 
 
 void RenderTarget::shareDepthBuffer( TextureDepth* depthBuffer )
 {
+	// Depth textures can not be attached to multisampled targets.
+	assert(m_samples == 1);
 	m_depthBuffer = depthBuffer;
+
+	// Attach and validate here, so bind does not need to.
+	GLint boundFBO = 0;
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &boundFBO);
+    glBindFramebuffer( GL_FRAMEBUFFER, m_FBO );
+	glFramebufferTexture2D( GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthBuffer ? depthBuffer->getTextureId() : 0, 0 );
+
+    if( glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE )
+    {
+		assert(0);
+    }
+
+	glBindFramebuffer( GL_FRAMEBUFFER, boundFBO );
+	checkOpenGL();
 }
 
 void RenderTarget::bind()
 {
+	// Pooled targets are created in the middle of other passes, so the frame buffer
+	// to restore is taken here, not in the constructor.
+	GLuint fbo = m_msaaFBO ? m_msaaFBO : m_FBO;
+	GLint current = 0;
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &current);
+	if( (GLuint)current != fbo )
+	{
+		m_previousFBO = current;
+	}
+
 	// Bind the FBO and set viewport to be the sizer of the FBO
-    glBindFramebuffer( GL_FRAMEBUFFER, m_FBO );
+    glBindFramebuffer( GL_FRAMEBUFFER, fbo );
+    glViewport( 0, 0, m_width, m_height );
+}
 
-	glFramebufferTexture2D( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_colorBuffer->getTextureId(), 0 );
-    if( m_depthBuffer )
+
+void RenderTarget::unbind(int discardFlags)
+{
+	if( m_msaaFBO )
 	{
-		glFramebufferTexture2D( GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, m_depthBuffer->getTextureId(), 0 );
+		if( !(discardFlags & DISCARD_COLOR) )
+		{
+			glBindFramebuffer( GL_READ_FRAMEBUFFER, m_msaaFBO );
+			glBindFramebuffer( GL_DRAW_FRAMEBUFFER, m_FBO );
+			esBlitFramebuffer( 0, 0, m_width, m_height, 0, 0, m_width, m_height, GL_COLOR_BUFFER_BIT, GL_NEAREST );
+			glBindFramebuffer( GL_FRAMEBUFFER, m_msaaFBO );
+		}
+
+		// Samples are not needed after resolve.
+		discardFlags = DISCARD_ALL;
 	}
 
-	// Make sure everything went ok
-    if( glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE )
-    {
-		assert(0);
-    }
+	if( discardFlags != DISCARD_NONE )
+	{
+		discard(discardFlags);
+	}
 
-    glViewport( 0, 0, m_width, m_height );
-	GLenum test = glGetError();
+    glBindFramebuffer( GL_FRAMEBUFFER, m_previousFBO );
 }
 
 
-void RenderTarget::unbind()
+void RenderTarget::discard(int discardFlags)
 {
-	// Unbind textures from FBO
-    glBindFramebuffer( GL_FRAMEBUFFER, 0 );
+	GLenum attachments[2];
+	GLsizei count = 0;
+	if( discardFlags & DISCARD_COLOR )
+	{
+		attachments[count++] = GL_COLOR_ATTACHMENT0;
+	}
 
-    glFramebufferTexture2D( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 0, 0 );
-    glFramebufferTexture2D( GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, 0, 0 );
-	GLenum test = glGetError();
+	if( (discardFlags & DISCARD_DEPTH) && (m_depthBuffer || m_depthRenderbuffer) )
+	{
+		attachments[count++] = GL_DEPTH_ATTACHMENT;
+	}
+
+	if( count > 0 )
+	{
+		esDiscardFramebuffer(count, attachments);
+	}
 }
 
 }
@@ -0,0 +1,296 @@
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Copyright (c) 2013 Mikko Romppainen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in the
+// Software without restriction, including without limitation the rights to use, copy,
+// modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+#include <graphics/TextureAtlas.h>
+#include <graphics/MipmapGenerator.h>
+#include <es_assert.h>
+#include <string.h>
+#include <algorithm>
+
+namespace graphics
+{
+	namespace
+	{
+		struct LargerFirst
+		{
+			const std::vector< core::Ref<Image> >* images;
+
+			int maxSide(int i) const
+			{
+				Image* img = (*images)[i].ptr();
+				return img->getWidth() > img->getHeight() ? img->getWidth() : img->getHeight();
+			}
+
+			bool operator()(int a, int b) const
+			{
+				return maxSide(a) > maxSide(b);
+			}
+		};
+	}
+
+	SkylinePacker::SkylinePacker(int width, int height)
+		: m_width(width)
+		, m_height(height)
+	{
+		reset();
+	}
+
+	void SkylinePacker::reset()
+	{
+		m_skyline.clear();
+		Segment s = { 0, 0, m_width };
+		m_skyline.push_back(s);
+	}
+
+	int SkylinePacker::fit(size_t index, int width, int height) const
+	{
+		int x = m_skyline[index].x;
+		if (x + width > m_width)
+		{
+			return -1;
+		}
+
+		// Rectangle rests on the highest segment under it.
+		int y = 0;
+		int widthLeft = width;
+		while (widthLeft > 0)
+		{
+			y = m_skyline[index].y > y ? m_skyline[index].y : y;
+			if (y + height > m_height)
+			{
+				return -1;
+			}
+
+			widthLeft -= m_skyline[index].width;
+			++index;
+		}
+
+		return y;
+	}
+
+	bool SkylinePacker::pack(int width, int height, int* x, int* y)
+	{
+		int bestIndex = -1;
+		int bestTop = m_height + 1;
+		int bestWidth = m_width + 1;
+		for (size_t i = 0; i < m_skyline.size(); ++i)
+		{
+			int top = fit(i, width, height);
+			if (top < 0)
+			{
+				continue;
+			}
+
+			// Lowest top edge wins, narrower segment breaks ties.
+			if (top + height < bestTop || (top + height == bestTop && m_skyline[i].width < bestWidth))
+			{
+				bestIndex = (int)i;
+				bestTop = top + height;
+				bestWidth = m_skyline[i].width;
+			}
+		}
+
+		if (bestIndex < 0)
+		{
+			return false;
+		}
+
+		Segment placed = { m_skyline[bestIndex].x, bestTop, width };
+		*x = placed.x;
+		*y = bestTop - height;
+		m_skyline.insert(m_skyline.begin() + bestIndex, placed);
+
+		// Shrink or remove segments covered by the new one.
+		for (size_t i = bestIndex + 1; i < m_skyline.size(); )
+		{
+			Segment& s = m_skyline[i];
+			int overlap = placed.x + placed.width - s.x;
+			if (overlap <= 0)
+			{
+				break;
+			}
+
+			if (overlap < s.width)
+			{
+				s.x += overlap;
+				s.width -= overlap;
+				break;
+			}
+
+			m_skyline.erase(m_skyline.begin() + i);
+		}
+
+		// Merge neighbouring segments at the same height.
+		for (size_t i = 0; i + 1 < m_skyline.size(); )
+		{
+			if (m_skyline[i].y == m_skyline[i + 1].y)
+			{
+				m_skyline[i].width += m_skyline[i + 1].width;
+				m_skyline.erase(m_skyline.begin() + i + 1);
+			}
+			else
+			{
+				++i;
+			}
+		}
+
+		return true;
+	}
+
+	TextureAtlas::TextureAtlas(int width, int height, int bytesPerPixel, int padding, int maxMipLevel)
+		: Object()
+		, m_padding(padding)
+		, m_alignment(1 << maxMipLevel)
+		, m_image(new Image(width, height, bytesPerPixel))
+		, m_texture(new Texture2D())
+	{
+		assert(padding >= 0 && maxMipLevel >= 0);
+		assert(width % m_alignment == 0 && height % m_alignment == 0);
+	}
+
+	TextureAtlas::~TextureAtlas()
+	{
+	}
+
+	int TextureAtlas::add(Image* image)
+	{
+		assert(image->getBPP() == m_image->getBPP());
+		Region r;
+		memset(&r, 0, sizeof(r));
+		m_images.push_back(image);
+		m_regions.push_back(r);
+		return (int)m_regions.size() - 1;
+	}
+
+	bool TextureAtlas::build(Texture::FilteringMode filtering, Texture::WrappingMode wrapping)
+	{
+		// Pack in units of alignment, so every image starts at mip-aligned position.
+		const int unit = m_alignment;
+		const int atlasWidth = m_image->getWidth();
+		const int atlasHeight = m_image->getHeight();
+		SkylinePacker packer(atlasWidth / unit, atlasHeight / unit);
+
+		std::vector<int> order(m_images.size());
+		for (size_t i = 0; i < order.size(); ++i)
+		{
+			order[i] = (int)i;
+		}
+
+		LargerFirst larger = { &m_images };
+		std::stable_sort(order.begin(), order.end(), larger);
+
+		memset(m_image->getData(), 0, m_image->getDataLenInBytes());
+
+		bool allFit = true;
+		for (size_t i = 0; i < order.size(); ++i)
+		{
+			Image* image = m_images[order[i]].ptr();
+			Region& r = m_regions[order[i]];
+			memset(&r, 0, sizeof(r));
+
+			int w = (image->getWidth() + 2 * m_padding + unit - 1) / unit;
+			int h = (image->getHeight() + 2 * m_padding + unit - 1) / unit;
+			int px, py;
+			if (!packer.pack(w, h, &px, &py))
+			{
+				allFit = false;
+				continue;
+			}
+
+			r.x = px*unit + m_padding;
+			r.y = py*unit + m_padding;
+			r.width = image->getWidth();
+			r.height = image->getHeight();
+			r.uvRect[0] = float(r.x) / atlasWidth;
+			r.uvRect[1] = float(r.y) / atlasHeight;
+			r.uvRect[2] = float(r.x + r.width) / atlasWidth;
+			r.uvRect[3] = float(r.y + r.height) / atlasHeight;
+			copyWithGutter(image, px*unit, py*unit, w*unit, h*unit);
+		}
+
+		if (filtering == Texture::TRILINEAR_FILTERING || filtering == Texture::BILINEAR_FILTERING)
+		{
+			std::vector< core::Ref<Image> > levels;
+			generateMipmaps(m_image, levels);
+			m_texture->setData(levels, filtering, wrapping);
+		}
+		else
+		{
+			m_texture->setData(m_image, filtering, wrapping);
+		}
+
+		return allFit;
+	}
+
+	void TextureAtlas::copyWithGutter(Image* image, int cellX, int cellY, int cellWidth, int cellHeight)
+	{
+		const int bpp = image->getBPP();
+		const int w = image->getWidth();
+		const int h = image->getHeight();
+		const int atlasWidth = m_image->getWidth();
+		uint8_t* atlas = m_image->getData();
+		const uint8_t* src = image->getData();
+
+		// The whole cell is filled, so mip levels down to the cell alignment average only
+		// edge pixels at the borders.
+		const int right = cellWidth - m_padding - w;
+		for (int row = 0; row < cellHeight; ++row)
+		{
+			int srcRow = row - m_padding;
+			srcRow = srcRow < 0 ? 0 : (srcRow >= h ? h - 1 : srcRow);
+			const uint8_t* s = src + srcRow*w*bpp;
+			uint8_t* d = atlas + ((cellY + row)*atlasWidth + cellX)*bpp;
+
+			for (int i = 0; i < m_padding; ++i)
+			{
+				memcpy(d + i*bpp, s, bpp);
+			}
+
+			memcpy(d + m_padding*bpp, s, w*bpp);
+
+			for (int i = 0; i < right; ++i)
+			{
+				memcpy(d + (m_padding + w + i)*bpp, s + (w - 1)*bpp, bpp);
+			}
+		}
+	}
+
+	const TextureAtlas::Region& TextureAtlas::getRegion(int index) const
+	{
+		assert(index >= 0 && index < (int)m_regions.size());
+		return m_regions[index];
+	}
+
+	int TextureAtlas::getNumRegions() const
+	{
+		return (int)m_regions.size();
+	}
+
+	Image* TextureAtlas::getImage() const
+	{
+		return m_image.ptr();
+	}
+
+	Texture2D* TextureAtlas::getTexture() const
+	{
+		return m_texture.ptr();
+	}
+}
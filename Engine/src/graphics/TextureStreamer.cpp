@@ -0,0 +1,337 @@
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Copyright (c) 2013 Mikko Romppainen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in the
+// Software without restriction, including without limitation the rights to use, copy,
+// modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+#include <graphics/TextureStreamer.h>
+#include <es_assert.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+namespace graphics
+{
+	namespace
+	{
+		// Copies levels [firstLevel, end) to data and points dst levels to it.
+		void copyLevels(const std::vector<KtxLevel>& src, int firstLevel,
+			std::vector<uint8_t>& data, std::vector<KtxLevel>& dst)
+		{
+			int total = 0;
+			for (size_t i = firstLevel; i < src.size(); ++i)
+			{
+				total += src[i].size;
+			}
+
+			data.resize(total);
+			dst.clear();
+			int offset = 0;
+			for (size_t i = firstLevel; i < src.size(); ++i)
+			{
+				KtxLevel level = src[i];
+				if (level.size > 0)
+				{
+					memcpy(&data[offset], level.data, level.size);
+				}
+				level.data = data.empty() ? 0 : &data[0] + offset;
+				offset += level.size;
+				dst.push_back(level);
+			}
+		}
+	}
+
+	StreamedTexture::StreamedTexture()
+		: Object()
+		, m_texture(new Texture2D())
+		, m_filtering(Texture::TRILINEAR_FILTERING)
+		, m_wrapping(Texture::REPEAT)
+		, m_tailLevel(0)
+		, m_residentLevel(0)
+		, m_requiredLevel(0)
+		, m_pendingLevel(-1)
+		, m_lastUsedFrame(-1)
+	{
+		memset(&m_header, 0, sizeof(m_header));
+	}
+
+	StreamedTexture::~StreamedTexture()
+	{
+	}
+
+	Texture2D* StreamedTexture::getTexture() const
+	{
+		return m_texture.ptr();
+	}
+
+	int StreamedTexture::getWidth() const
+	{
+		return (int)m_header.pixelWidth;
+	}
+
+	int StreamedTexture::getHeight() const
+	{
+		return (int)m_header.pixelHeight;
+	}
+
+	int StreamedTexture::getNumLevels() const
+	{
+		return (int)m_levelSizes.size();
+	}
+
+	int StreamedTexture::getResidentLevel() const
+	{
+		return m_residentLevel;
+	}
+
+	int StreamedTexture::getResidentBytes() const
+	{
+		return getBytesFromLevel(m_residentLevel);
+	}
+
+	int StreamedTexture::getBytesFromLevel(int level) const
+	{
+		int bytes = 0;
+		for (size_t i = level; i < m_levelSizes.size(); ++i)
+		{
+			bytes += m_levelSizes[i];
+		}
+		return bytes;
+	}
+
+	TextureStreamer::TextureStreamer(int budgetBytes)
+		: Object()
+		, m_budget(budgetBytes)
+		, m_usedBytes(0)
+		, m_frame(0)
+	{
+	}
+
+	TextureStreamer::~TextureStreamer()
+	{
+		core::getJobSystem()->wait(&m_loadJobs);
+
+		for (size_t i = 0; i < m_results.size(); ++i)
+		{
+			delete m_results[i];
+		}
+	}
+
+	StreamedTexture* TextureStreamer::add(const char* const fileName,
+		Texture::FilteringMode filtering, Texture::WrappingMode wrapping)
+	{
+		core::Ref<core::Stream> file = core::FileSystem::openFileInMemory(fileName);
+		KtxHeader header;
+		std::vector<KtxLevel> levels;
+		if (file == 0 || file->data() == 0 || !parseKtx(file->data(), file->size(), header, levels))
+		{
+			printf("[%s] Could not load texture %s\n", __FUNCTION__, fileName);
+			return 0;
+		}
+
+		core::Ref<StreamedTexture> texture = new StreamedTexture();
+		texture->m_fileName = fileName;
+		texture->m_file = file;
+		texture->m_filtering = filtering;
+		texture->m_wrapping = wrapping;
+		texture->m_header = header;
+
+		int tailLevel = (int)levels.size() - 1;
+		for (size_t i = 0; i < levels.size(); ++i)
+		{
+			texture->m_levelSizes.push_back(levels[i].size);
+			if (tailLevel == (int)levels.size() - 1 && levels[i].width <= TAIL_SIZE && levels[i].height <= TAIL_SIZE)
+			{
+				tailLevel = (int)i;
+			}
+		}
+
+		texture->m_tailLevel = tailLevel;
+		texture->m_residentLevel = tailLevel;
+		texture->m_requiredLevel = tailLevel;
+		copyLevels(levels, tailLevel, texture->m_tailData, texture->m_tailLevels);
+
+		m_usedBytes += texture->getResidentBytes();
+		texture->m_texture->setData(header, texture->m_tailLevels, filtering, wrapping);
+		m_textures.push_back(texture);
+		return texture.ptr();
+	}
+
+	void TextureStreamer::use(StreamedTexture* texture, float screenSize)
+	{
+		int level = computeRequiredLevel(texture->getWidth(), texture->getHeight(), screenSize, texture->getNumLevels());
+		if (texture->m_lastUsedFrame != m_frame || level < texture->m_requiredLevel)
+		{
+			// First use this frame resets the requirement, later uses can only raise detail.
+			texture->m_requiredLevel = texture->m_lastUsedFrame != m_frame ? level :
+				std::min(level, texture->m_requiredLevel);
+		}
+		texture->m_lastUsedFrame = m_frame;
+	}
+
+	int TextureStreamer::computeRequiredLevel(int width, int height, float screenSize, int numLevels)
+	{
+		int size = width > height ? width : height;
+		if (screenSize < 1.0f)
+		{
+			return numLevels - 1;
+		}
+
+		int level = (int)floorf(log2f(float(size) / screenSize));
+		level = level < 0 ? 0 : level;
+		return level < numLevels - 1 ? level : numLevels - 1;
+	}
+
+	void TextureStreamer::update()
+	{
+		// Upload finished loads
+		std::deque<LoadResult*> results;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			results.swap(m_results);
+		}
+
+		for (size_t i = 0; i < results.size(); ++i)
+		{
+			LoadResult* r = results[i];
+			StreamedTexture* t = r->texture;
+			t->m_pendingLevel = -1;
+			if (!r->ok)
+			{
+				printf("[%s] Streaming %s failed\n", __FUNCTION__, t->m_fileName.c_str());
+			}
+			else if (r->level < t->m_residentLevel && makeRoom(t->getBytesFromLevel(r->level) - t->getResidentBytes(), t))
+			{
+				upload(t, r->level, r->header, r->levels);
+			}
+			delete r;
+		}
+
+		// Request more detailed levels for textures used recently.
+		std::vector<StreamedTexture*> wanted;
+		for (size_t i = 0; i < m_textures.size(); ++i)
+		{
+			StreamedTexture* t = m_textures[i].ptr();
+			if (t->m_pendingLevel < 0 && t->m_lastUsedFrame >= 0 &&
+				m_frame - t->m_lastUsedFrame < USE_TIMEOUT_FRAMES && t->m_requiredLevel < t->m_residentLevel)
+			{
+				// Room is made before loading, so loads that can not fit are not started at all.
+				if (makeRoom(t->getBytesFromLevel(t->m_requiredLevel) - t->getResidentBytes(), t))
+				{
+					wanted.push_back(t);
+				}
+			}
+		}
+
+		for (size_t i = 0; i < wanted.size(); ++i)
+		{
+			LoadRequest* request = new LoadRequest();
+			request->streamer = this;
+			request->texture = wanted[i];
+			request->fileData = wanted[i]->m_file->data();
+			request->fileSize = wanted[i]->m_file->size();
+			request->level = wanted[i]->m_requiredLevel;
+			wanted[i]->m_pendingLevel = request->level;
+			core::getJobSystem()->run(&TextureStreamer::loadJob, request, &m_loadJobs);
+		}
+
+		// Stay in budget, even if it was lowered.
+		makeRoom(0, 0);
+		++m_frame;
+	}
+
+	void TextureStreamer::upload(StreamedTexture* texture, int level, const KtxHeader& header, const std::vector<KtxLevel>& levels)
+	{
+		m_usedBytes += texture->getBytesFromLevel(level) - texture->getResidentBytes();
+		texture->m_residentLevel = level;
+		texture->m_texture->setData(header, levels, texture->m_filtering, texture->m_wrapping);
+	}
+
+	bool TextureStreamer::makeRoom(int bytes, StreamedTexture* except)
+	{
+		while (m_usedBytes + bytes > m_budget)
+		{
+			// Least recently used texture, which has more than its tail resident
+			StreamedTexture* lru = 0;
+			for (size_t i = 0; i < m_textures.size(); ++i)
+			{
+				StreamedTexture* t = m_textures[i].ptr();
+				if (t != except && t->m_residentLevel < t->m_tailLevel &&
+					(lru == 0 || t->m_lastUsedFrame < lru->m_lastUsedFrame))
+				{
+					lru = t;
+				}
+			}
+
+			// Textures used this frame are not evicted to load others.
+			if (lru == 0 || (except != 0 && lru->m_lastUsedFrame == m_frame))
+			{
+				return false;
+			}
+
+			upload(lru, lru->m_tailLevel, lru->m_header, lru->m_tailLevels);
+		}
+
+		return true;
+	}
+
+	void TextureStreamer::setBudget(int budgetBytes)
+	{
+		m_budget = budgetBytes;
+	}
+
+	int TextureStreamer::getBudget() const
+	{
+		return m_budget;
+	}
+
+	int TextureStreamer::getUsedBytes() const
+	{
+		return m_usedBytes;
+	}
+
+	void TextureStreamer::loadJob(void* data)
+	{
+		LoadRequest* request = (LoadRequest*)data;
+		TextureStreamer* streamer = request->streamer;
+		LoadResult* result = new LoadResult();
+		streamer->load(*request, *result);
+		delete request;
+
+		std::lock_guard<std::mutex> lock(streamer->m_mutex);
+		streamer->m_results.push_back(result);
+	}
+
+	void TextureStreamer::load(const LoadRequest& request, LoadResult& result)
+	{
+		// Only the mapped file is touched here. Engine objects are not created or referenced.
+		result.texture = request.texture;
+		result.level = request.level;
+		result.ok = false;
+
+		std::vector<KtxLevel> levels;
+		if (!parseKtx(request.fileData, request.fileSize, result.header, levels) ||
+			request.level >= (int)levels.size())
+		{
+			return;
+		}
+
+		copyLevels(levels, request.level, result.data, result.levels);
+		result.ok = true;
+	}
+}
@@ -0,0 +1,463 @@
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Copyright (c) 2013 Mikko Romppainen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in the
+// Software without restriction, including without limitation the rights to use, copy,
+// modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+#include <graphics/TextureUploadQueue.h>
+#include <graphics/TgaFormat.h>
+#include <graphics/MipmapGenerator.h>
+#include <es_assert.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <graphics/Win32/EGL/eglext.h>
+#else
+#include <EGL/eglext.h>
+#endif
+
+namespace graphics
+{
+	namespace
+	{
+		PFNEGLCREATESYNCKHRPROC		createSync = 0;
+		PFNEGLDESTROYSYNCKHRPROC	destroySync = 0;
+		PFNEGLCLIENTWAITSYNCKHRPROC	clientWaitSync = 0;
+
+		bool hasWord(const char* list, const char* word)
+		{
+			size_t len = strlen(word);
+			for (const char* p = list; p && (p = strstr(p, word)) != 0; p += len)
+			{
+				if ((p == list || p[-1] == ' ') && (p[len] == ' ' || p[len] == '\0'))
+				{
+					return true;
+				}
+			}
+			return false;
+		}
+
+		bool endsWith(const char* str, const char* suffix)
+		{
+			size_t n = strlen(str);
+			size_t m = strlen(suffix);
+			return n >= m && strcmp(str + n - m, suffix) == 0;
+		}
+	}
+
+	TextureUploadQueue::TextureUploadQueue(ESContext* esContext, UploadMode mode, int bytesPerFrame)
+		: Object()
+		, m_mode(mode)
+		, m_bytesPerFrame(bytesPerFrame)
+		, m_current(0)
+		, m_display(EGL_NO_DISPLAY)
+		, m_sharedContext(EGL_NO_CONTEXT)
+		, m_sharedSurface(EGL_NO_SURFACE)
+		, m_quit(false)
+	{
+		if (m_mode == UPLOAD_SHARED_CONTEXT && !createSharedContext(esContext))
+		{
+			printf("[%s] Shared EGL context not available, using time sliced uploads\n", __FUNCTION__);
+			m_mode = UPLOAD_TIME_SLICED;
+		}
+
+		if (m_mode == UPLOAD_SHARED_CONTEXT)
+		{
+			m_uploadThread = std::thread(&TextureUploadQueue::uploadThread, this);
+		}
+	}
+
+	TextureUploadQueue::~TextureUploadQueue()
+	{
+		// Decode jobs touch the queues, so they must finish first.
+		core::getJobSystem()->wait(&m_decodeJobs);
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_quit = true;
+		}
+		m_uploadCondition.notify_all();
+
+		if (m_uploadThread.joinable())
+		{
+			m_uploadThread.join();
+		}
+
+		for (size_t i = 0; i < m_pending.size(); ++i)
+		{
+			Job* job = m_pending[i].job;
+			if (job->fence)
+			{
+				destroySync(m_display, (EGLSyncKHR)job->fence);
+			}
+			delete job;
+		}
+
+		if (m_sharedContext != EGL_NO_CONTEXT)
+		{
+			eglDestroyContext(m_display, m_sharedContext);
+		}
+
+		if (m_sharedSurface != EGL_NO_SURFACE)
+		{
+			eglDestroySurface(m_display, m_sharedSurface);
+		}
+	}
+
+	bool TextureUploadQueue::createSharedContext(ESContext* esContext)
+	{
+		m_display = esContext->eglDisplay;
+
+		// Shared context must use the same config as the render context.
+		EGLint configId = 0;
+		EGLint numConfigs = 0;
+		EGLConfig config;
+		eglQueryContext(m_display, esContext->eglContext, EGL_CONFIG_ID, &configId);
+		EGLint configAttribs[] = { EGL_CONFIG_ID, configId, EGL_NONE };
+		if (!eglChooseConfig(m_display, configAttribs, &config, 1, &numConfigs) || numConfigs != 1)
+		{
+			return false;
+		}
+
+		EGLint contextAttribs[] = { EGL_CONTEXT_CLIENT_VERSION, esContext->version == ES_VERSION_3 ? 3 : 2, EGL_NONE };
+		m_sharedContext = eglCreateContext(m_display, config, esContext->eglContext, contextAttribs);
+		if (m_sharedContext == EGL_NO_CONTEXT)
+		{
+			return false;
+		}
+
+		// Loader context does not draw, but needs a surface unless surfaceless contexts are supported.
+		const char* extensions = eglQueryString(m_display, EGL_EXTENSIONS);
+		if (!hasWord(extensions, "EGL_KHR_surfaceless_context"))
+		{
+			EGLint surfaceAttribs[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+			m_sharedSurface = eglCreatePbufferSurface(m_display, config, surfaceAttribs);
+			if (m_sharedSurface == EGL_NO_SURFACE)
+			{
+				eglDestroyContext(m_display, m_sharedContext);
+				m_sharedContext = EGL_NO_CONTEXT;
+				return false;
+			}
+		}
+
+		// Without fences the loader thread finishes each upload with glFinish.
+		if (hasWord(extensions, "EGL_KHR_fence_sync"))
+		{
+			createSync = (PFNEGLCREATESYNCKHRPROC)eglGetProcAddress("eglCreateSyncKHR");
+			destroySync = (PFNEGLDESTROYSYNCKHRPROC)eglGetProcAddress("eglDestroySyncKHR");
+			clientWaitSync = (PFNEGLCLIENTWAITSYNCKHRPROC)eglGetProcAddress("eglClientWaitSyncKHR");
+		}
+
+		return true;
+	}
+
+	bool TextureUploadQueue::load(Texture2D* texture, const char* const fileName,
+		Texture::FilteringMode filtering, Texture::WrappingMode wrapping)
+	{
+		// File is opened here, so that a missing file is reported by the return value.
+		PendingTexture p;
+		p.texture = texture;
+		p.file = core::FileSystem::openFileInMemory(fileName);
+		if (p.file == 0 || p.file->data() == 0)
+		{
+			return false;
+		}
+
+		Job* job = new Job();
+		job->queue = this;
+		job->texture = texture;
+		job->fileData = p.file->data();
+		job->fileSize = p.file->size();
+		job->isKtx = endsWith(fileName, ".ktx");
+		job->filtering = filtering;
+		job->wrapping = wrapping;
+		job->ok = false;
+		job->done = false;
+		job->nextLevel = 0;
+		job->nextRow = 0;
+		job->fence = 0;
+		p.job = job;
+		m_pending.push_back(p);
+
+		core::getJobSystem()->run(&TextureUploadQueue::decodeJob, job, &m_decodeJobs);
+		return true;
+	}
+
+	void TextureUploadQueue::decodeJob(void* data)
+	{
+		Job* job = (Job*)data;
+		TextureUploadQueue* queue = job->queue;
+		queue->decode(job);
+
+		{
+			std::lock_guard<std::mutex> lock(queue->m_mutex);
+			queue->m_decoded.push_back(job);
+		}
+		queue->m_uploadCondition.notify_one();
+	}
+
+	void TextureUploadQueue::decode(Job* job)
+	{
+		if (job->isKtx)
+		{
+			if (!parseKtx(job->fileData, job->fileSize, job->ktxHeader, job->ktxLevels))
+			{
+				return;
+			}
+
+			// Touch every page, so the upload does not wait for disk reads.
+			volatile uint8_t sum = 0;
+			for (int i = 0; i < job->fileSize; i += 4096)
+			{
+				sum += job->fileData[i];
+			}
+			job->ok = true;
+			return;
+		}
+
+		TgaHeader header;
+		if (job->fileSize < TgaHeader::SIZE || !header.parse(job->fileData) ||
+			header.getPixelDataOffset() >= job->fileSize)
+		{
+			return;
+		}
+
+		Image* image = new Image(header.width, header.height, header.getDecodedBPP());
+		job->levels.push_back(image);
+
+		const uint8_t* colorMap = header.getColorMapSize() > 0 ? job->fileData + TgaHeader::SIZE + header.idLength : 0;
+		int offset = header.getPixelDataOffset();
+		job->ok = decodeTgaPixels(header, colorMap, job->fileData + offset, job->fileSize - offset, image->getData());
+
+		// Mip levels are filtered here, so the render thread does not run glGenerateMipmap
+		// outside of the upload budget.
+		if (job->ok && (job->filtering == Texture::TRILINEAR_FILTERING || job->filtering == Texture::BILINEAR_FILTERING))
+		{
+			generateMipmaps(image, job->levels);
+		}
+	}
+
+	void TextureUploadQueue::uploadThread()
+	{
+		eglMakeCurrent(m_display, m_sharedSurface, m_sharedSurface, m_sharedContext);
+
+		while (true)
+		{
+			Job* job = 0;
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				while (!m_quit && m_decoded.empty())
+				{
+					m_uploadCondition.wait(lock);
+				}
+
+				if (m_quit)
+				{
+					break;
+				}
+
+				job = m_decoded.front();
+				m_decoded.pop_front();
+			}
+
+			if (job->ok)
+			{
+				uploadAll(job);
+				if (createSync)
+				{
+					job->fence = createSync(m_display, EGL_SYNC_FENCE_KHR, 0);
+					glFlush();
+				}
+				else
+				{
+					glFinish();
+				}
+			}
+
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_uploaded.push_back(job);
+		}
+
+		eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	}
+
+	void TextureUploadQueue::uploadAll(Job* job)
+	{
+		if (job->isKtx)
+		{
+			job->ok = job->texture->setData(job->ktxHeader, job->ktxLevels, job->filtering, job->wrapping);
+		}
+		else
+		{
+			job->texture->setData(job->levels, job->filtering, job->wrapping);
+		}
+	}
+
+	int TextureUploadQueue::uploadSlice(Job* job, int maxBytes)
+	{
+		// KTX levels are uploaded at once. Compressed data is a fraction of the decoded size.
+		if (job->isKtx)
+		{
+			uploadAll(job);
+			job->done = true;
+			return job->fileSize;
+		}
+
+		Image* image = job->levels[job->nextLevel].ptr();
+		const int width = image->getWidth();
+		const int height = image->getHeight();
+		const int bpp = image->getBPP();
+		if (job->nextLevel == 0 && job->nextRow == 0)
+		{
+			job->texture->allocate(width, height, bpp, (int)job->levels.size());
+		}
+
+		const int rowBytes = width*bpp;
+		int numRows = maxBytes / rowBytes;
+		numRows = numRows > 0 ? numRows : 1;
+		numRows = numRows < height - job->nextRow ? numRows : height - job->nextRow;
+		job->texture->setSubData(image->getData() + job->nextRow*rowBytes, 0, job->nextRow, width, numRows, bpp, job->nextLevel);
+		job->nextRow += numRows;
+
+		if (job->nextRow == height)
+		{
+			job->nextRow = 0;
+			++job->nextLevel;
+		}
+
+		if (job->nextLevel == (int)job->levels.size())
+		{
+			// Mip chain is complete, so nothing is generated here.
+			job->texture->setParameters(job->filtering, job->wrapping, false);
+			job->done = true;
+		}
+
+		return numRows*rowBytes;
+	}
+
+	void TextureUploadQueue::update()
+	{
+		if (m_mode == UPLOAD_TIME_SLICED)
+		{
+			int budget = m_bytesPerFrame;
+			while (budget > 0)
+			{
+				if (m_current == 0)
+				{
+					std::lock_guard<std::mutex> lock(m_mutex);
+					if (m_decoded.empty())
+					{
+						break;
+					}
+					m_current = m_decoded.front();
+					m_decoded.pop_front();
+				}
+
+				if (!m_current->ok)
+				{
+					m_current->done = true;
+				}
+				else
+				{
+					budget -= uploadSlice(m_current, budget);
+				}
+
+				if (m_current->done)
+				{
+					m_current = 0;
+				}
+			}
+		}
+		else
+		{
+			std::deque<Job*> uploaded;
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				uploaded.swap(m_uploaded);
+			}
+
+			std::deque<Job*> waiting;
+			for (size_t i = 0; i < uploaded.size(); ++i)
+			{
+				Job* job = uploaded[i];
+				if (job->fence)
+				{
+					// Poll without waiting. Not yet signaled fences are checked again next frame.
+					EGLint status = clientWaitSync(m_display, (EGLSyncKHR)job->fence, 0, 0);
+					if (status == EGL_TIMEOUT_EXPIRED_KHR)
+					{
+						waiting.push_back(job);
+						continue;
+					}
+
+					destroySync(m_display, (EGLSyncKHR)job->fence);
+					job->fence = 0;
+				}
+				job->done = true;
+			}
+
+			if (!waiting.empty())
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_uploaded.insert(m_uploaded.begin(), waiting.begin(), waiting.end());
+			}
+		}
+
+		// Release finished textures and their files
+		for (size_t i = 0; i < m_pending.size(); )
+		{
+			Job* job = m_pending[i].job;
+			if (job->done)
+			{
+				if (!job->ok)
+				{
+					printf("[%s] Texture could not be loaded\n", __FUNCTION__);
+				}
+
+				delete job;
+				m_pending.erase(m_pending.begin() + i);
+			}
+			else
+			{
+				++i;
+			}
+		}
+	}
+
+	bool TextureUploadQueue::isPending(Texture2D* texture) const
+	{
+		for (size_t i = 0; i < m_pending.size(); ++i)
+		{
+			if (m_pending[i].texture == texture)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	int TextureUploadQueue::getNumPending() const
+	{
+		return (int)m_pending.size();
+	}
+
+	UploadMode TextureUploadQueue::getMode() const
+	{
+		return m_mode;
+	}
+}
@@ -0,0 +1,318 @@
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Copyright (c) 2013 Mikko Romppainen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in the
+// Software without restriction, including without limitation the rights to use, copy,
+// modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+#include <graphics/TgaFormat.h>
+#include <graphics/PixelConvert.h>
+#include <string.h>
+
+namespace graphics
+{
+	namespace
+	{
+		uint16_t readU16(const uint8_t* p)
+		{
+			return uint16_t(p[0] | (p[1] << 8));
+		}
+
+		bool isTrueColorDepth(int depth)
+		{
+			return depth == 15 || depth == 16 || depth == 24 || depth == 32;
+		}
+
+		int getTrueColorDecodedBPP(int depth, int alphaBits)
+		{
+			if (depth == 32 || (depth == 16 && alphaBits > 0))
+			{
+				return 4;
+			}
+
+			return 3;
+		}
+
+		// True, if file pixels can be copied as is and finished with finishTgaPixels.
+		bool hasRawLayout(const TgaHeader& h)
+		{
+			int type = h.imageType & 0x7;
+			return (type == TGA_TRUE_COLOR && (h.pixelDepth == 24 || h.pixelDepth == 32)) ||
+				type == TGA_GRAYSCALE;
+		}
+
+		// Converts one BGR(A) or 15/16-bit ARGB value to RGB(A).
+		void convertTrueColor(const uint8_t* s, int depth, uint8_t* d, int dstBpp)
+		{
+			uint8_t r, g, b, a = 255;
+			if (depth == 15 || depth == 16)
+			{
+				int v = readU16(s);
+				r = uint8_t((v >> 10) & 31);
+				g = uint8_t((v >> 5) & 31);
+				b = uint8_t(v & 31);
+				r = uint8_t((r << 3) | (r >> 2));
+				g = uint8_t((g << 3) | (g >> 2));
+				b = uint8_t((b << 3) | (b >> 2));
+				a = (v & 0x8000) ? 255 : 0;
+			}
+			else
+			{
+				b = s[0];
+				g = s[1];
+				r = s[2];
+				if (depth == 32)
+				{
+					a = s[3];
+				}
+			}
+
+			d[0] = r;
+			d[1] = g;
+			d[2] = b;
+			if (dstBpp == 4)
+			{
+				d[3] = a;
+			}
+		}
+
+		bool emitPixel(const TgaHeader& h, const uint8_t* colorMap, const uint8_t* s, uint8_t* d, int dstBpp, bool raw)
+		{
+			if (raw)
+			{
+				memcpy(d, s, dstBpp);
+			}
+			else if ((h.imageType & 0x7) == TGA_COLOR_MAPPED)
+			{
+				int index = (h.pixelDepth == 16 ? readU16(s) : s[0]) - h.colorMapFirst;
+				if (index < 0 || index >= h.colorMapLength)
+				{
+					return false;
+				}
+
+				int entrySize = (h.colorMapDepth + 7) / 8;
+				convertTrueColor(colorMap + index*entrySize, h.colorMapDepth, d, dstBpp);
+			}
+			else
+			{
+				convertTrueColor(s, h.pixelDepth, d, dstBpp);
+			}
+
+			return true;
+		}
+
+		void fixOrigin(const TgaHeader& h, uint8_t* pixels)
+		{
+			int bpp = h.getDecodedBPP();
+			if (h.isTopOrigin())
+			{
+				flipRows(pixels, h.width*bpp, h.height);
+			}
+
+			if (h.isRightOrigin())
+			{
+				mirrorRows(pixels, h.width, h.height, bpp);
+			}
+		}
+	}
+
+	bool TgaHeader::parse(const uint8_t* p)
+	{
+		idLength		= p[0];
+		colorMapType	= p[1];
+		imageType		= p[2];
+		colorMapFirst	= readU16(p + 3);
+		colorMapLength	= readU16(p + 5);
+		colorMapDepth	= p[7];
+		// p[8..11] is x and y origin of the image on screen, not needed
+		width			= readU16(p + 12);
+		height			= readU16(p + 14);
+		pixelDepth		= p[16];
+		descriptor		= p[17];
+
+		if (width == 0 || height == 0 || colorMapType > 1)
+		{
+			return false;
+		}
+
+		if (colorMapType == 1 && !isTrueColorDepth(colorMapDepth))
+		{
+			return false;
+		}
+
+		switch (imageType)
+		{
+		case TGA_COLOR_MAPPED:
+		case TGA_RLE_COLOR_MAPPED:
+			return colorMapType == 1 && colorMapLength > 0 && (pixelDepth == 8 || pixelDepth == 16);
+
+		case TGA_TRUE_COLOR:
+		case TGA_RLE_TRUE_COLOR:
+			return isTrueColorDepth(pixelDepth);
+
+		case TGA_GRAYSCALE:
+		case TGA_RLE_GRAYSCALE:
+			return pixelDepth == 8 || pixelDepth == 16;
+
+		default:
+			return false;
+		}
+	}
+
+	int TgaHeader::getColorMapSize() const
+	{
+		return colorMapType == 1 ? colorMapLength * ((colorMapDepth + 7) / 8) : 0;
+	}
+
+	int TgaHeader::getDecodedBPP() const
+	{
+		int alphaBits = descriptor & 0x0F;
+		switch (imageType & 0x7)
+		{
+		case TGA_COLOR_MAPPED:	return getTrueColorDecodedBPP(colorMapDepth, alphaBits);
+		case TGA_TRUE_COLOR:	return getTrueColorDecodedBPP(pixelDepth, alphaBits);
+		default:				return pixelDepth / 8;
+		}
+	}
+
+	bool TgaHeader::isDirectlyDecodable() const
+	{
+		return !isRle() && hasRawLayout(*this);
+	}
+
+	bool decodeTgaPixels(const TgaHeader& h, const uint8_t* colorMap,
+		const uint8_t* src, int srcLen, uint8_t* dst)
+	{
+		const int srcBpp = h.getSourceBPP();
+		const int dstBpp = h.getDecodedBPP();
+		const int numPixels = h.width*h.height;
+		const bool raw = hasRawLayout(h);
+		const uint8_t* srcEnd = src + srcLen;
+
+		if (!h.isRle())
+		{
+			if (srcLen < numPixels*srcBpp)
+			{
+				return false;
+			}
+
+			if (raw)
+			{
+				memcpy(dst, src, numPixels*srcBpp);
+			}
+			else
+			{
+				for (int i = 0; i < numPixels; ++i)
+				{
+					if (!emitPixel(h, colorMap, src + i*srcBpp, dst + i*dstBpp, dstBpp, false))
+					{
+						return false;
+					}
+				}
+			}
+		}
+		else
+		{
+			// RLE packets: header byte, high bit set = run of one repeated pixel,
+			// otherwise raw packet of (header & 0x7F) + 1 pixels. Packets may cross rows.
+			int i = 0;
+			while (i < numPixels)
+			{
+				if (src >= srcEnd)
+				{
+					return false;
+				}
+
+				int packet = *src++;
+				int count = (packet & 0x7F) + 1;
+				if (i + count > numPixels)
+				{
+					return false;
+				}
+
+				if (packet & 0x80)
+				{
+					if (src + srcBpp > srcEnd)
+					{
+						return false;
+					}
+
+					uint8_t* first = dst + i*dstBpp;
+					if (!emitPixel(h, colorMap, src, first, dstBpp, raw))
+					{
+						return false;
+					}
+
+					for (int j = 1; j < count; ++j)
+					{
+						memcpy(first + j*dstBpp, first, dstBpp);
+					}
+
+					src += srcBpp;
+				}
+				else
+				{
+					if (src + count*srcBpp > srcEnd)
+					{
+						return false;
+					}
+
+					if (raw)
+					{
+						memcpy(dst + i*dstBpp, src, count*srcBpp);
+					}
+					else
+					{
+						for (int j = 0; j < count; ++j)
+						{
+							if (!emitPixel(h, colorMap, src + j*srcBpp, dst + (i + j)*dstBpp, dstBpp, false))
+							{
+								return false;
+							}
+						}
+					}
+
+					src += count*srcBpp;
+				}
+
+				i += count;
+			}
+		}
+
+		if (raw)
+		{
+			finishTgaPixels(h, dst);
+		}
+		else
+		{
+			fixOrigin(h, dst);
+		}
+
+		return true;
+	}
+
+	void finishTgaPixels(const TgaHeader& h, uint8_t* pixels)
+	{
+		int bpp = h.getDecodedBPP();
+		if (bpp == 3 || bpp == 4)
+		{
+			swapRedBlue(pixels, pixels, h.width*h.height, bpp);
+		}
+
+		fixOrigin(h, pixels);
+	}
+}
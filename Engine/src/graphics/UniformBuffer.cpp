@@ -0,0 +1,352 @@
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Copyright (c) 2013 Mikko Romppainen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in the
+// Software without restriction, including without limitation the rights to use, copy,
+// modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+#include <graphics/UniformBuffer.h>
+#include <graphics/Shader.h>
+#include <es_assert.h>
+#include <string.h>
+#include <stdio.h>
+
+namespace graphics
+{
+	namespace
+	{
+		// Returns number of float components and std140 array stride (in bytes) of the given type.
+		void getStd140Layout(GLenum type, int* components, int* columns, int* arrayStride)
+		{
+			*columns = 1;
+			switch( type )
+			{
+			case GL_FLOAT:
+			case GL_INT:			*components = 1; *arrayStride = 16; break;
+			case GL_FLOAT_VEC2:		*components = 2; *arrayStride = 16; break;
+			case GL_FLOAT_VEC3:		*components = 3; *arrayStride = 16; break;
+			case GL_FLOAT_VEC4:		*components = 4; *arrayStride = 16; break;
+			// Matrix columns are padded to vec4 in std140
+			case GL_FLOAT_MAT3:		*components = 3; *columns = 3; *arrayStride = 48; break;
+			case GL_FLOAT_MAT4:		*components = 4; *columns = 4; *arrayStride = 64; break;
+			default:
+				printf("[%s] Unsupported uniform type: 0x%X\n", __FUNCTION__, type);
+				assert(0);
+				*components = 0;
+				*arrayStride = 0;
+			}
+		}
+
+		int alignUp(int value, int alignment)
+		{
+			return ((value + alignment - 1) / alignment) * alignment;
+		}
+	}
+
+
+	UniformRingBuffer::UniformRingBuffer(int bytesPerFrame, int numFrames)
+		: Object()
+		, m_ubo(0)
+		, m_bytesPerFrame(0)
+		, m_numFrames(numFrames)
+		, m_frameIndex(numFrames-1)
+		, m_head(0)
+		, m_alignment(256)
+	{
+		assert(esIsVersion3()); // Uniform buffers need OpenGL ES 3.0 context
+		assert(numFrames > 0);
+
+		GLint alignment = 0;
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+		if( alignment > 0 )
+		{
+			m_alignment = alignment;
+		}
+
+		m_bytesPerFrame = alignUp(bytesPerFrame, m_alignment);
+		m_fences.resize(m_numFrames, (GLsync)0);
+		m_head = m_frameIndex*m_bytesPerFrame;
+
+		glGenBuffers(1, &m_ubo);
+		glBindBuffer(GL_UNIFORM_BUFFER, m_ubo);
+		glBufferData(GL_UNIFORM_BUFFER, m_bytesPerFrame*m_numFrames, 0, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	}
+
+	UniformRingBuffer::~UniformRingBuffer()
+	{
+		for( size_t i = 0; i < m_fences.size(); ++i )
+		{
+			if( m_fences[i] )
+			{
+				esDeleteSync(m_fences[i]);
+			}
+		}
+
+		glDeleteBuffers(1, &m_ubo);
+	}
+
+	void UniformRingBuffer::beginFrame()
+	{
+		m_frameIndex = (m_frameIndex + 1) % m_numFrames;
+		m_head = m_frameIndex*m_bytesPerFrame;
+
+		// Wait until GPU has consumed data, which was written to this segment numFrames ago.
+		GLsync fence = m_fences[m_frameIndex];
+		if( fence )
+		{
+			GLenum res = esClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull);
+			while( res == GL_TIMEOUT_EXPIRED )
+			{
+				res = esClientWaitSync(fence, 0, 1000000000ull);
+			}
+			assert(res != GL_WAIT_FAILED);
+
+			esDeleteSync(fence);
+			m_fences[m_frameIndex] = 0;
+		}
+	}
+
+	void UniformRingBuffer::endFrame()
+	{
+		assert(m_fences[m_frameIndex] == 0);
+		m_fences[m_frameIndex] = esFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+
+	int UniformRingBuffer::push(const void* data, int size)
+	{
+		int offset = alignUp(m_head, m_alignment);
+		if( offset + size > (m_frameIndex+1)*m_bytesPerFrame )
+		{
+			return -1;
+		}
+
+		glBindBuffer(GL_UNIFORM_BUFFER, m_ubo);
+
+		// Segment is guaranteed to be unused by GPU (see beginFrame), so no need for driver to synchronize.
+		void* p = esMapBufferRange(GL_UNIFORM_BUFFER, offset, size,
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+		if( p )
+		{
+			memcpy(p, data, size);
+			esUnmapBuffer(GL_UNIFORM_BUFFER);
+		}
+		else
+		{
+			glBufferSubData(GL_UNIFORM_BUFFER, offset, size, data);
+		}
+
+		m_head = offset + size;
+		return offset;
+	}
+
+	void UniformRingBuffer::bindRange(GLuint bindingPoint, int offset, int size)
+	{
+		assert(offset >= 0);
+		esBindBufferRange(GL_UNIFORM_BUFFER, bindingPoint, m_ubo, offset, size);
+	}
+
+
+	UniformBlock::UniformBlock(const char* const blockName, int sizeInBytes, GLuint bindingPoint)
+		: Object()
+		, m_blockName(blockName)
+		, m_bindingPoint(bindingPoint)
+		, m_ubo(0)
+		, m_dirty(true)
+	{
+		assert(sizeInBytes > 0);
+		m_data.resize(sizeInBytes, 0);
+	}
+
+	UniformBlock::~UniformBlock()
+	{
+		if( m_ubo )
+		{
+			glDeleteBuffers(1, &m_ubo);
+		}
+	}
+
+	void UniformBlock::addMember(const char* const uniformName, GLenum type, int offset, int count)
+	{
+		int components, columns, stride;
+		getStd140Layout(type, &components, &columns, &stride);
+		assert(offset + (count-1)*stride + (columns-1)*16 + components*4 <= getSize());
+		assert(m_programs.empty()); // Members must be declared before first bind
+
+		Member m;
+		m.name = uniformName;
+		m.type = type;
+		m.offset = offset;
+		m.count = count;
+		m_members.push_back(m);
+	}
+
+	void UniformBlock::setData(const void* data, int size, int offset)
+	{
+		assert(offset >= 0 && offset + size <= getSize());
+		memcpy(&m_data[offset], data, size);
+		m_dirty = true;
+	}
+
+	void* UniformBlock::getData()
+	{
+		m_dirty = true;
+		return &m_data[0];
+	}
+
+	bool UniformBlock::isBufferBacked()
+	{
+		return esIsVersion3();
+	}
+
+	void UniformBlock::bind(Shader* shader, UniformRingBuffer* ring)
+	{
+		ProgramBinding& binding = getProgramBinding(shader);
+
+		// ES 2.0 contexts and programs, which declare the members as plain uniforms
+		// instead of the block (e.g. GLSL ES 1.00 shaders on ES 3.0).
+		if( binding.blockIndex == GL_INVALID_INDEX )
+		{
+			setUniforms(binding);
+			return;
+		}
+
+		if( ring )
+		{
+			int offset = ring->push(&m_data[0], getSize());
+			if( offset >= 0 )
+			{
+				ring->bindRange(m_bindingPoint, offset, getSize());
+				return;
+			}
+
+			printf("[%s] Uniform ring buffer is full, using own buffer for block %s\n", __FUNCTION__, m_blockName.c_str());
+		}
+
+		if( m_ubo == 0 )
+		{
+			glGenBuffers(1, &m_ubo);
+			glBindBuffer(GL_UNIFORM_BUFFER, m_ubo);
+			glBufferData(GL_UNIFORM_BUFFER, getSize(), &m_data[0], GL_DYNAMIC_DRAW);
+			m_dirty = false;
+		}
+		else if( m_dirty )
+		{
+			glBindBuffer(GL_UNIFORM_BUFFER, m_ubo);
+			glBufferSubData(GL_UNIFORM_BUFFER, 0, getSize(), &m_data[0]);
+			m_dirty = false;
+		}
+
+		esBindBufferBase(GL_UNIFORM_BUFFER, m_bindingPoint, m_ubo);
+	}
+
+	UniformBlock::ProgramBinding& UniformBlock::getProgramBinding(Shader* shader)
+	{
+		GLuint program = shader->getProgram();
+		size_t index = m_programs.size();
+		for( size_t i = 0; i < m_programs.size(); ++i )
+		{
+			if( m_programs[i].shader == shader )
+			{
+				if( m_programs[i].revision == shader->getRevision() )
+				{
+					return m_programs[i];
+				}
+
+				// Shader has been reloaded. Replace the binding of the deleted program.
+				index = i;
+				break;
+			}
+		}
+
+		ProgramBinding binding;
+		binding.shader = shader;
+		binding.revision = shader->getRevision();
+		binding.program = program;
+		binding.blockIndex = GL_INVALID_INDEX;
+
+		if( isBufferBacked() )
+		{
+			// Block binding is program state, so it is enough to set it once per program.
+			binding.blockIndex = esGetUniformBlockIndex(program, m_blockName.c_str());
+			if( binding.blockIndex != GL_INVALID_INDEX )
+			{
+				esUniformBlockBinding(program, binding.blockIndex, m_bindingPoint);
+			}
+		}
+
+		if( binding.blockIndex == GL_INVALID_INDEX )
+		{
+			for( size_t i = 0; i < m_members.size(); ++i )
+			{
+				binding.locations.push_back(glGetUniformLocation(program, m_members[i].name.c_str()));
+			}
+		}
+
+		if( index == m_programs.size() )
+		{
+			m_programs.push_back(binding);
+		}
+		else
+		{
+			m_programs[index] = binding;
+		}
+		return m_programs[index];
+	}
+
+	void UniformBlock::setUniforms(const ProgramBinding& binding)
+	{
+		for( size_t i = 0; i < m_members.size(); ++i )
+		{
+			const Member& m = m_members[i];
+			GLint loc = binding.locations[i];
+			if( loc < 0 )
+			{
+				continue;
+			}
+
+			int components, columns, stride;
+			getStd140Layout(m.type, &components, &columns, &stride);
+
+			// Pack std140 data tightly, as glUniform*v expects.
+			m_scratch.resize(m.count*columns*components);
+			float* dst = &m_scratch[0];
+			for( int e = 0; e < m.count; ++e )
+			{
+				for( int c = 0; c < columns; ++c )
+				{
+					memcpy(dst, &m_data[m.offset + e*stride + c*16], components*sizeof(float));
+					dst += components;
+				}
+			}
+
+			const float* src = &m_scratch[0];
+			switch( m.type )
+			{
+			case GL_FLOAT:			glUniform1fv(loc, m.count, src); break;
+			case GL_FLOAT_VEC2:		glUniform2fv(loc, m.count, src); break;
+			case GL_FLOAT_VEC3:		glUniform3fv(loc, m.count, src); break;
+			case GL_FLOAT_VEC4:		glUniform4fv(loc, m.count, src); break;
+			case GL_INT:			glUniform1iv(loc, m.count, (const GLint*)src); break;
+			case GL_FLOAT_MAT3:		glUniformMatrix3fv(loc, m.count, GL_FALSE, src); break;
+			case GL_FLOAT_MAT4:		glUniformMatrix4fv(loc, m.count, GL_FALSE, src); break;
+			default:
+				break;
+			}
+		}
+	}
+}
@@ -0,0 +1,166 @@
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+//
+// Copyright (c) 2013 Mikko Romppainen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in the
+// Software without restriction, including without limitation the rights to use, copy,
+// modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+// =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+#include <graphics/OpenGLES/es_ext.h>
+#include <es_assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+namespace graphics
+{
+	PFNESBINDBUFFERRANGEPROC		esBindBufferRange = 0;
+	PFNESBINDBUFFERBASEPROC			esBindBufferBase = 0;
+	PFNESGETUNIFORMBLOCKINDEXPROC	esGetUniformBlockIndex = 0;
+	PFNESUNIFORMBLOCKBINDINGPROC	esUniformBlockBinding = 0;
+	PFNESMAPBUFFERRANGEPROC			esMapBufferRange = 0;
+	PFNESUNMAPBUFFERPROC			esUnmapBuffer = 0;
+	PFNESFENCESYNCPROC				esFenceSync = 0;
+	PFNESCLIENTWAITSYNCPROC			esClientWaitSync = 0;
+	PFNESDELETESYNCPROC				esDeleteSync = 0;
+	PFNESINVALIDATEFRAMEBUFFERPROC	esInvalidateFramebuffer = 0;
+	PFNESBLITFRAMEBUFFERPROC		esBlitFramebuffer = 0;
+	PFNESRENDERBUFFERSTORAGEMULTISAMPLEPROC	esRenderbufferStorageMultisample = 0;
+	PFNESINVALIDATEFRAMEBUFFERPROC	esDiscardFramebufferEXT = 0;
+	PFNESRENDERBUFFERSTORAGEMULTISAMPLEPROC	esRenderbufferStorageMultisampleEXT = 0;
+	PFNESFRAMEBUFFERTEXTURE2DMULTISAMPLEPROC	esFramebufferTexture2DMultisampleEXT = 0;
+
+// anonymous namespace for internal functions
+namespace
+{
+	bool		extensionsLoaded = false;
+	bool		version3 = false;
+	std::string	extensionString;
+
+	template <class T>
+	bool loadProc(T& proc, const char* const name)
+	{
+		proc = (T)eglGetProcAddress(name);
+		return proc != 0;
+	}
+}
+
+void esLoadExtensions()
+{
+	extensionsLoaded = true;
+
+	const char* ext = (const char*)glGetString(GL_EXTENSIONS);
+	extensionString = ext ? ext : "";
+
+	// Version string is "OpenGL ES N.M <vendor-specific information>"
+	const char* ver = (const char*)glGetString(GL_VERSION);
+	int major = 0;
+	if( ver && 0 == strncmp(ver, "OpenGL ES ", 10) )
+	{
+		major = ver[10] - '0';
+	}
+
+	version3 = false;
+	if( major >= 3 )
+	{
+		bool ok = true;
+		ok &= loadProc(esBindBufferRange,		"glBindBufferRange");
+		ok &= loadProc(esBindBufferBase,		"glBindBufferBase");
+		ok &= loadProc(esGetUniformBlockIndex,	"glGetUniformBlockIndex");
+		ok &= loadProc(esUniformBlockBinding,	"glUniformBlockBinding");
+		ok &= loadProc(esMapBufferRange,		"glMapBufferRange");
+		ok &= loadProc(esUnmapBuffer,			"glUnmapBuffer");
+		ok &= loadProc(esFenceSync,				"glFenceSync");
+		ok &= loadProc(esClientWaitSync,		"glClientWaitSync");
+		ok &= loadProc(esDeleteSync,			"glDeleteSync");
+		ok &= loadProc(esInvalidateFramebuffer,	"glInvalidateFramebuffer");
+		ok &= loadProc(esBlitFramebuffer,		"glBlitFramebuffer");
+		ok &= loadProc(esRenderbufferStorageMultisample, "glRenderbufferStorageMultisample");
+		version3 = ok;
+
+		if( !ok )
+		{
+			printf("[%s] Context reports %s, but ES 3.0 entry points are missing. Using ES 2.0 code paths.\n", __FUNCTION__, ver);
+		}
+	}
+
+	esDiscardFramebufferEXT = 0;
+	if( esHasExtension("GL_EXT_discard_framebuffer") )
+	{
+		loadProc(esDiscardFramebufferEXT, "glDiscardFramebufferEXT");
+	}
+
+	esRenderbufferStorageMultisampleEXT = 0;
+	esFramebufferTexture2DMultisampleEXT = 0;
+	if( esHasExtension("GL_EXT_multisampled_render_to_texture") )
+	{
+		if( !loadProc(esRenderbufferStorageMultisampleEXT, "glRenderbufferStorageMultisampleEXT")
+			|| !loadProc(esFramebufferTexture2DMultisampleEXT, "glFramebufferTexture2DMultisampleEXT") )
+		{
+			esRenderbufferStorageMultisampleEXT = 0;
+			esFramebufferTexture2DMultisampleEXT = 0;
+		}
+	}
+}
+
+bool esIsVersion3()
+{
+	if( !extensionsLoaded )
+	{
+		esLoadExtensions();
+	}
+
+	return version3;
+}
+
+bool esHasExtension(const char* const name)
+{
+	if( !extensionsLoaded )
+	{
+		esLoadExtensions();
+	}
+
+	// Match whole, space separated names only (GL_EXT_foo must not match GL_EXT_foo_bar).
+	size_t len = strlen(name);
+	size_t pos = extensionString.find(name);
+	while( pos != std::string::npos )
+	{
+		bool startOk = pos == 0 || extensionString[pos-1] == ' ';
+		bool endOk = pos+len == extensionString.size() || extensionString[pos+len] == ' ';
+		if( startOk && endOk )
+		{
+			return true;
+		}
+
+		pos = extensionString.find(name, pos+len);
+	}
+
+	return false;
+}
+
+void esDiscardFramebuffer(GLsizei numAttachments, const GLenum* attachments)
+{
+	if( esIsVersion3() )
+	{
+		esInvalidateFramebuffer(GL_FRAMEBUFFER, numAttachments, attachments);
+	}
+	else if( esDiscardFramebufferEXT )
+	{
+		esDiscardFramebufferEXT(GL_FRAMEBUFFER, numAttachments, attachments);
+	}
+}
+
+}
@@ -29,6 +29,7 @@
 #include <graphics/OpenGLES/es_util_win32.h>
 //#include <core/log.h>
 #include <core/ElapsedTimer.h>
+#include <core/JobSystem.h>
 
 namespace core
 {
@@ -333,12 +334,9 @@ GLboolean winCreate ( ESContext *esContext, LPCWSTR title, bool resizable )
 
 void winLoop ( ESContext *esContext )
 {
-	// We must set thread affinity mask for this thread, inorder that QueryPerformanceCounter does not cause troubles for us.
-	// See atricle "Game Timing and Multicore Processors (Windows)" http://msdn.microsoft.com/en-us/library/windows/desktop/ee417693(v=vs.85).aspx
-	// Enable only core 1, by using mask 0x01.
-	SetThreadAffinityMask(GetCurrentThread(), 0x01);
-
 	assert( esContext != 0 );
+	// Job system is created here, so this thread (which owns the GL context) is its main thread.
+	core::JobSystem* jobSystem = core::getJobSystem();
 	MSG msg = { 0 };
 	bool done = false;
 	core::ElapsedTimer timer;
@@ -365,6 +363,8 @@ void winLoop ( ESContext *esContext )
 		}
 		else
 		{		
+			jobSystem->runMainThreadJobs();
+
 			// Call update function if registered
 			if ( esContext->updateFunc != NULL )
 			{
@@ -542,7 +542,7 @@ EGLBoolean CreateEGL11Context ( EGLNativeWindowType hWnd, EGLDisplay* eglDisplay
 
 EGLBoolean CreateEGL20Context ( EGLNativeWindowType hWnd, EGLDisplay* eglDisplay,
                               EGLContext* eglContext, EGLSurface* eglSurface,
-                              EGLint attribList[])
+                              EGLint attribList[], EGLint clientVersion = 2)
 {
 	assert(eglDisplay != 0);
 	assert(eglSurface != 0);
@@ -555,7 +555,7 @@ EGLBoolean CreateEGL20Context ( EGLNativeWindowType hWnd, EGLDisplay* eglDisplay
 	EGLContext context;
 	EGLSurface surface;
 	EGLConfig config;
-	EGLint contextAttribs[] = { EGL_CONTEXT_CLIENT_VERSION, 2, EGL_NONE, EGL_NONE };
+	EGLint contextAttribs[] = { EGL_CONTEXT_CLIENT_VERSION, clientVersion, EGL_NONE, EGL_NONE };
 
 	// Get Display
 	display = eglGetDisplay(GetDC(hWnd));
@@ -601,6 +601,8 @@ EGLBoolean CreateEGL20Context ( EGLNativeWindowType hWnd, EGLDisplay* eglDisplay
 	if ( context == EGL_NO_CONTEXT )
 	{
 		printf("eglCreateContext failed");
+		// Release surface, so that caller can retry with another client version.
+		eglDestroySurface(display, surface);
 		return EGL_FALSE;
 	}   
    
@@ -659,6 +661,17 @@ GLboolean esCreateWindow ( ESContext *esContext, GLint width, GLint height, GLin
 	}
 
   
+	if( version == ES_VERSION_3 )
+	{
+		if ( !CreateEGL20Context( esContext->hWnd, &esContext->eglDisplay, &esContext->eglContext,
+								&esContext->eglSurface,	attribList, 3) )
+		{
+			// No ES 3.0 support in driver. Fall back to ES 2.0 context.
+			printf("OpenGL ES 3.0 context creation failed, falling back to OpenGL ES 2.0");
+			version = ES_VERSION_2;
+		}
+	}
+
 	if( version == ES_VERSION_2 )
 	{
 		if ( !CreateEGL20Context( esContext->hWnd, &esContext->eglDisplay, &esContext->eglContext,
@@ -675,11 +688,12 @@ GLboolean esCreateWindow ( ESContext *esContext, GLint width, GLint height, GLin
 			return GL_FALSE;
 		}
 	}
-	else
+	else if ( version != ES_VERSION_3 )
 	{
 		printf("Invalid OpenGL ES version: %d", version);
 	}
 
+	esContext->version = version;
 
 	return GL_TRUE;
 }
@@ -29,6 +29,7 @@
 #include <core/ElapsedTimer.h>
 #include <graphics/Shader.h>
 #include <graphics/Mesh.h>
+#include <graphics/CommandBuffer.h>
 #include "ExampleMaterials.h"
 
 //#include <core/log.h>
@@ -54,6 +55,7 @@ private:
 	core::Ref<graphics::ShaderUniforms> m_materials[2];
 
 	core::Ref<SharedShaderValues> m_sharedValues;
+	core::Ref<graphics::RenderQueue> m_renderQueue;
 
 	slmath::mat4 m_matProjection;
     slmath::mat4 m_matView;
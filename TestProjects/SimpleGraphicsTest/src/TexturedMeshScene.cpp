@@ -128,6 +128,8 @@ TexturedMeshScene::TexturedMeshScene()
 		
 	// Create mesh from ib and vb
 	m_mesh = new graphics::Mesh(ib, vb);
+
+	m_renderQueue = new graphics::RenderQueue();
 		
 //	m_fpsTimer.reset();
 //	m_numFrames = 0;
@@ -191,25 +193,29 @@ void TexturedMeshScene::render(graphics::ESContext* esContext)
 	m_sharedValues->matProj				= m_matProjection;
 	m_sharedValues->lightPos			= lightPos;
 
-	for( int i=0; i<2; ++i )
+	// Per mesh matrices are set as uniforms of each draw, so draws can be recorded in parallel.
+	// GL calls are made by execute on this thread.
+	m_renderQueue->reset();
+	m_renderQueue->record(0, 2, 1, [this](graphics::CommandBuffer* cb, int first, int last)
 	{
-		// These values are needed to update for each mesh which is rendered (different model matrix)
-		m_sharedValues->matModel			= m_matModel[i];
-		slmath::mat4 matModelView			= m_matView * m_matModel[i];
-		slmath::mat4 matModelViewProj		= m_matProjection * matModelView;
-		slmath::mat4 matNormal				= slmath::transpose(slmath::inverse(matModelView));
-		m_sharedValues->matModelView		= matModelView;
-		m_sharedValues->matNormal			= matNormal;
-		m_sharedValues->matModelViewProj	= matModelViewProj;
-
-		// Bind material (sets uniform values)
-		m_materials[i]->bind();
-		checkOpenGL();
-
-		// Render the mesh using active material.
-		m_mesh->render();
-		checkOpenGL();
-	}
+		for( int i=first; i<last; ++i )
+		{
+			slmath::mat4 matModelView			= m_matView * m_matModel[i];
+			slmath::mat4 matModelViewProj		= m_matProjection * matModelView;
+			slmath::mat4 matNormal				= slmath::transpose(slmath::inverse(matModelView));
+
+			cb->beginDraw(graphics::CommandBuffer::makeSortKey(0, i, 0.0f));
+			cb->bindMaterial(m_materials[i].ptr());
+			cb->setUniform("g_matModel", m_matModel[i]);
+			cb->setUniform("g_matModelView", matModelView);
+			cb->setUniform("g_matNormal", matNormal);
+			cb->setUniform("g_matModelViewProj", matModelViewProj);
+			cb->drawMesh(m_mesh.ptr());
+		}
+	});
+
+	m_renderQueue->execute();
+	checkOpenGL();
 }
 
 graphics::Texture* TexturedMeshScene::createSimpleTexture2D()